@@ -0,0 +1,57 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <LibMailUnit/Api/Include/Message/Mailbox.h>
+#include <Benchmarks/Benchmark.h>
+
+namespace {
+
+const char address_list[] =
+    "\"Doe, John\" <john.doe@example.com>, Jane Roe <jane.roe@example.org>, "
+    "Team: first@example.com, Second Member (backup) <second@example.com>, third@example.net;, "
+    "=?UTF-8?B?0J/RgNC40LLQtdGC?= <privet@example.ru>, last.one@example.com";
+
+} // namespace
+
+MU_BENCHMARK(addressGroupParse)
+{
+    for(size_t i = 0; i < _iterations; ++i)
+    {
+        MU_MailboxGroup * group = muMailboxGroupParse(address_list);
+        size_t count = muMailboxCount(group);
+        for(size_t index = 0; index < count; ++index)
+        {
+            MU_Mailbox * mailbox = muMailbox(group, index);
+            MailUnit::Benchmarks::doNotOptimize(muMailboxAddress(mailbox));
+            muFree(mailbox);
+        }
+        muFree(group);
+    }
+}
+
+MU_BENCHMARK(addressListParse)
+{
+    MU_AddressListItem items[16];
+    char arena[512];
+    for(size_t i = 0; i < _iterations; ++i)
+    {
+        size_t item_count = sizeof(items) / sizeof(items[0]);
+        size_t arena_size = sizeof(arena);
+        MU_Bool result = muAddressListParse(address_list, items, &item_count, arena, &arena_size);
+        MailUnit::Benchmarks::doNotOptimize(result);
+    }
+}
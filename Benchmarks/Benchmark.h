@@ -0,0 +1,69 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#ifndef __MU_BENCHMARKS_BENCHMARK_H__
+#define __MU_BENCHMARKS_BENCHMARK_H__
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace MailUnit {
+namespace Benchmarks {
+
+// The function runs the measured code the given number of times.
+typedef std::function<void(size_t)> BenchmarkFunction;
+
+struct Benchmark
+{
+    std::string name;
+    BenchmarkFunction function;
+}; // struct Benchmark
+
+std::vector<Benchmark> & benchmarks();
+
+class BenchmarkRegistrar
+{
+public:
+    BenchmarkRegistrar(const std::string & _name, BenchmarkFunction _function)
+    {
+        benchmarks().push_back({ _name, _function });
+    }
+}; // class BenchmarkRegistrar
+
+// Prevents the compiler from optimizing away a computed value.
+template<typename Type>
+inline void doNotOptimize(const Type & _value)
+{
+#ifdef _MSC_VER
+    static const volatile void * sink;
+    sink = &_value;
+#else
+    asm volatile("" : : "g"(&_value) : "memory");
+#endif
+}
+
+} // namespace Benchmarks
+} // namespace MailUnit
+
+#define MU_BENCHMARK(name) \
+    static void name(size_t); \
+    static ::MailUnit::Benchmarks::BenchmarkRegistrar name##_registrar(#name, name); \
+    static void name(size_t _iterations)
+
+#endif // __MU_BENCHMARKS_BENCHMARK_H__
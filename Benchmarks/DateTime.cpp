@@ -0,0 +1,83 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <boost/regex.hpp>
+#include <boost/lexical_cast.hpp>
+#include <LibMailUnit/Api/Include/Message/DateTime.h>
+#include <Benchmarks/Benchmark.h>
+
+namespace {
+
+const char * const samples[] =
+{
+    "Sat, 12 Jul 2014 20:11:15 -0430",
+    " Sat, 12 Jul 2014 20:11 +0430",
+    "12 Jul 2014 20:11:15 -0430 ",
+    "Tue, 1 Jul 2014 08:01:02 +0000"
+};
+
+const size_t sample_count = sizeof(samples) / sizeof(samples[0]);
+
+// The regular expression based parser that muDateTimeParse used before. Kept as the baseline.
+bool parseWithRegex(const char * _raw_date_time, MU_DateTime * _date_time)
+{
+    boost::regex regex("\\s*"
+        "((?<day_of_week>\\w{3})\\s*,\\s*)?"
+        "(?<day>\\d{1,2})\\s+"
+        "(?<month>\\w{3})\\s+"
+        "(?<year>\\d{4})\\s+"
+        "(?<hours>\\d{2})+\\s*\\:"
+        "(?<minutes>\\d{2})+\\s*"
+        "(\\:\\s*(?<seconds>\\d{2}))?\\s*"
+        "(?<timezone>[+-]\\d{4})"
+        "\\s*");
+    boost::cmatch matches;
+    if(!boost::regex_match(_raw_date_time, matches, regex))
+        return false;
+    _date_time->year = boost::lexical_cast<unsigned short>(matches["year"].str());
+    _date_time->day = boost::lexical_cast<unsigned short>(matches["day"].str());
+    _date_time->hours = boost::lexical_cast<unsigned short>(matches["hours"].str());
+    _date_time->minutes = boost::lexical_cast<unsigned short>(matches["minutes"].str());
+    if(matches["seconds"].matched)
+        _date_time->seconds = boost::lexical_cast<unsigned short>(matches["seconds"].str());
+    std::string timezone = matches["timezone"].str();
+    _date_time->timezone_offset_hours = boost::lexical_cast<short>(&timezone.c_str()[1], 2);
+    _date_time->timezone_offset_minutes = boost::lexical_cast<short>(&timezone.c_str()[3], 2);
+    return true;
+}
+
+} // namespace
+
+MU_BENCHMARK(dateTimeParseRegex)
+{
+    MU_DateTime date_time = { };
+    for(size_t i = 0; i < _iterations; ++i)
+    {
+        bool result = parseWithRegex(samples[i % sample_count], &date_time);
+        MailUnit::Benchmarks::doNotOptimize(result);
+    }
+}
+
+MU_BENCHMARK(dateTimeParse)
+{
+    MU_DateTime date_time = { };
+    for(size_t i = 0; i < _iterations; ++i)
+    {
+        MU_Bool result = muDateTimeParse(samples[i % sample_count], &date_time);
+        MailUnit::Benchmarks::doNotOptimize(result);
+    }
+}
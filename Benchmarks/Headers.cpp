@@ -0,0 +1,92 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <string>
+#include <LibMailUnit/Api/Include/Message/MailHeader.h>
+#include <Benchmarks/Benchmark.h>
+
+namespace {
+
+std::string makeHeaders()
+{
+    std::string result;
+    for(int i = 0; i < 40; ++i)
+    {
+        result += "Received: from relay" + std::to_string(i) + ".example.com (relay.example.com [192.0.2.1])\r\n"
+            "\tby mx.example.org with ESMTPS id " + std::to_string(i * 7919) + "\r\n"
+            "\tfor <user@example.org>; Sat, 12 Jul 2014 20:11:15 -0430\r\n";
+        result += "X-Header-" + std::to_string(i) + ": value " + std::to_string(i) + "\r\n";
+    }
+    result +=
+        "From: Sender <sender@example.com>\r\n"
+        "To: User <user@example.org>\r\n"
+        "Subject: Benchmark\r\n"
+        "Date: Sat, 12 Jul 2014 20:11:15 -0430\r\n"
+        "\r\n"
+        "Body\r\n";
+    return result;
+}
+
+} // namespace
+
+MU_BENCHMARK(headersParse)
+{
+    static const std::string headers = makeHeaders();
+    for(size_t i = 0; i < _iterations; ++i)
+    {
+        MU_MailHeaderList * list = muMailHeadersParseString(headers.c_str());
+        MailUnit::Benchmarks::doNotOptimize(list);
+        muFree(list);
+    }
+}
+
+MU_BENCHMARK(headersFind)
+{
+    static const std::string headers = makeHeaders();
+    MU_MailHeaderList * list = muMailHeadersParseString(headers.c_str());
+    for(size_t i = 0; i < _iterations; ++i)
+    {
+        MU_MailHeader * header = muMailHeaderByName(list, "date");
+        MailUnit::Benchmarks::doNotOptimize(header);
+        muFree(header);
+    }
+    muFree(list);
+}
+
+MU_BENCHMARK(headersFindView)
+{
+    static const std::string headers = makeHeaders();
+    MU_MailHeaderList * list = muMailHeadersParseString(headers.c_str());
+    MU_MailHeaderView header;
+    for(size_t i = 0; i < _iterations; ++i)
+    {
+        MU_Bool found = muMailHeaderFind(list, "date", &header);
+        MailUnit::Benchmarks::doNotOptimize(found);
+    }
+    muFree(list);
+}
+
+MU_BENCHMARK(headerDecodeValue)
+{
+    static const char value[] = "Re: =?UTF-8?B?0J/RgNC40LLQtdGC?= =?windows-1251?Q?=EC=E8=F0?= and plain text";
+    char buffer[128];
+    for(size_t i = 0; i < _iterations; ++i)
+    {
+        size_t length = muMailHeaderDecodeValue(value, buffer, sizeof(buffer));
+        MailUnit::Benchmarks::doNotOptimize(length);
+    }
+}
@@ -0,0 +1,47 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <Benchmarks/Benchmark.h>
+
+using namespace MailUnit::Benchmarks;
+
+std::vector<Benchmark> & MailUnit::Benchmarks::benchmarks()
+{
+    static std::vector<Benchmark> list;
+    return list;
+}
+
+int main(int _argc, char ** _argv)
+{
+    size_t iterations = _argc > 1 ? std::strtoul(_argv[1], nullptr, 10) : 100000;
+    if(0 == iterations)
+        iterations = 1;
+    for(const Benchmark & benchmark : benchmarks())
+    {
+        benchmark.function(iterations / 10 + 1); // Warming up
+        auto start = std::chrono::steady_clock::now();
+        benchmark.function(iterations);
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << std::left << std::setw(40) << benchmark.name << std::right << std::setw(12) <<
+            std::fixed << std::setprecision(1) << static_cast<double>(duration.count()) / iterations << " ns/op" << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
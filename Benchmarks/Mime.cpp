@@ -0,0 +1,101 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <string>
+#include <LibMailUnit/Api/Include/Message/Mime.h>
+#include <Benchmarks/Benchmark.h>
+
+namespace {
+
+std::string makeAttachment(size_t _line_count)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string line;
+    for(size_t i = 0; i < 76; ++i)
+        line += alphabet[i % 64];
+    line += "\r\n";
+    std::string result;
+    result.reserve(line.size() * _line_count);
+    for(size_t i = 0; i < _line_count; ++i)
+        result += line;
+    return result;
+}
+
+std::string makeMessage()
+{
+    return
+        "From: Sender <sender@example.com>\r\n"
+        "To: User <user@example.org>\r\n"
+        "Subject: Benchmark\r\n"
+        "Content-Type: multipart/mixed; boundary=outer-boundary\r\n"
+        "\r\n"
+        "This is a multi-part message in MIME format.\r\n"
+        "--outer-boundary\r\n"
+        "Content-Type: multipart/alternative; boundary=inner-boundary\r\n"
+        "\r\n"
+        "--inner-boundary\r\n"
+        "Content-Type: text/plain\r\n"
+        "\r\n"
+        "The plain text format\r\n"
+        "--inner-boundary\r\n"
+        "Content-Type: text/html\r\n"
+        "\r\n"
+        "<p>The html format</p>\r\n"
+        "--inner-boundary--\r\n"
+        "--outer-boundary\r\n"
+        "Content-Type: application/octet-stream\r\n"
+        "Content-Transfer-Encoding: base64\r\n"
+        "\r\n" +
+        makeAttachment(26000) + // About 2 MB
+        "--outer-boundary\r\n"
+        "Content-Type: image/png\r\n"
+        "Content-Transfer-Encoding: base64\r\n"
+        "\r\n" +
+        makeAttachment(13000) +
+        "--outer-boundary--\r\n";
+}
+
+} // namespace
+
+MU_BENCHMARK(mimeParse)
+{
+    static const std::string message = makeMessage();
+    for(size_t i = 0; i < _iterations; ++i)
+    {
+        MU_MimeMessage * mime = muMimeParseString(message.c_str());
+        MailUnit::Benchmarks::doNotOptimize(mime);
+        muFree(mime);
+    }
+}
+
+MU_BENCHMARK(mimeDecodeBase64)
+{
+    static const std::string message = makeMessage();
+    MU_MimeMessage * mime = muMimeParseString(message.c_str());
+    MU_MimePart * root = muMimeToPart(mime);
+    MU_MimePart * attachment = muMimePart(root, 1);
+    static char buffer[64 * 1024];
+    for(size_t i = 0; i < _iterations; ++i)
+    {
+        size_t position = 0;
+        while(muMimeDecodedContent(attachment, &position, buffer, sizeof(buffer)) > 0)
+            MailUnit::Benchmarks::doNotOptimize(buffer);
+    }
+    muFree(attachment);
+    muFree(root);
+    muFree(mime);
+}
@@ -15,10 +15,7 @@
  *                                                                                             *
  ***********************************************************************************************/
 
-#include <string>
-#include <utility>
-#include <boost/regex.hpp>
-#include <boost/lexical_cast.hpp>
+#include <cstring>
 #include <boost/date_time.hpp>
 #include <LibMailUnit/Api/Include/Message/DateTime.h>
 
@@ -45,135 +42,311 @@ constexpr char day_name_fri[] = "Fri";
 constexpr char day_name_sat[] = "Sat";
 constexpr char day_name_sun[] = "Sun";
 
-MU_Month parseMonth(const std::string & _month_string)
+constexpr size_t name_length = 3;
+
+inline bool isNameEqual(const char * _name, const char * _string)
 {
-    if(_month_string == month_name_jan)
+    return std::strncmp(_name, _string, name_length) == 0;
+}
+
+MU_Month parseMonth(const char * _month_string)
+{
+    if(isNameEqual(month_name_jan, _month_string))
         return mu_month_jan;
-    if(_month_string == month_name_feb)
+    if(isNameEqual(month_name_feb, _month_string))
         return mu_month_feb;
-    if(_month_string == month_name_mar)
+    if(isNameEqual(month_name_mar, _month_string))
         return mu_month_mar;
-    if(_month_string == month_name_apr)
+    if(isNameEqual(month_name_apr, _month_string))
         return mu_month_apr;
-    if(_month_string == month_name_may)
+    if(isNameEqual(month_name_may, _month_string))
         return mu_month_may;
-    if(_month_string == month_name_jun)
+    if(isNameEqual(month_name_jun, _month_string))
         return mu_month_jun;
-    if(_month_string == month_name_jul)
+    if(isNameEqual(month_name_jul, _month_string))
         return mu_month_jul;
-    if(_month_string == month_name_aug)
+    if(isNameEqual(month_name_aug, _month_string))
         return mu_month_aug;
-    if(_month_string == month_name_sep)
+    if(isNameEqual(month_name_sep, _month_string))
         return mu_month_sep;
-    if(_month_string == month_name_oct)
+    if(isNameEqual(month_name_oct, _month_string))
         return mu_month_oct;
-    if(_month_string == month_name_nov)
+    if(isNameEqual(month_name_nov, _month_string))
         return mu_month_nov;
-    if(_month_string == month_name_dec)
+    if(isNameEqual(month_name_dec, _month_string))
         return mu_month_dec;
     return  mu_month_invalid;
 }
 
-MU_DayOfWeek parseDayOfWeek(const std::string & _dow_string)
+MU_DayOfWeek parseDayOfWeek(const char * _dow_string)
 {
-    if(_dow_string == day_name_mon)
+    if(isNameEqual(day_name_mon, _dow_string))
         return mu_dow_mon;
-    if(_dow_string == day_name_thu)
-        return mu_dow_thu;
-    if(_dow_string == day_name_wed)
+    if(isNameEqual(day_name_tue, _dow_string))
+        return mu_dow_tue;
+    if(isNameEqual(day_name_wed, _dow_string))
         return mu_dow_wed;
-    if(_dow_string == day_name_thu)
+    if(isNameEqual(day_name_thu, _dow_string))
         return mu_dow_thu;
-    if(_dow_string == day_name_fri)
+    if(isNameEqual(day_name_fri, _dow_string))
         return mu_dow_fri;
-    if(_dow_string == day_name_sat)
+    if(isNameEqual(day_name_sat, _dow_string))
         return mu_dow_sat;
-    if(_dow_string == day_name_sun)
+    if(isNameEqual(day_name_sun, _dow_string))
         return mu_dow_sun;
     return mu_dow_invalid;
 }
 
-std::pair<short, short> parseTimeZone(const std::string & _zone_string)
+inline bool isSpace(char _symbol)
+{
+    return ' ' == _symbol || '\t' == _symbol || '\r' == _symbol || '\n' == _symbol ||
+        '\f' == _symbol || '\v' == _symbol;
+}
+
+inline bool isDigit(char _symbol)
+{
+    return _symbol >= '0' && _symbol <= '9';
+}
+
+inline bool isAlpha(char _symbol)
+{
+    return (_symbol >= 'a' && _symbol <= 'z') || (_symbol >= 'A' && _symbol <= 'Z');
+}
+
+inline bool isWordSymbol(char _symbol)
+{
+    return isAlpha(_symbol) || isDigit(_symbol) || '_' == _symbol;
+}
+
+inline char toLower(char _symbol)
+{
+    return _symbol >= 'A' && _symbol <= 'Z' ? _symbol - 'A' + 'a' : _symbol;
+}
+
+// Single pass scanner of the RFC 5322 date-time:
+//     [day-of-week ","] day month year hour ":" minute [":" second] zone
+class DateTimeScanner
+{
+public:
+    explicit DateTimeScanner(const char * _data) :
+        mp_position(_data)
+    {
+    }
+
+    bool scan(MU_DateTime & _date_time);
+
+private:
+    void skipSpaces()
+    {
+        while(isSpace(*mp_position))
+            ++mp_position;
+    }
+
+    bool skipRequiredSpaces()
+    {
+        if(!isSpace(*mp_position))
+            return false;
+        skipSpaces();
+        return true;
+    }
+
+    bool skip(char _symbol)
+    {
+        if(_symbol != *mp_position)
+            return false;
+        ++mp_position;
+        return true;
+    }
+
+    bool readWord(const char *& _word);
+    bool readNumber(size_t _min_length, size_t _max_length, unsigned short & _value);
+    bool readDigitPairs(unsigned short & _value);
+    bool readDayOfWeek(MU_DayOfWeek & _day_of_week);
+    bool readZone(short & _hours, short & _minutes);
+    bool readObsoleteZone(short & _hours);
+
+private:
+    const char * mp_position;
+}; // class DateTimeScanner
+
+bool DateTimeScanner::scan(MU_DateTime & _date_time)
+{
+    skipSpaces();
+    if(!readDayOfWeek(_date_time.day_of_week))
+        _date_time.day_of_week = mu_dow_invalid;
+    const char * month_name = nullptr;
+    if(!readNumber(1, 2, _date_time.day) || !skipRequiredSpaces() ||
+       !readWord(month_name) || !skipRequiredSpaces())
+    {
+        return false;
+    }
+    _date_time.month = parseMonth(month_name);
+    if(mu_month_invalid == _date_time.month)
+        return false;
+    if(!readNumber(4, 4, _date_time.year) || !skipRequiredSpaces() || !readDigitPairs(_date_time.hours))
+        return false;
+    skipSpaces();
+    if(!skip(':') || !readDigitPairs(_date_time.minutes))
+        return false;
+    skipSpaces();
+    _date_time.seconds = 0;
+    if(skip(':'))
+    {
+        skipSpaces();
+        if(!readNumber(2, 2, _date_time.seconds))
+            return false;
+        skipSpaces();
+    }
+    if(!readZone(_date_time.timezone_offset_hours, _date_time.timezone_offset_minutes))
+        return false;
+    skipSpaces();
+    return '\0' == *mp_position;
+}
+
+bool DateTimeScanner::readWord(const char *& _word)
 {
-    static const size_t sign_pos    = 0;
-    static const size_t hours_pos   = 1;
-    static const size_t minutes_pos = 3;
-    static const size_t value_len   = 2;
-    short hours_offset = boost::lexical_cast<short>(&_zone_string.c_str()[hours_pos], value_len);
-    short minutes_offset = boost::lexical_cast<short>(&_zone_string.c_str()[minutes_pos], value_len);
-    if('-' == _zone_string[sign_pos])
+    for(size_t i = 0; i < name_length; ++i)
     {
-        hours_offset = -hours_offset;
-        minutes_offset = -minutes_offset;
+        if(!isWordSymbol(mp_position[i]))
+            return false;
     }
-    return std::make_pair(hours_offset, minutes_offset);
+    _word = mp_position;
+    mp_position += name_length;
+    return true;
 }
 
-} // namespace
+bool DateTimeScanner::readNumber(size_t _min_length, size_t _max_length, unsigned short & _value)
+{
+    size_t length = 0;
+    unsigned short value = 0;
+    for(; length < _max_length && isDigit(mp_position[length]); ++length)
+        value = value * 10 + (mp_position[length] - '0');
+    if(length < _min_length)
+        return false;
+    mp_position += length;
+    _value = value;
+    return true;
+}
 
-MU_Bool MU_CALL muDateTimeParse(const char * _raw_date_time, MU_DateTime * _date_time)
+// Hours and minutes are allowed to be repeated digit pairs, only the last pair is taken.
+bool DateTimeScanner::readDigitPairs(unsigned short & _value)
 {
-    if(nullptr == _date_time)
+    size_t length = 0;
+    while(isDigit(mp_position[length]))
+        ++length;
+    if(length < 2 || length % 2 != 0)
+        return false;
+    _value = (mp_position[length - 2] - '0') * 10 + (mp_position[length - 1] - '0');
+    mp_position += length;
+    return true;
+}
+
+bool DateTimeScanner::readDayOfWeek(MU_DayOfWeek & _day_of_week)
+{
+    const char * start = mp_position;
+    const char * name = nullptr;
+    if(readWord(name))
     {
-        return mu_false;
+        skipSpaces();
+        if(skip(','))
+        {
+            skipSpaces();
+            _day_of_week = parseDayOfWeek(name);
+            return true;
+        }
     }
-    boost::regex regex("\\s*"
-        "((?<day_of_week>\\w{3})\\s*,\\s*)?"
-        "(?<day>\\d{1,2})\\s+"
-        "(?<month>\\w{3})\\s+"
-        "(?<year>\\d{4})\\s+"
-        "(?<hours>\\d{2})+\\s*\\:"
-        "(?<minutes>\\d{2})+\\s*"
-        "(\\:\\s*(?<seconds>\\d{2}))?\\s*"
-        "(?<timezone>[+-]\\d{4})"
-        "\\s*");
-    boost::cmatch matches;
-    if(!boost::regex_match(_raw_date_time, matches, regex))
+    mp_position = start;
+    return false;
+}
+
+bool DateTimeScanner::readZone(short & _hours, short & _minutes)
+{
+    char sign = *mp_position;
+    if('+' != sign && '-' != sign)
     {
-        return mu_false;
+        _minutes = 0;
+        return readObsoleteZone(_hours);
     }
-    boost::csub_match day_of_week_match = matches["day_of_week"];
-    boost::csub_match year_match = matches["year"];
-    boost::csub_match month_match = matches["month"];
-    boost::csub_match day_match = matches["day"];
-    boost::csub_match hours_match = matches["hours"];
-    boost::csub_match minutes_match = matches["minutes"];
-    boost::csub_match seconds_match = matches["seconds"];
-    boost::csub_match timezone_match = matches["timezone"];
-    if(!year_match.matched || !month_match.matched || !day_match.matched ||
-       !hours_match.matched || !minutes_match.matched || !timezone_match.matched)
+    for(size_t i = 1; i <= 4; ++i)
     {
-        return mu_false;
+        if(!isDigit(mp_position[i]))
+            return false;
     }
-    MU_DayOfWeek day_of_week = mu_dow_invalid;
-    if(day_of_week_match.matched)
+    _hours = (mp_position[1] - '0') * 10 + (mp_position[2] - '0');
+    _minutes = (mp_position[3] - '0') * 10 + (mp_position[4] - '0');
+    if('-' == sign)
     {
-        day_of_week = parseDayOfWeek(day_of_week_match);
+        _hours = -_hours;
+        _minutes = -_minutes;
     }
-    unsigned short year = boost::lexical_cast<unsigned short>(year_match.str());
-    MU_Month month = parseMonth(month_match);
-    if(mu_month_invalid == month)
+    mp_position += 5;
+    return true;
+}
+
+// RFC 5322, section 4.3. Military zones must be treated as -0000.
+bool DateTimeScanner::readObsoleteZone(short & _hours)
+{
+    static const struct
+    {
+        const char * name;
+        short hours;
+    } zones[] =
+    {
+        { "ut",  0 },
+        { "gmt", 0 },
+        { "est", -5 },
+        { "edt", -4 },
+        { "cst", -6 },
+        { "cdt", -5 },
+        { "mst", -7 },
+        { "mdt", -6 },
+        { "pst", -8 },
+        { "pdt", -7 }
+    };
+    size_t length = 0;
+    char name[name_length + 1] = { };
+    for(; isAlpha(mp_position[length]); ++length)
+    {
+        if(length == name_length)
+            return false;
+        name[length] = toLower(mp_position[length]);
+    }
+    if(0 == length)
+        return false;
+    if(1 == length)
+    {
+        if('j' == name[0])
+            return false;
+        _hours = 0;
+        mp_position += length;
+        return true;
+    }
+    for(const auto & zone : zones)
+    {
+        if(std::strcmp(zone.name, name) == 0)
+        {
+            _hours = zone.hours;
+            mp_position += length;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+MU_Bool MU_CALL muDateTimeParse(const char * _raw_date_time, MU_DateTime * _date_time)
+{
+    if(nullptr == _date_time || nullptr == _raw_date_time)
     {
         return mu_false;
     }
-    unsigned short day = boost::lexical_cast<unsigned short>(day_match.str());
-    unsigned short hours = boost::lexical_cast<unsigned short>(hours_match.str());
-    unsigned short minutes = boost::lexical_cast<unsigned short>(minutes_match.str());
-    unsigned short seconds = 0;
-    if(seconds_match.matched)
+    MU_DateTime date_time = { };
+    if(!DateTimeScanner(_raw_date_time).scan(date_time))
     {
-        seconds = boost::lexical_cast<unsigned short>(seconds_match.str());
+        return mu_false;
     }
-    std::pair<short, short> timezone_offset = parseTimeZone(timezone_match);
-    _date_time->day_of_week = day_of_week;
-    _date_time->year = year;
-    _date_time->month = month;
-    _date_time->day = day;
-    _date_time->hours = hours;
-    _date_time->minutes = minutes;
-    _date_time->seconds = seconds;
-    _date_time->timezone_offset_hours = timezone_offset.first;
-    _date_time->timezone_offset_minutes = timezone_offset.second;
+    *_date_time = date_time;
     return mu_true;
 }
 
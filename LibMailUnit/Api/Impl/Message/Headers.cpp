@@ -15,27 +15,53 @@
  *                                                                                             *
  ***********************************************************************************************/
 
-#include <sstream>
+#include <algorithm>
+#include <cstring>
 #include <boost/iostreams/device/file_descriptor.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <LibMailUnit/Message/EncodedWord.h>
 #include <LibMailUnit/Api/Impl/Message/Headers.h>
 
 using namespace LibMailUnit::Message;
 
+namespace {
+
+inline void fillHeaderView(const Header & _header, MU_MailHeaderView & _view)
+{
+    _view.name = _header.name();
+    _view.values = _header.values();
+    _view.value_count = _header.valueCount();
+}
+
+} // namespace
+
 MU_MailHeaderList * MU_CALL muMailHeadersParseString(const char * _input)
 {
-    std::stringstream stream(_input);
     HeaderMap * map = new HeaderMap();
-    HeaderParser::parse(stream, *map);
+    if(nullptr != _input)
+        HeaderParser::parse(_input, std::strlen(_input), *map);
     return new MU_MailHeaderList(map, true);
 }
 
 MU_MailHeaderList * MU_CALL muMailHeadersParseFile(MU_File _input)
 {
+    static const size_t chunk_size = 4096;
     boost::iostreams::file_descriptor fdesc(_input, boost::iostreams::never_close_handle);
-    boost::iostreams::stream<boost::iostreams::file_descriptor> stream(fdesc);
+    std::vector<char> data;
+    size_t line_begin = 0;
+    size_t end_of_headers = std::string::npos;
+    while(std::string::npos == end_of_headers)
+    {
+        size_t size = data.size();
+        data.resize(size + chunk_size);
+        std::streamsize read = fdesc.read(&data[size], chunk_size);
+        data.resize(size + (read > 0 ? read : 0));
+        if(read <= 0)
+            break;
+        end_of_headers = HeaderParser::findEndOfHeaders(data.data(), data.size(), line_begin);
+    }
     HeaderMap * map = new HeaderMap();
-    HeaderParser::parse(stream, *map);
+    HeaderParser::parse(data.data(), std::string::npos == end_of_headers ? data.size() : end_of_headers, *map);
     return new MU_MailHeaderList(map, true);
 }
 
@@ -58,7 +84,7 @@ const char * MU_CALL muMailHeaderName(MU_MailHeader * _header)
     if(nullptr == _header)
         return nullptr;
     const Header * header = _header->pointer();
-    return header->name.c_str();
+    return header->name();
 }
 
 MU_MailHeader * MU_CALL muMailHeaderByName(MU_MailHeaderList * _headers, const char * _name)
@@ -77,7 +103,7 @@ size_t MU_CALL muMailHeaderValueCount(MU_MailHeader * _header)
     if(nullptr == _header)
         return 0;
     const Header * header = _header->pointer();
-    return nullptr == header ? 0 : header->values.size();
+    return nullptr == header ? 0 : header->valueCount();
 }
 
 const char * MU_CALL muMailHeaderValue(MU_MailHeader * _header, size_t _index)
@@ -85,6 +111,69 @@ const char * MU_CALL muMailHeaderValue(MU_MailHeader * _header, size_t _index)
     if(nullptr == _header)
         return nullptr;
     const Header * header = _header->pointer();
-    return nullptr == header || header->values.size() <= _index ? nullptr :
-        header->values[_index].c_str();
+    return nullptr == header ? nullptr : header->value(_index);
+}
+
+size_t MU_CALL muMailHeaderDecodeValue(const char * _value, char * _buffer, size_t _buffer_size)
+{
+    if(nullptr == _value)
+        return 0;
+    std::string value = decodeEncodedWords(_value);
+    if(nullptr != _buffer && _buffer_size > 0)
+    {
+        size_t size = std::min(value.size(), _buffer_size - 1);
+        std::memcpy(_buffer, value.data(), size);
+        _buffer[size] = '\0';
+    }
+    return value.size();
+}
+
+MU_Bool MU_CALL muMailHeaderFind(MU_MailHeaderList * _headers, const char * _name, MU_MailHeaderView * _view)
+{
+    if(nullptr == _headers || nullptr == _name || nullptr == _view)
+        return mu_false;
+    const HeaderMap * map = _headers->pointer();
+    const Header * header = nullptr == map ? nullptr : map->find(_name);
+    if(nullptr == header)
+        return mu_false;
+    fillHeaderView(*header, *_view);
+    return mu_true;
+}
+
+size_t MU_CALL muMailHeaderViews(MU_MailHeaderList * _headers, MU_MailHeaderView * _views, size_t _view_count)
+{
+    if(nullptr == _headers)
+        return 0;
+    const HeaderMap * map = _headers->pointer();
+    if(nullptr == map)
+        return 0;
+    if(nullptr != _views)
+    {
+        size_t count = std::min(_view_count, map->size());
+        for(size_t i = 0; i < count; ++i)
+            fillHeaderView(*(*map)[i], _views[i]);
+    }
+    return map->size();
+}
+
+size_t MU_CALL muMailHeaderValueViews(MU_MailHeaderList * _headers, const char * _name,
+    MU_StringView * _values, size_t _value_count)
+{
+    if(nullptr == _headers || nullptr == _name)
+        return 0;
+    const HeaderMap * map = _headers->pointer();
+    const Header * header = nullptr == map ? nullptr : map->find(_name);
+    if(nullptr == header)
+        return 0;
+    if(nullptr != _values)
+    {
+        size_t count = std::min(_value_count, header->valueCount());
+        for(size_t i = 0; i < count; ++i)
+        {
+            const char * value = header->value(i);
+            _values[i].data = value;
+            _values[i].length = std::strlen(value);
+        }
+    }
+    return header->valueCount();
 }
@@ -15,6 +15,8 @@
  *                                                                                             *
  ***********************************************************************************************/
 
+#include <cstring>
+#include <LibMailUnit/Message/AddressList.h>
 #include <LibMailUnit/Api/Impl/Message/Mailbox.h>
 
 using namespace LibMailUnit::Message;
@@ -26,7 +28,7 @@ MU_MailboxGroup * MU_CALL muMailboxGroupParse(const char * _raw_address_group)
         return nullptr;
     }
     const MailboxGroup * group = new MailboxGroup(_raw_address_group);
-    if(group->empty())
+    if(group->empty() && group->name().empty())
     {
         delete group;
         return nullptr;
@@ -73,3 +75,62 @@ const char * MU_CALL muMailboxAddress(MU_Mailbox * _mailbox)
     const Mailbox * mailbox = _mailbox->pointer();
     return mailbox->address().empty() ? nullptr : mailbox->address().c_str();
 }
+
+namespace {
+
+class AddressListItemWriter final : public AddressListHandler
+{
+public:
+    AddressListItemWriter(MU_AddressListItem * _items, size_t _capacity, const AddressArena & _arena) :
+        mp_items(_items),
+        m_capacity(_capacity),
+        m_count(0),
+        mr_arena(_arena)
+    {
+    }
+
+    void onMailbox(size_t _group, size_t _name, size_t _address) override
+    {
+        if(m_count < m_capacity)
+        {
+            MU_AddressListItem & item = mp_items[m_count];
+            item.group = string(_group);
+            item.name = string(_name);
+            item.address = string(_address);
+        }
+        ++m_count;
+    }
+
+    size_t count() const
+    {
+        return m_count;
+    }
+
+private:
+    const char * string(size_t _offset) const
+    {
+        return none == _offset || mr_arena.overflowed() ? nullptr : mr_arena.data() + _offset;
+    }
+
+private:
+    MU_AddressListItem * mp_items;
+    size_t m_capacity;
+    size_t m_count;
+    const AddressArena & mr_arena;
+}; // class AddressListItemWriter
+
+} // namespace
+
+MU_Bool MU_CALL muAddressListParse(const char * _input, MU_AddressListItem * _items, size_t * _item_count,
+    char * _arena, size_t * _arena_size)
+{
+    if(nullptr == _input || nullptr == _item_count || nullptr == _arena_size)
+        return mu_false;
+    size_t capacity = nullptr == _items ? 0 : *_item_count;
+    AddressArena arena(_arena, nullptr == _arena ? 0 : *_arena_size);
+    AddressListItemWriter writer(_items, capacity, arena);
+    parseAddressList(_input, std::strlen(_input), arena, writer);
+    *_item_count = writer.count();
+    *_arena_size = arena.used();
+    return writer.count() <= capacity && !arena.overflowed() ? mu_true : mu_false;
+}
@@ -15,7 +15,6 @@
  *                                                                                             *
  ***********************************************************************************************/
 
-#include <sstream>
 #include <boost/iostreams/device/file_descriptor.hpp>
 #include <boost/iostreams/stream.hpp>
 #include <LibMailUnit/Api/Impl/Message/Mailbox.h>
@@ -27,16 +26,25 @@ using namespace LibMailUnit::Message;
 
 MU_MimeMessage * MU_CALL muMimeParseString(const char * _input)
 {
-    std::stringstream stream(_input);
-    const MimeMessage * message = new MimeMessage(stream);
-    return new MU_MimeMessage(message, true);
+    return muMimeParseStringEx(_input, MU_MIME_DEFAULT_DEPTH_LIMIT);
 }
 
 MU_MimeMessage * MU_CALL muMimeParseFile(MU_File _input)
+{
+    return muMimeParseFileEx(_input, MU_MIME_DEFAULT_DEPTH_LIMIT);
+}
+
+MU_MimeMessage * MU_CALL muMimeParseStringEx(const char * _input, size_t _depth_limit)
+{
+    const MimeMessage * message = new MimeMessage(std::string(_input), _depth_limit);
+    return new MU_MimeMessage(message, true);
+}
+
+MU_MimeMessage * MU_CALL muMimeParseFileEx(MU_File _input, size_t _depth_limit)
 {
     boost::iostreams::file_descriptor fdesc(_input, boost::iostreams::never_close_handle);
     boost::iostreams::stream<boost::iostreams::file_descriptor> stream(fdesc);
-    const MimeMessage * message = new MimeMessage(stream);
+    const MimeMessage * message = new MimeMessage(stream, _depth_limit);
     return new MU_MimeMessage(message, true);
 }
 
@@ -102,6 +110,14 @@ MU_MimePart * MU_CALL muMimeToPart(MU_MimeMessage * _message)
     return new MU_MimePart(mime, false);
 }
 
+MU_MimeMessage * MU_CALL muMimePartToMessage(MU_MimePart * _part)
+{
+    if(nullptr == _part)
+        return nullptr;
+    const MimeMessage * message = dynamic_cast<const MimeMessage *>(_part->pointer());
+    return nullptr == message ? nullptr : new MU_MimeMessage(message, false);
+}
+
 size_t MU_CALL muMimePartCount(MU_MimePart * _part)
 {
     if(nullptr == _part)
@@ -145,3 +161,11 @@ const char * MU_CALL muMimeContent(MU_MimePart * _part)
     return part->text().c_str();
 }
 
+size_t MU_CALL muMimeDecodedContent(MU_MimePart * _part, size_t * _position, char * _buffer, size_t _buffer_size)
+{
+    if(nullptr == _part || nullptr == _position || nullptr == _buffer)
+        return 0;
+    const MimePart * part = _part->pointer();
+    return part->decode(*_position, _buffer, _buffer_size);
+}
+
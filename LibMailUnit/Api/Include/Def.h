@@ -77,6 +77,18 @@ typedef enum
     mu_true  = 1  /**< The @a true value */
 } MU_Bool;
 
+/**
+ * @brief Reference to a string owned by another object.
+ *
+ * Views returned by the library point to zero-terminated strings, the terminator is not counted in @a length.
+ * A view is valid while the object it was taken from is alive.
+ */
+typedef struct
+{
+    const char * data; /**< Pointer to the first character */
+    size_t length;     /**< Length of the string in bytes */
+} MU_StringView;
+
 #define MU_DECLARE_API_TYPE(type)   \
     struct __ ## type;              \
     typedef struct __ ## type type;
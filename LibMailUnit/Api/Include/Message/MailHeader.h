@@ -190,6 +190,20 @@ extern "C" {
  */
 #define MU_MAILHDR_CONTENTTYPE "Content-Type"
 
+/**
+ * @brief The "Content-Transfer-Encoding" MIME header field.
+ *
+ * <A HREF="http://tools.ietf.org/html/rfc2045#section-6.1">RFC 2045 6.1</A>:
+ * <BLOCKQUOTE><PRE>
+ * encoding := "Content-Transfer-Encoding" ":" mechanism
+ * mechanism := "7bit" / "8bit" / "binary" /
+ *              "quoted-printable" / "base64" /
+ *              ietf-token / x-token
+ * </PRE></BLOCKQUOTE>
+ * @ingroup mail_header
+ */
+#define MU_MAILHDR_CONTENTTRANSFERENCODING "Content-Transfer-Encoding"
+
 MU_DECLARE_API_TYPE(MU_MailHeader)
 MU_DECLARE_API_TYPE(MU_MailHeaderList)
 
@@ -277,6 +291,89 @@ MU_API size_t MU_CALL muMailHeaderValueCount(MU_MailHeader * _header);
 */
 MU_API const char * MU_CALL muMailHeaderValue(MU_MailHeader * _header, size_t _index);
 
+/**
+ * @brief Decodes encoded words of a header value to UTF-8.
+ *
+ * <A HREF="http://tools.ietf.org/html/rfc2047">RFC 2047</A> allows non-ASCII text in the
+ * unstructured headers and phrases, for example <tt>=?UTF-8?B?0J/RgNC40LLQtdGC?=</tt>.
+ * Words that cannot be decoded are kept as is.
+ * @param _value
+ *     A header value
+ * @param _buffer
+ *     Buffer for the decoded zero-terminated value. Can be @a NULL to calculate the length
+ * @param _buffer_size
+ *     Size of @a _buffer. The decoded value is truncated to fit the buffer
+ * @return
+ *     Length of the decoded value excluding the terminating zero
+ * @sa muMailHeaderValue
+ * @ingroup mail_header
+ */
+MU_API size_t MU_CALL muMailHeaderDecodeValue(const char * _value, char * _buffer, size_t _buffer_size);
+
+/**
+ * @brief Header of a list that does not require to be released.
+ *
+ * The view is valid while the list it was taken from is alive.
+ * @sa muMailHeaderFind, muMailHeaderViews
+ * @ingroup mail_header
+ */
+typedef struct
+{
+    const char * name;           /**< Name of the header */
+    const char * const * values; /**< Array of the header values */
+    size_t value_count;          /**< Count of elements in @a values */
+} MU_MailHeaderView;
+
+/**
+ * @brief Searches for a header by its case insensitive name without allocating an API object.
+ * @param _headers
+ *     List to search in.
+ * @param _name
+ *     Name of the header.
+ * @param _view
+ *     A pointer to a variable that will contain a result. <i>Must not be NULL.</i>
+ * @return
+ *     @ref MU_Bool::mu_true if the header is found and @ref MU_Bool::mu_false otherwise.
+ *     The @a _view object will not be modified if the header is not found.
+ * @sa muMailHeaderByName
+ * @ingroup mail_header
+ */
+MU_API MU_Bool MU_CALL muMailHeaderFind(MU_MailHeaderList * _headers, const char * _name,
+    MU_MailHeaderView * _view);
+
+/**
+ * @brief Fills @a _views with the headers of @a _headers in their original order.
+ * @param _headers
+ *     List of headers.
+ * @param _views
+ *     Array that receives the headers. Can be @a NULL if @a _view_count is zero.
+ * @param _view_count
+ *     Capacity of @a _views.
+ * @return
+ *     Count of headers in the list. Only the first @a _view_count of them are written to @a _views.
+ * @ingroup mail_header
+ */
+MU_API size_t MU_CALL muMailHeaderViews(MU_MailHeaderList * _headers, MU_MailHeaderView * _views,
+    size_t _view_count);
+
+/**
+ * @brief Fills @a _values with the values of the header named @a _name.
+ * @param _headers
+ *     List of headers.
+ * @param _name
+ *     Case insensitive name of the header.
+ * @param _values
+ *     Array that receives the values. Can be @a NULL if @a _value_count is zero.
+ * @param _value_count
+ *     Capacity of @a _values.
+ * @return
+ *     Count of values of the header or @a 0 if the header is not found.
+ *     Only the first @a _value_count of them are written to @a _values.
+ * @ingroup mail_header
+ */
+MU_API size_t MU_CALL muMailHeaderValueViews(MU_MailHeaderList * _headers, const char * _name,
+    MU_StringView * _values, size_t _value_count);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -42,6 +42,7 @@ MU_DECLARE_API_TYPE(MU_MailboxGroup)
  *     String that describes either a mailbox or a mailbox group.
  * @return
  *     If string parsed successfully function returns a potinter to the mailbox group object.
+ *     A named group without mailboxes, like "Undisclosed recipients:;", is parsed successfully too.
  *     In failure case the function returns @a NULL.
  * @remarks
  *     Returned potinter must be destroyed by calling the @ref muFree function.
@@ -85,6 +86,41 @@ MU_API const char * MU_CALL muMailboxName(MU_Mailbox * _mailbox);
  */
 MU_API const char * MU_CALL muMailboxAddress(MU_Mailbox * _mailbox);
 
+/**
+ * @brief A mailbox found by the @ref muAddressListParse function.
+ * @ingroup mailbox
+ */
+typedef struct
+{
+    const char * group;   /**< Name of the group containing the mailbox or @a NULL */
+    const char * name;    /**< Display name of the mailbox or @a NULL */
+    const char * address; /**< Address of the mailbox */
+} MU_AddressListItem;
+
+/**
+ * @brief Parses an address list described in @ref rfc-address-id "RFC" into buffers of the caller.
+ *
+ * Unlike @ref muMailboxGroupParse the function accepts any number of groups, does not allocate API objects
+ * and writes the strings referenced by @a _items into the @a _arena buffer.
+ * @param _input
+ *     String that describes a list of mailboxes and mailbox groups.
+ * @param _items
+ *     Array that receives the mailboxes. Can be @a NULL if @a *_item_count is zero.
+ * @param _item_count
+ *     On input, the capacity of @a _items. On output, the number of mailboxes in @a _input.
+ * @param _arena
+ *     Buffer for the strings. Can be @a NULL if @a *_arena_size is zero.
+ * @param _arena_size
+ *     On input, the size of @a _arena. On output, the number of bytes used or required.
+ * @return
+ *     @ref MU_Bool::mu_true if all the mailboxes fit into the buffers and @ref MU_Bool::mu_false otherwise.
+ *     In the failure case the content of @a _items must not be used. Call the function again with buffers
+ *     of at least the reported sizes.
+ * @ingroup mailbox
+ */
+MU_API MU_Bool MU_CALL muAddressListParse(const char * _input, MU_AddressListItem * _items, size_t * _item_count,
+    char * _arena, size_t * _arena_size);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -48,6 +48,12 @@ typedef enum
     mu_mbox_bcc   /**< The @a bcc address type */
 } MU_MailboxType;
 
+/**
+ * @brief Default limit of the part nesting used by @ref muMimeParseString and @ref muMimeParseFile
+ * @sa muMimeParseStringEx
+ * @ingroup mime
+ */
+#define MU_MIME_DEFAULT_DEPTH_LIMIT 32
 
 /**
  * @brief Parses message in MIME format from string
@@ -73,6 +79,31 @@ MU_API MU_MimeMessage * MU_CALL muMimeParseString(const char * _input);
  */
 MU_API MU_MimeMessage * MU_CALL muMimeParseFile(MU_File _input);
 
+/**
+ * @brief Parses message in MIME format from string with a limited nesting of parts
+ *
+ * Each @a multipart/\* or @a message/rfc822 part increases the nesting depth.
+ * Parts deeper than @a _depth_limit are not parsed and available as a plain content only.
+ * @param _input
+ *     String containing a message
+ * @param _depth_limit
+ *     Maximal nesting depth. Zero means that no parts are parsed
+ * @return
+ *     Returns a pointer to the parsed MIME message or @a NULL
+ * @remarks
+ *     Pointer must be destroyed by calling the @ref muFree function
+ * @sa MU_MIME_DEFAULT_DEPTH_LIMIT
+ * @ingroup mime
+ */
+MU_API MU_MimeMessage * MU_CALL muMimeParseStringEx(const char * _input, size_t _depth_limit);
+
+/**
+ * @brief Parses message in MIME format from a file with a limited nesting of parts
+ * @sa muMimeParseStringEx
+ * @ingroup mime
+ */
+MU_API MU_MimeMessage * MU_CALL muMimeParseFileEx(MU_File _input, size_t _depth_limit);
+
 /**
  * @brief Returns a message subject of @a _message
  * @ingroup mime
@@ -115,6 +146,19 @@ MU_API MU_MailboxGroup * MU_CALL muMimeMailboxGroup(MU_MimeMessage * _message, M
  */
 MU_API MU_MimePart * MU_CALL muMimeToPart(MU_MimeMessage * _message);
 
+/**
+ * @brief Converts a @a MU_MimePart pointer to a @a MU_MimeMessage pointer
+ *
+ * The message encapsulated in a @a message/rfc822 part is the single part of it.
+ * @return
+ *     Pointer to the message or @a NULL if @a _part is not a message
+ * @remarks
+ *     Returned pointer must be destroyed by calling the @ref muFree function
+ * @sa muMimePart
+ * @ingroup mime
+ */
+MU_API MU_MimeMessage * MU_CALL muMimePartToMessage(MU_MimePart * _part);
+
 /**
  * @brief Returns a count of parts in @a _part
  * @sa muMimeToPart
@@ -172,6 +216,34 @@ MU_API MU_MailHeaderContentType * MU_CALL muMimeContentType(MU_MimePart * _part)
  */
 MU_API const char * MU_CALL muMimeContent(MU_MimePart * _part);
 
+/**
+ * @brief Decodes content of @a _part according to its @a Content-Transfer-Encoding header
+ *
+ * The content is decoded into the caller's buffer by chunks, so a large attachment
+ * does not have to be decoded at once.
+ * The @a base64 and @a quoted-printable encodings are decoded, any other content is copied as is.
+ * @code
+ * size_t position = 0;
+ * size_t size;
+ * while((size = muMimeDecodedContent(part, &position, buffer, sizeof(buffer))) > 0)
+ *     fwrite(buffer, 1, size, file);
+ * @endcode
+ * @param _part
+ *     A message or a part of message
+ * @param _position
+ *     Position in the encoded content to continue from. Must be zero before the first call
+ *     and must be passed unchanged to the subsequent calls
+ * @param _buffer
+ *     Buffer for the decoded data
+ * @param _buffer_size
+ *     Size of @a _buffer. Must be at least 3 bytes to hold a base64 quantum
+ * @return
+ *     Number of bytes written to @a _buffer. Zero is returned when the whole content is decoded
+ * @sa muMimeToPart
+ * @ingroup mime
+ */
+MU_API size_t MU_CALL muMimeDecodedContent(MU_MimePart * _part, size_t * _position, char * _buffer, size_t _buffer_size);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,438 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of the MailUnit Library.                                                  *
+ *                                                                                             *
+ * MailUnit Library is free software: you can redistribute it and/or modify it under the terms *
+ * of the GNU Lesser General Public License as published by the Free Software Foundation,      *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit Library is distributed in the hope that it will be useful, but WITHOUT ANY         *
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR  *
+ * PURPOSE. See the GNU Lesser General Public License for more details.                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU License General Public License along with        *
+ * MailUnit Library. If not, see <http://www.gnu.org/licenses>.                                *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <LibMailUnit/Message/EncodedWord.h>
+#include <LibMailUnit/Message/AddressList.h>
+
+using namespace LibMailUnit::Message;
+
+namespace {
+
+inline bool isWhiteSpace(char _symbol)
+{
+    return ' ' == _symbol || '\t' == _symbol || '\r' == _symbol || '\n' == _symbol;
+}
+
+inline bool isWordDelimiter(char _symbol)
+{
+    switch(_symbol)
+    {
+    case '(':
+    case '"':
+    case '<':
+    case ',':
+    case ';':
+    case ':':
+        return true;
+    default:
+        return isWhiteSpace(_symbol);
+    }
+}
+
+// Both functions are called at the opening symbol and return the position after the closing one.
+
+const char * skipComment(const char * _position, const char * _end)
+{
+    size_t depth = 0;
+    for(; _position < _end; ++_position)
+    {
+        switch(*_position)
+        {
+        case '\\':
+            if(_position + 1 < _end)
+                ++_position;
+            break;
+        case '(':
+            ++depth;
+            break;
+        case ')':
+            if(0 == --depth)
+                return _position + 1;
+            break;
+        }
+    }
+    return _end;
+}
+
+const char * skipQuotedString(const char * _position, const char * _end)
+{
+    for(++_position; _position < _end; ++_position)
+    {
+        if('\\' == *_position)
+        {
+            if(_position + 1 < _end)
+                ++_position;
+        }
+        else if('"' == *_position)
+        {
+            return _position + 1;
+        }
+    }
+    return _end;
+}
+
+// Collects the words of the source range the same way the parser writes a display name to the arena.
+// It is used when the arena is over and the phrase has to be decoded only to count its length.
+std::string collectPhrase(const char * _position, const char * _end)
+{
+    std::string phrase;
+    bool started = false;
+    bool separate_word = false;
+    while(_position < _end)
+    {
+        if(isWhiteSpace(*_position))
+        {
+            ++_position;
+            separate_word = started;
+            continue;
+        }
+        if('(' == *_position)
+        {
+            _position = skipComment(_position, _end);
+            separate_word = started;
+            continue;
+        }
+        if(separate_word)
+        {
+            phrase.push_back(' ');
+            separate_word = false;
+        }
+        started = true;
+        if('"' == *_position)
+        {
+            for(++_position; _position < _end; ++_position)
+            {
+                char symbol = *_position;
+                if('"' == symbol)
+                {
+                    ++_position;
+                    break;
+                }
+                if('\\' == symbol && _position + 1 < _end)
+                    symbol = *++_position;
+                else if('\r' == symbol || '\n' == symbol)
+                    continue;
+                phrase.push_back(symbol);
+            }
+        }
+        else
+        {
+            const char * begin = _position;
+            do
+            {
+                ++_position;
+            }
+            while(_position < _end && !isWordDelimiter(*_position));
+            phrase.append(begin, _position);
+        }
+    }
+    return phrase;
+}
+
+inline bool hasEncodedWord(const char * _text, size_t _length)
+{
+    const char * end = _text + _length;
+    for(;;)
+    {
+        const char * marker = static_cast<const char *>(std::memchr(_text, '=', end - _text));
+        if(nullptr == marker || marker + 1 >= end)
+            return false;
+        if('?' == marker[1])
+            return true;
+        _text = marker + 1;
+    }
+}
+
+class AddressListParser final
+{
+public:
+    AddressListParser(const char * _input, size_t _length, AddressArena & _arena, AddressListHandler & _handler) :
+        mp_position(_input),
+        mp_end(_input + _length),
+        mr_arena(_arena),
+        mr_handler(_handler),
+        m_in_group(false),
+        m_group(AddressListHandler::none)
+    {
+        startPhrase();
+    }
+
+    void parse();
+
+private:
+    void startPhrase();
+    void skipCfws();
+    void startWord();
+    void readQuotedString();
+    void readAtom();
+    size_t finishPhrase();
+    void readAngleAddress();
+    void flushAddressSpec();
+    size_t writeAddress(const char * _begin, const char * _end);
+
+private:
+    const char * mp_position;
+    const char * mp_end;
+    AddressArena & mr_arena;
+    AddressListHandler & mr_handler;
+    bool m_in_group;
+    size_t m_group;
+    // The words before the next delimiter are collected as a display name. If they turn out to be an addr-spec,
+    // the collected name is dropped and the address is taken from the source range of the words.
+    size_t m_phrase;
+    const char * mp_phrase_begin;
+    const char * mp_phrase_end;
+    bool m_separate_word;
+}; // class AddressListParser
+
+void AddressListParser::parse()
+{
+    for(;;)
+    {
+        skipCfws();
+        if(mp_position == mp_end)
+            break;
+        switch(*mp_position)
+        {
+        case '"':
+            readQuotedString();
+            break;
+        case '<':
+            readAngleAddress();
+            break;
+        case ':':
+            if(m_in_group)
+            {
+                readAtom();
+                break;
+            }
+            ++mp_position;
+            m_group = finishPhrase();
+            m_in_group = true;
+            if(AddressListHandler::none != m_group)
+                mr_handler.onGroup(m_group);
+            startPhrase();
+            break;
+        case ';':
+            ++mp_position;
+            flushAddressSpec();
+            m_in_group = false;
+            m_group = AddressListHandler::none;
+            startPhrase();
+            break;
+        case ',':
+            ++mp_position;
+            flushAddressSpec();
+            break;
+        default:
+            readAtom();
+            break;
+        }
+    }
+    flushAddressSpec();
+}
+
+void AddressListParser::startPhrase()
+{
+    m_phrase = mr_arena.used();
+    mp_phrase_begin = nullptr;
+    mp_phrase_end = nullptr;
+    m_separate_word = false;
+}
+
+void AddressListParser::skipCfws()
+{
+    const char * start = mp_position;
+    while(mp_position < mp_end)
+    {
+        if(isWhiteSpace(*mp_position))
+            ++mp_position;
+        else if('(' == *mp_position)
+            mp_position = skipComment(mp_position, mp_end);
+        else
+            break;
+    }
+    if(start != mp_position && nullptr != mp_phrase_begin)
+        m_separate_word = true;
+}
+
+void AddressListParser::startWord()
+{
+    if(m_separate_word)
+    {
+        mr_arena.push(' ');
+        m_separate_word = false;
+    }
+    if(nullptr == mp_phrase_begin)
+        mp_phrase_begin = mp_position;
+}
+
+void AddressListParser::readQuotedString()
+{
+    startWord();
+    for(++mp_position; mp_position < mp_end; ++mp_position)
+    {
+        char symbol = *mp_position;
+        if('"' == symbol)
+        {
+            ++mp_position;
+            break;
+        }
+        if('\\' == symbol && mp_position + 1 < mp_end)
+            symbol = *++mp_position;
+        else if('\r' == symbol || '\n' == symbol)
+            continue;
+        mr_arena.push(symbol);
+    }
+    mp_phrase_end = mp_position;
+}
+
+void AddressListParser::readAtom()
+{
+    startWord();
+    const char * begin = mp_position;
+    do
+    {
+        ++mp_position;
+    }
+    while(mp_position < mp_end && !isWordDelimiter(*mp_position));
+    mr_arena.push(begin, mp_position - begin);
+    mp_phrase_end = mp_position;
+}
+
+size_t AddressListParser::finishPhrase()
+{
+    size_t length = mr_arena.used() - m_phrase;
+    if(0 == length)
+        return AddressListHandler::none;
+    // Decoded words can be longer than the source ones, so an overflowed phrase is collected again from the source
+    // to report the size the arena really needs.
+    std::string phrase;
+    if(!mr_arena.overflowed())
+    {
+        if(hasEncodedWord(mr_arena.data() + m_phrase, length))
+            phrase.assign(mr_arena.data() + m_phrase, length);
+    }
+    else
+    {
+        phrase = collectPhrase(mp_phrase_begin, mp_phrase_end);
+        if(!hasEncodedWord(phrase.data(), phrase.size()))
+            phrase.clear();
+    }
+    if(!phrase.empty())
+    {
+        std::string decoded = decodeEncodedWords(phrase);
+        mr_arena.rewind(m_phrase);
+        mr_arena.push(decoded.data(), decoded.size());
+    }
+    mr_arena.push('\0');
+    return m_phrase;
+}
+
+void AddressListParser::readAngleAddress()
+{
+    size_t name = finishPhrase();
+    const char * begin = ++mp_position;
+    while(mp_position < mp_end && '>' != *mp_position)
+    {
+        if('"' == *mp_position)
+            mp_position = skipQuotedString(mp_position, mp_end);
+        else if('(' == *mp_position)
+            mp_position = skipComment(mp_position, mp_end);
+        else
+            ++mp_position;
+    }
+    const char * end = mp_position;
+    if(mp_position < mp_end)
+        ++mp_position;
+    // The obsolete route (@domain,@domain:) precedes the addr-spec
+    const char * route = begin;
+    while(route < end && isWhiteSpace(*route))
+        ++route;
+    if(route < end && '@' == *route)
+    {
+        const char * colon = static_cast<const char *>(std::memchr(route, ':', end - route));
+        if(nullptr != colon)
+            begin = colon + 1;
+    }
+    size_t address = writeAddress(begin, end);
+    if(AddressListHandler::none == address)
+        mr_arena.rewind(m_phrase);
+    else
+        mr_handler.onMailbox(m_group, name, address);
+    startPhrase();
+}
+
+void AddressListParser::flushAddressSpec()
+{
+    mr_arena.rewind(m_phrase);
+    if(nullptr != mp_phrase_begin)
+    {
+        size_t address = writeAddress(mp_phrase_begin, mp_phrase_end);
+        if(AddressListHandler::none != address)
+            mr_handler.onMailbox(m_group, AddressListHandler::none, address);
+    }
+    startPhrase();
+}
+
+size_t AddressListParser::writeAddress(const char * _begin, const char * _end)
+{
+    size_t start = mr_arena.used();
+    while(_begin < _end)
+    {
+        if(isWhiteSpace(*_begin))
+        {
+            ++_begin;
+        }
+        else if('(' == *_begin)
+        {
+            _begin = skipComment(_begin, _end);
+        }
+        else if('"' == *_begin)
+        {
+            const char * quoted_end = skipQuotedString(_begin, _end);
+            mr_arena.push(_begin, quoted_end - _begin);
+            _begin = quoted_end;
+        }
+        else
+        {
+            mr_arena.push(*_begin++);
+        }
+    }
+    if(start == mr_arena.used())
+        return AddressListHandler::none;
+    mr_arena.push('\0');
+    return start;
+}
+
+} // namespace
+
+void AddressArena::push(const char * _data, size_t _length)
+{
+    if(m_used < m_size)
+        std::memcpy(mp_buffer + m_used, _data, std::min(_length, m_size - m_used));
+    m_used += _length;
+}
+
+void LibMailUnit::Message::parseAddressList(const char * _input, size_t _length, AddressArena & _arena,
+    AddressListHandler & _handler)
+{
+    AddressListParser(_input, _length, _arena, _handler).parse();
+}
@@ -0,0 +1,104 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of the MailUnit Library.                                                  *
+ *                                                                                             *
+ * MailUnit Library is free software: you can redistribute it and/or modify it under the terms *
+ * of the GNU Lesser General Public License as published by the Free Software Foundation,      *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit Library is distributed in the hope that it will be useful, but WITHOUT ANY         *
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR  *
+ * PURPOSE. See the GNU Lesser General Public License for more details.                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU License General Public License along with        *
+ * MailUnit Library. If not, see <http://www.gnu.org/licenses>.                                *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#ifndef __LIBMU_MESSAGE_ADDRESSLIST_H__
+#define __LIBMU_MESSAGE_ADDRESSLIST_H__
+
+#include <cstddef>
+
+namespace LibMailUnit {
+namespace Message {
+
+// Storage for the strings produced by the parseAddressList function. The strings are written to the caller's
+// buffer one after another and terminated by zeros. When the buffer is over, the arena stops writing
+// but keeps counting the size required.
+class AddressArena final
+{
+public:
+    AddressArena(char * _buffer, size_t _size) :
+        mp_buffer(_buffer),
+        m_size(_size),
+        m_used(0)
+    {
+    }
+
+    void push(char _symbol)
+    {
+        if(m_used < m_size)
+            mp_buffer[m_used] = _symbol;
+        ++m_used;
+    }
+
+    void push(const char * _data, size_t _length);
+
+    size_t used() const
+    {
+        return m_used;
+    }
+
+    void rewind(size_t _position)
+    {
+        m_used = _position;
+    }
+
+    bool overflowed() const
+    {
+        return m_used > m_size;
+    }
+
+    const char * data() const
+    {
+        return mp_buffer;
+    }
+
+private:
+    char * mp_buffer;
+    size_t m_size;
+    size_t m_used;
+}; // class AddressArena
+
+
+// Receives the groups and mailboxes found by the parseAddressList function.
+// The strings are passed as offsets in the arena, AddressListHandler::none means an absent string.
+class AddressListHandler
+{
+public:
+    static const size_t none = static_cast<size_t>(-1);
+
+    virtual ~AddressListHandler()
+    {
+    }
+
+    // Called when a group is opened, so the name of a group without mailboxes is reported too.
+    virtual void onGroup(size_t _name)
+    {
+    }
+
+    virtual void onMailbox(size_t _group, size_t _name, size_t _address) = 0;
+}; // class AddressListHandler
+
+
+// Parses the RFC 5322 address-list in a single pass.
+// Quoted strings, comments, groups and angle addresses with obsolete routes are supported.
+// Display names are unquoted, their white spaces are collapsed and RFC 2047 encoded words are decoded.
+// Comments are dropped. A malformed address is taken as far as it can be recognized instead of failing the whole list.
+void parseAddressList(const char * _input, size_t _length, AddressArena & _arena, AddressListHandler & _handler);
+
+} // namespace Message
+} // namespace LibMailUnit
+
+#endif // __LIBMU_MESSAGE_ADDRESSLIST_H__
@@ -0,0 +1,155 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of the MailUnit Library.                                                  *
+ *                                                                                             *
+ * MailUnit Library is free software: you can redistribute it and/or modify it under the terms *
+ * of the GNU Lesser General Public License as published by the Free Software Foundation,      *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit Library is distributed in the hope that it will be useful, but WITHOUT ANY         *
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR  *
+ * PURPOSE. See the GNU Lesser General Public License for more details.                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU License General Public License along with        *
+ * MailUnit Library. If not, see <http://www.gnu.org/licenses>.                                *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <cerrno>
+#include <list>
+#include <utility>
+#include <boost/algorithm/string.hpp>
+#ifndef _WIN32
+#   include <iconv.h>
+#endif
+#include <LibMailUnit/Message/Charset.h>
+
+using namespace LibMailUnit::Message;
+
+namespace {
+
+void convertLatin1(const char * _data, size_t _length, std::string & _output)
+{
+    _output.reserve(_output.size() + _length * 2);
+    for(size_t i = 0; i < _length; ++i)
+    {
+        unsigned char symbol = static_cast<unsigned char>(_data[i]);
+        if(symbol < 0x80)
+        {
+            _output.push_back(static_cast<char>(symbol));
+        }
+        else
+        {
+            _output.push_back(static_cast<char>(0xC0 | symbol >> 6));
+            _output.push_back(static_cast<char>(0x80 | (symbol & 0x3F)));
+        }
+    }
+}
+
+#ifndef _WIN32
+
+// Keeps the converters of the recently used charsets. Failed conversions are not cached, so the names
+// coming from messages cannot grow the cache.
+class IconvCache
+{
+public:
+    ~IconvCache()
+    {
+        for(const auto & converter : m_converters)
+            iconv_close(converter.second);
+    }
+
+    // Returns the invalid_converter value if the charset is not supported.
+    iconv_t converter(const std::string & _charset)
+    {
+        for(auto it = m_converters.begin(); m_converters.end() != it; ++it)
+        {
+            if(_charset == it->first)
+            {
+                m_converters.splice(m_converters.begin(), m_converters, it);
+                return it->second;
+            }
+        }
+        iconv_t converter = iconv_open("UTF-8", _charset.c_str());
+        if(invalid_converter == converter)
+            return converter;
+        if(max_size == m_converters.size())
+        {
+            iconv_close(m_converters.back().second);
+            m_converters.pop_back();
+        }
+        m_converters.emplace_front(_charset, converter);
+        return converter;
+    }
+
+public:
+    static const iconv_t invalid_converter;
+    static const size_t max_size = 8;
+
+private:
+    std::list<std::pair<std::string, iconv_t>> m_converters;
+}; // class IconvCache
+
+const iconv_t IconvCache::invalid_converter = reinterpret_cast<iconv_t>(-1);
+
+bool convertWithIconv(const std::string & _charset, const char * _data, size_t _length, std::string & _output)
+{
+    static thread_local IconvCache cache;
+    iconv_t converter = cache.converter(_charset);
+    if(IconvCache::invalid_converter == converter)
+        return false;
+    iconv(converter, nullptr, nullptr, nullptr, nullptr);
+    const size_t output_size = _output.size();
+    char * input = const_cast<char *>(_data);
+    size_t input_left = _length;
+    size_t written = output_size;
+    _output.resize(output_size + _length * 2 + 16);
+    for(;;)
+    {
+        char * output = &_output[written];
+        size_t output_left = _output.size() - written;
+        size_t result = iconv(converter, &input, &input_left, &output, &output_left);
+        written = output - _output.data();
+        if(static_cast<size_t>(-1) != result)
+        {
+            // Flushes the shift sequence of stateful charsets.
+            output_left = _output.size() - written;
+            result = iconv(converter, nullptr, nullptr, &output, &output_left);
+            written = output - _output.data();
+            if(static_cast<size_t>(-1) != result)
+                break;
+        }
+        if(E2BIG != errno)
+        {
+            _output.resize(output_size);
+            return false;
+        }
+        _output.resize(_output.size() * 2);
+    }
+    _output.resize(written);
+    return true;
+}
+
+#endif
+
+} // namespace
+
+bool LibMailUnit::Message::convertToUtf8(const std::string & _charset, const char * _data, size_t _length,
+    std::string & _output)
+{
+    if(boost::algorithm::iequals("utf-8", _charset) || boost::algorithm::iequals("us-ascii", _charset))
+    {
+        _output.append(_data, _length);
+        return true;
+    }
+    if(boost::algorithm::iequals("iso-8859-1", _charset))
+    {
+        convertLatin1(_data, _length, _output);
+        return true;
+    }
+#ifdef _WIN32
+    return false;
+#else
+    return convertWithIconv(boost::algorithm::to_lower_copy(_charset), _data, _length, _output);
+#endif
+}
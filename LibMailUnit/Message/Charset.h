@@ -0,0 +1,35 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of the MailUnit Library.                                                  *
+ *                                                                                             *
+ * MailUnit Library is free software: you can redistribute it and/or modify it under the terms *
+ * of the GNU Lesser General Public License as published by the Free Software Foundation,      *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit Library is distributed in the hope that it will be useful, but WITHOUT ANY         *
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR  *
+ * PURPOSE. See the GNU Lesser General Public License for more details.                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU License General Public License along with        *
+ * MailUnit Library. If not, see <http://www.gnu.org/licenses>.                                *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#ifndef __LIBMU_MESSAGE_CHARSET_H__
+#define __LIBMU_MESSAGE_CHARSET_H__
+
+#include <string>
+
+namespace LibMailUnit {
+namespace Message {
+
+// Appends the _data converted from the _charset to UTF-8 to the _output.
+// Returns false and leaves the _output unchanged if the charset is not supported or the data are malformed.
+// UTF-8, US-ASCII and ISO-8859-1 are converted in place, other charsets are converted with iconv.
+// The iconv descriptors are cached per thread, so the conversion does not open them for each message.
+bool convertToUtf8(const std::string & _charset, const char * _data, size_t _length, std::string & _output);
+
+} // namespace Message
+} // namespace LibMailUnit
+
+#endif // __LIBMU_MESSAGE_CHARSET_H__
@@ -0,0 +1,211 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of the MailUnit Library.                                                  *
+ *                                                                                             *
+ * MailUnit Library is free software: you can redistribute it and/or modify it under the terms *
+ * of the GNU Lesser General Public License as published by the Free Software Foundation,      *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit Library is distributed in the hope that it will be useful, but WITHOUT ANY         *
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR  *
+ * PURPOSE. See the GNU Lesser General Public License for more details.                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU License General Public License along with        *
+ * MailUnit Library. If not, see <http://www.gnu.org/licenses>.                                *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <algorithm>
+#include <cctype>
+#include <boost/algorithm/string.hpp>
+#include <LibMailUnit/Message/Charset.h>
+#include <LibMailUnit/Message/TransferEncoding.h>
+#include <LibMailUnit/Message/EncodedWord.h>
+
+using namespace LibMailUnit::Message;
+
+namespace {
+
+// encoded-word = "=?" charset "?" encoding "?" encoded-text "?="
+struct EncodedWord
+{
+    size_t begin;
+    size_t end;
+    std::string charset;
+    char encoding;
+    size_t text_begin;
+    size_t text_end;
+}; // struct EncodedWord
+
+class EncodedWordDecoder
+{
+public:
+    explicit EncodedWordDecoder(const std::string & _text) :
+        mr_text(_text),
+        m_run_begin(std::string::npos),
+        m_run_end(std::string::npos),
+        m_separator_begin(std::string::npos),
+        m_previous_run_decoded(true)
+    {
+    }
+
+    std::string decode();
+
+private:
+    bool parseWord(size_t _begin, EncodedWord & _word) const;
+    void decodeWord(const EncodedWord & _word);
+    void flush();
+
+private:
+    const std::string & mr_text;
+    std::string m_result;
+    std::string m_charset;
+    std::string m_data;
+    size_t m_run_begin;
+    size_t m_run_end;
+    size_t m_separator_begin;
+    bool m_previous_run_decoded;
+}; // class EncodedWordDecoder
+
+inline bool isSpace(char _symbol)
+{
+    return ' ' == _symbol || '\t' == _symbol || '\r' == _symbol || '\n' == _symbol;
+}
+
+inline int hexValue(char _symbol)
+{
+    if(_symbol >= '0' && _symbol <= '9')
+        return _symbol - '0';
+    if(_symbol >= 'A' && _symbol <= 'F')
+        return _symbol - 'A' + 10;
+    if(_symbol >= 'a' && _symbol <= 'f')
+        return _symbol - 'a' + 10;
+    return -1;
+}
+
+} // namespace
+
+std::string LibMailUnit::Message::decodeEncodedWords(const std::string & _text)
+{
+    if(std::string::npos == _text.find("=?"))
+        return _text;
+    return EncodedWordDecoder(_text).decode();
+}
+
+std::string EncodedWordDecoder::decode()
+{
+    m_result.reserve(mr_text.size());
+    size_t position = 0;
+    for(size_t begin = mr_text.find("=?"); std::string::npos != begin; begin = mr_text.find("=?", begin))
+    {
+        EncodedWord word;
+        if(!parseWord(begin, word))
+        {
+            begin += 2;
+            continue;
+        }
+        // Linear white spaces between adjacent encoded words are ignored.
+        bool adjacent = std::string::npos != m_run_end &&
+            std::all_of(mr_text.begin() + position, mr_text.begin() + begin, isSpace);
+        if(!adjacent)
+        {
+            flush();
+            m_result.append(mr_text, position, begin - position);
+            m_previous_run_decoded = true;
+        }
+        else if(!boost::algorithm::iequals(m_charset, word.charset))
+        {
+            flush();
+            m_separator_begin = position;
+        }
+        decodeWord(word);
+        position = begin = word.end;
+    }
+    flush();
+    m_result.append(mr_text, position, std::string::npos);
+    return std::move(m_result);
+}
+
+bool EncodedWordDecoder::parseWord(size_t _begin, EncodedWord & _word) const
+{
+    size_t charset_end = mr_text.find('?', _begin + 2);
+    if(std::string::npos == charset_end || charset_end == _begin + 2 || charset_end + 2 >= mr_text.size() ||
+        '?' != mr_text[charset_end + 2])
+    {
+        return false;
+    }
+    _word.encoding = static_cast<char>(std::toupper(static_cast<unsigned char>(mr_text[charset_end + 1])));
+    if('B' != _word.encoding && 'Q' != _word.encoding)
+        return false;
+    _word.text_begin = charset_end + 3;
+    _word.text_end = mr_text.find("?=", _word.text_begin);
+    if(std::string::npos == _word.text_end)
+        return false;
+    for(size_t i = _begin + 2; i < _word.text_end; ++i)
+    {
+        if(isSpace(mr_text[i]))
+            return false;
+    }
+    _word.begin = _begin;
+    _word.end = _word.text_end + 2;
+    // The language of RFC 2231 is ignored.
+    size_t charset_length = std::min(mr_text.find('*', _begin + 2), charset_end) - _begin - 2;
+    _word.charset.assign(mr_text, _begin + 2, charset_length);
+    return true;
+}
+
+void EncodedWordDecoder::decodeWord(const EncodedWord & _word)
+{
+    // Words of the same charset are converted at once, because a multibyte symbol can be split between them.
+    if(std::string::npos == m_run_begin)
+    {
+        m_run_begin = _word.begin;
+        m_charset = _word.charset;
+    }
+    m_run_end = _word.end;
+    const char * text = &mr_text[_word.text_begin];
+    size_t length = _word.text_end - _word.text_begin;
+    if('B' == _word.encoding)
+    {
+        size_t size = m_data.size();
+        m_data.resize(size + length / 4 * 3 + 3);
+        size_t position = 0;
+        size += decodeBase64(text, length, position, &m_data[size], m_data.size() - size);
+        m_data.resize(size);
+        return;
+    }
+    for(size_t i = 0; i < length; ++i)
+    {
+        int high, low;
+        if('_' == text[i])
+        {
+            m_data.push_back(' ');
+        }
+        else if('=' == text[i] && i + 2 < length && (high = hexValue(text[i + 1])) >= 0 &&
+            (low = hexValue(text[i + 2])) >= 0)
+        {
+            m_data.push_back(static_cast<char>(high << 4 | low));
+            i += 2;
+        }
+        else
+        {
+            m_data.push_back(text[i]);
+        }
+    }
+}
+
+void EncodedWordDecoder::flush()
+{
+    if(std::string::npos == m_run_begin)
+        return;
+    // The spaces between two adjacent runs are kept if any of them is not decoded.
+    size_t result_size = m_result.size();
+    bool decoded = convertToUtf8(m_charset, m_data.data(), m_data.size(), m_result);
+    if(std::string::npos != m_separator_begin && !(decoded && m_previous_run_decoded))
+        m_result.insert(result_size, mr_text, m_separator_begin, m_run_begin - m_separator_begin);
+    if(!decoded)
+        m_result.append(mr_text, m_run_begin, m_run_end - m_run_begin);
+    m_previous_run_decoded = decoded;
+    m_data.clear();
+    m_run_begin = m_run_end = m_separator_begin = std::string::npos;
+}
@@ -0,0 +1,33 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of the MailUnit Library.                                                  *
+ *                                                                                             *
+ * MailUnit Library is free software: you can redistribute it and/or modify it under the terms *
+ * of the GNU Lesser General Public License as published by the Free Software Foundation,      *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit Library is distributed in the hope that it will be useful, but WITHOUT ANY         *
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR  *
+ * PURPOSE. See the GNU Lesser General Public License for more details.                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU License General Public License along with        *
+ * MailUnit Library. If not, see <http://www.gnu.org/licenses>.                                *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#ifndef __LIBMU_MESSAGE_ENCODEDWORD_H__
+#define __LIBMU_MESSAGE_ENCODEDWORD_H__
+
+#include <string>
+
+namespace LibMailUnit {
+namespace Message {
+
+// Decodes the RFC 2047 encoded words of the _text to UTF-8.
+// Words that cannot be decoded are kept as is. Text without encoded words is returned without changes.
+std::string decodeEncodedWords(const std::string & _text);
+
+} // namespace Message
+} // namespace LibMailUnit
+
+#endif // __LIBMU_MESSAGE_ENCODEDWORD_H__
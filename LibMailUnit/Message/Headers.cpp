@@ -15,78 +15,198 @@
  *                                                                                             *
  ***********************************************************************************************/
 
-#include <sstream>
-#include <boost/iostreams/device/file_descriptor.hpp>
-#include <boost/iostreams/stream.hpp>
-#include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <cstring>
 #include <LibMailUnit/Message/Headers.h>
 
 using namespace LibMailUnit;
 using namespace LibMailUnit::Message;
 
-HeaderMap::~HeaderMap()
+namespace {
+
+inline bool isSpace(char _symbol)
 {
-    for(Header * header: *this)
-        delete header;
+    switch(_symbol)
+    {
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+    case '\v':
+    case '\f':
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Header names are ASCII, so folding does not need a locale.
+inline char foldCase(char _symbol)
+{
+    return _symbol >= 'A' && _symbol <= 'Z' ? _symbol - 'A' + 'a' : _symbol;
 }
 
-Header * HeaderMap::find(const std::string & _name) const
+bool isNameEqual(const char * _left, const char * _right)
 {
-    for(Header * header: *this)
+    for(; '\0' != *_left; ++_left, ++_right)
     {
-        if(boost::algorithm::iequals(_name, header->name))
-            return header;
+        if(foldCase(*_left) != foldCase(*_right))
+            return false;
     }
-    return nullptr;
+    return '\0' == *_right;
 }
 
+} // namespace
 
-HeaderParser::HeaderParser(std::istream & _input, HeaderMap & _output) :
-    mr_input(_input),
-    mr_output(_output)
+const Header * HeaderMap::find(const char * _name) const
 {
+    if(nullptr == _name)
+        return nullptr;
+    size_t index = findIndex(_name, hashName(_name));
+    return std::string::npos == index ? nullptr : &m_headers[index];
 }
 
-void HeaderParser::parse(std::istream & _input, HeaderMap & _output)
+// FNV-1a over the folded name.
+uint32_t HeaderMap::hashName(const char * _name)
 {
-    HeaderParser(_input, _output).parse();
+    uint32_t hash = 2166136261u;
+    for(; '\0' != *_name; ++_name)
+    {
+        hash ^= static_cast<unsigned char>(foldCase(*_name));
+        hash *= 16777619u;
+    }
+    return hash;
 }
 
-void HeaderParser::parse()
+void HeaderMap::reserveIndex(size_t _header_count)
 {
-    std::string line;
-    while(std::getline(mr_input, line))
+    // The load factor is kept below one half.
+    size_t capacity = 16;
+    while(capacity < _header_count * 2)
+        capacity *= 2;
+    if(capacity <= m_index.size())
+        return;
+    std::vector<IndexSlot> old_index(capacity, IndexSlot { 0, 0 });
+    m_index.swap(old_index);
+    for(const IndexSlot & slot : old_index)
     {
-        boost::algorithm::trim_right(line);
-        if(!parseLine(line))
-            break;
+        if(0 != slot.header)
+            addToIndex(slot.header - 1, slot.hash);
     }
-    cleanUp();
 }
 
-bool HeaderParser::parseLine(const std::string & _line)
+size_t HeaderMap::findIndex(const char * _name, uint32_t _hash) const
 {
-    if(_line.empty())
+    if(m_index.empty())
+        return std::string::npos;
+    size_t mask = m_index.size() - 1;
+    for(size_t i = _hash & mask; ; i = (i + 1) & mask)
     {
-        pushPair();
-        return false;
+        const IndexSlot & slot = m_index[i];
+        if(0 == slot.header)
+            return std::string::npos;
+        if(slot.hash == _hash && isNameEqual(_name, m_headers[slot.header - 1].mp_name))
+            return slot.header - 1;
     }
-    if(isWhiteSpaceSymbol(_line[0]))
+}
+
+void HeaderMap::addToIndex(size_t _header, uint32_t _hash)
+{
+    if((m_headers.size() + 1) * 2 > m_index.size())
+        reserveIndex(m_headers.size() + 1);
+    size_t mask = m_index.size() - 1;
+    size_t i = _hash & mask;
+    while(0 != m_index[i].header)
+        i = (i + 1) & mask;
+    m_index[i] = IndexSlot { _hash, static_cast<uint32_t>(_header + 1) };
+}
+
+
+HeaderParser::HeaderParser(std::vector<char> & _buffer, HeaderMap & _output) :
+    mp_data(_buffer.data()),
+    m_length(_buffer.size() - 1),
+    mr_output(_output),
+    mp_current_key(nullptr),
+    m_current_value_begin(0),
+    m_current_value_end(0)
+{
+}
+
+void HeaderParser::parse(const char * _data, size_t _length, HeaderMap & _output)
+{
+    size_t line_begin = 0;
+    size_t length = findEndOfHeaders(_data, _length, line_begin);
+    if(std::string::npos == length)
+        length = _length;
+    std::vector<char> & buffer = _output.m_buffer;
+    buffer.reserve(length + 1);
+    buffer.assign(_data, _data + length);
+    buffer.push_back('\0');
+    HeaderParser(buffer, _output).parse();
+}
+
+size_t HeaderParser::findEndOfHeaders(const char * _data, size_t _length, size_t & _line_begin)
+{
+    while(_line_begin < _length)
+    {
+        const char * line = &_data[_line_begin];
+        const char * end_of_line = static_cast<const char *>(std::memchr(line, '\n', _length - _line_begin));
+        if(nullptr == end_of_line)
+            break;
+        bool empty = std::all_of(line, end_of_line, isSpace);
+        _line_begin = end_of_line - _data + 1;
+        if(empty)
+            return _line_begin;
+    }
+    return std::string::npos;
+}
+
+void HeaderParser::parse()
+{
+    size_t line_count = std::count(mp_data, mp_data + m_length, '\n') + 1;
+    mr_output.m_headers.reserve(line_count);
+    mr_output.reserveIndex(line_count);
+    m_values.reserve(line_count);
+    size_t begin = 0;
+    while(begin < m_length)
     {
-        if(!m_current_key.empty())
-            m_current_value += _line;
+        const char * end_of_line = static_cast<const char *>(std::memchr(&mp_data[begin], '\n', m_length - begin));
+        size_t end = nullptr == end_of_line ? m_length : end_of_line - mp_data;
+        size_t trimmed_end = end;
+        while(trimmed_end > begin && isSpace(mp_data[trimmed_end - 1]))
+            --trimmed_end;
+        if(trimmed_end == begin)
+            break;
+        parseLine(begin, trimmed_end);
+        begin = end + 1;
     }
-    else
+    pushPair();
+    arrangeValues();
+}
+
+// Folded lines are unfolded in place: the buffer only shrinks, so a value never overlaps the next line.
+void HeaderParser::parseLine(size_t _begin, size_t _end)
+{
+    if(isWhiteSpaceSymbol(mp_data[_begin]))
     {
-        pushPair();
-        size_t colon_pos = _line.find(':');
-        if(std::string::npos != colon_pos)
+        if(nullptr != mp_current_key)
         {
-            m_current_key = _line.substr(0, colon_pos);
-            m_current_value = boost::algorithm::trim_copy(_line.substr(colon_pos + 1));
+            std::memmove(&mp_data[m_current_value_end], &mp_data[_begin], _end - _begin);
+            m_current_value_end += _end - _begin;
         }
+        return;
     }
-    return true;
+    pushPair();
+    char * colon = static_cast<char *>(std::memchr(&mp_data[_begin], ':', _end - _begin));
+    if(nullptr == colon)
+        return;
+    *colon = '\0';
+    mp_current_key = &mp_data[_begin];
+    size_t value_begin = colon - mp_data + 1;
+    while(value_begin < _end && isSpace(mp_data[value_begin]))
+        ++value_begin;
+    m_current_value_begin = value_begin;
+    m_current_value_end = _end;
 }
 
 bool HeaderParser::isWhiteSpaceSymbol(char _symbol) const
@@ -103,25 +223,46 @@ bool HeaderParser::isWhiteSpaceSymbol(char _symbol) const
 
 void HeaderParser::pushPair()
 {
-    if(!m_current_key.empty() && !m_current_value.empty())
+    if(nullptr != mp_current_key && '\0' != *mp_current_key && m_current_value_end > m_current_value_begin)
     {
-        Header * header = mr_output.find(m_current_key);
-        if(nullptr == header)
-        {
-            header = new Header(m_current_key);
-            header->values.push_back(m_current_value);
-            mr_output.push_back(header);
-        }
-        else
+        mp_data[m_current_value_end] = '\0';
+        std::vector<Header> & headers = mr_output.m_headers;
+        uint32_t hash = HeaderMap::hashName(mp_current_key);
+        size_t index = mr_output.findIndex(mp_current_key, hash);
+        if(std::string::npos == index)
         {
-            header->values.push_back(m_current_value);
+            index = headers.size();
+            mr_output.addToIndex(index, hash);
+            headers.push_back(Header(mp_current_key));
         }
+        ++headers[index].m_value_count;
+        m_values.push_back({ index, &mp_data[m_current_value_begin] });
     }
     cleanUp();
 }
 
 void HeaderParser::cleanUp()
 {
-    m_current_key.clear();
-    m_current_value.clear();
+    mp_current_key = nullptr;
+    m_current_value_begin = 0;
+    m_current_value_end = 0;
+}
+
+// Values of the same header can be interleaved with other headers. They are grouped
+// with a counting sort, so every header gets a contiguous slice of the value array.
+void HeaderParser::arrangeValues()
+{
+    std::vector<Header> & headers = mr_output.m_headers;
+    std::vector<const char *> & values = mr_output.m_values;
+    values.resize(m_values.size());
+    std::vector<size_t> positions(headers.size());
+    size_t position = 0;
+    for(size_t i = 0; i < headers.size(); ++i)
+    {
+        positions[i] = position;
+        headers[i].mp_values = values.data() + position;
+        position += headers[i].m_value_count;
+    }
+    for(const ValueEntry & entry : m_values)
+        values[positions[entry.header]++] = entry.value;
 }
@@ -18,52 +18,134 @@
 #ifndef __LIBMU_MESSAGE_HEADERS_H__
 #define __LIBMU_MESSAGE_HEADERS_H__
 
+#include <cstdint>
 #include <string>
 #include <vector>
-#include <istream>
 #include <memory>
+#include <boost/noncopyable.hpp>
 
 namespace LibMailUnit {
 namespace Message {
 
-struct Header
+class HeaderMap;
+
+class Header
 {
-    Header(const std::string & _name) :
-        name(_name)
+    friend class HeaderMap;
+    friend class HeaderParser;
+
+public:
+    const char * name() const
+    {
+        return mp_name;
+    }
+
+    size_t valueCount() const
     {
+        return m_value_count;
     }
 
-    const std::string name;
-    std::vector<std::string> values;
-}; // struct Header
+    const char * value(size_t _index) const
+    {
+        return _index < m_value_count ? mp_values[_index] : nullptr;
+    }
 
-class HeaderMap : public std::vector<Header *>
+    const char * const * values() const
+    {
+        return mp_values;
+    }
+
+private:
+    explicit Header(const char * _name) :
+        mp_name(_name),
+        mp_values(nullptr),
+        m_value_count(0)
+    {
+    }
+
+private:
+    const char * mp_name;
+    const char * const * mp_values;
+    size_t m_value_count;
+}; // class Header
+
+// Names and values point into a single buffer that holds the whole header block,
+// so a parsed map consists of a few contiguous allocations regardless of the header count.
+// Headers keep the insertion order, lookups by name go through an open addressing index.
+class HeaderMap : private boost::noncopyable
 {
+    friend class HeaderParser;
+
 public:
-    ~HeaderMap();
-    Header * find(const std::string & _name) const;
+    size_t size() const
+    {
+        return m_headers.size();
+    }
+
+    const Header * operator [] (size_t _index) const
+    {
+        return &m_headers[_index];
+    }
+
+    const Header * find(const char * _name) const;
+
+    const Header * find(const std::string & _name) const
+    {
+        return find(_name.c_str());
+    }
+
+private:
+    struct IndexSlot
+    {
+        uint32_t hash;
+        uint32_t header; // Index of the header plus one, zero marks an empty slot
+    }; // struct IndexSlot
+
+private:
+    static uint32_t hashName(const char * _name);
+    void reserveIndex(size_t _header_count);
+    size_t findIndex(const char * _name, uint32_t _hash) const;
+    void addToIndex(size_t _header, uint32_t _hash);
+
+private:
+    std::vector<char> m_buffer;
+    std::vector<Header> m_headers;
+    std::vector<const char *> m_values;
+    std::vector<IndexSlot> m_index;
 }; // class HeaderMap
 
 class HeaderParser
 {
 private:
-    HeaderParser(std::istream & _input, HeaderMap & _output);
+    HeaderParser(std::vector<char> & _buffer, HeaderMap & _output);
 
 public:
-    static void parse(std::istream & _input, HeaderMap &_output);
+    static void parse(const char * _data, size_t _length, HeaderMap & _output);
+    static size_t findEndOfHeaders(const char * _data, size_t _length, size_t & _line_begin);
 
 private:
     void parse();
-    bool parseLine(const std::string & _line);
+    void parseLine(size_t _begin, size_t _end);
     bool isWhiteSpaceSymbol(char _symbol) const;
     void pushPair();
     void cleanUp();
+    void arrangeValues();
+
+private:
+    struct ValueEntry
+    {
+        size_t header;
+        const char * value;
+    }; // struct ValueEntry
 
 private:
-    std::istream & mr_input;
+    char * mp_data;
+    size_t m_length;
     HeaderMap & mr_output;
-    std::string m_current_key;
-    std::string m_current_value;
+    std::vector<ValueEntry> m_values;
+    const char * mp_current_key;
+    size_t m_current_value_begin;
+    size_t m_current_value_end;
 }; // class HeaderParser
 
 } // namespace Message
@@ -15,61 +15,120 @@
  *                                                                                             *
  ***********************************************************************************************/
 
-#include <boost/algorithm/string.hpp>
+#include <vector>
+#include <LibMailUnit/Message/AddressList.h>
 #include <LibMailUnit/Message/Mailbox.h>
 
 using namespace LibMailUnit::Message;
 
-std::unique_ptr<Mailbox> Mailbox::parse(const std::string & _input)
+namespace {
+
+class MailboxCollector final : public AddressListHandler
 {
-    // TODO: process the case when the angle symbol is part of the quoted string
-    size_t open_angle_pos = _input.find('<');
-    if(std::string::npos == open_angle_pos)
+public:
+    struct Entry
+    {
+        size_t group;
+        size_t name;
+        size_t address;
+    };
+
+    MailboxCollector() :
+        m_group(none)
     {
-        return std::make_unique<Mailbox>(boost::algorithm::trim_copy(_input));
     }
-    size_t close_angle_pos = _input.find('>');
-    if(std::string::npos == close_angle_pos)
+
+    void onGroup(size_t _name) override
     {
-        return nullptr;
+        if(none == m_group)
+            m_group = _name;
     }
-    size_t mailbox_start_pos = open_angle_pos + 1;
-    size_t mailbox_len = close_angle_pos - mailbox_start_pos;
-    std::string name = boost::algorithm::trim_copy(_input.substr(0, open_angle_pos));
-    std::string address = boost::algorithm::trim_copy(_input.substr(mailbox_start_pos, mailbox_len));
-    return std::make_unique<Mailbox>(address, name);
-}
 
-MailboxGroup::MailboxGroup(const std::string & _input)
+    void onMailbox(size_t _group, size_t _name, size_t _address) override
+    {
+        m_entries.push_back({ _group, _name, _address });
+    }
+
+    // The name of the first group in the list or AddressListHandler::none
+    size_t group() const
+    {
+        return m_group;
+    }
+
+    const std::vector<Entry> & entries() const
+    {
+        return m_entries;
+    }
+
+    void clear()
+    {
+        m_group = none;
+        m_entries.clear();
+    }
+
+private:
+    size_t m_group;
+    std::vector<Entry> m_entries;
+}; // class MailboxCollector
+
+// Parses _input into _buffer growing it until all the strings fit.
+void collectMailboxes(const std::string & _input, std::vector<char> & _buffer, MailboxCollector & _collector)
 {
-    // TODO: process the case when the colon symbol is part of the quoted string or domain
-    size_t colon_pos = _input.find(':');
-    if(std::string::npos != colon_pos)
-        m_name = boost::trim_copy(_input.substr(0, colon_pos));
-    std::vector<std::string> raw_addresses;
-    boost::algorithm::split(raw_addresses,
-        std::string::npos == colon_pos ? _input : _input.substr(colon_pos + 1),
-        [](char symbol) { return ',' == symbol; });
-    for(const std::string & raw_address : raw_addresses)
+    _buffer.resize(_input.size() + 16);
+    for(;;)
     {
-        Mailbox * mailbox = Mailbox::parse(raw_address).release();
-        if(nullptr != mailbox)
-            m_mailboxes.push_back(mailbox);
+        AddressArena arena(_buffer.data(), _buffer.size());
+        _collector.clear();
+        parseAddressList(_input.data(), _input.size(), arena, _collector);
+        if(!arena.overflowed())
+            return;
+        _buffer.resize(arena.used());
     }
 }
 
+inline std::string arenaString(const std::vector<char> & _buffer, size_t _offset)
+{
+    return AddressListHandler::none == _offset ? std::string() : std::string(_buffer.data() + _offset);
+}
+
+} // namespace
+
+std::unique_ptr<Mailbox> Mailbox::parse(const std::string & _input)
+{
+    std::vector<char> buffer;
+    MailboxCollector collector;
+    collectMailboxes(_input, buffer, collector);
+    if(collector.entries().empty())
+        return nullptr;
+    const MailboxCollector::Entry & entry = collector.entries().front();
+    return std::make_unique<Mailbox>(arenaString(buffer, entry.address), arenaString(buffer, entry.name));
+}
+
+MailboxGroup::MailboxGroup(const std::string & _input)
+{
+    std::vector<char> buffer;
+    MailboxCollector collector;
+    collectMailboxes(_input, buffer, collector);
+    m_name = arenaString(buffer, collector.group());
+    m_mailboxes.reserve(collector.entries().size());
+    for(const MailboxCollector::Entry & entry : collector.entries())
+        m_mailboxes.push_back(new Mailbox(arenaString(buffer, entry.address), arenaString(buffer, entry.name)));
+}
+
 MailboxGroup::MailboxGroup(const MailboxGroup & _group) :
     m_name(_group.name()),
-    m_mailboxes(std::vector<Mailbox *>(_group.m_mailboxes.size()))
+    m_mailboxes()
 {
+    m_mailboxes.reserve(_group.m_mailboxes.size());
     for(const Mailbox * mailbox : _group.m_mailboxes)
         m_mailboxes.push_back(new Mailbox(*mailbox));
 }
 
 MailboxGroup::MailboxGroup(MailboxGroup && _group) :
-    m_name(std::move(_group.name())),
+    m_name(std::move(_group.m_name)),
     m_mailboxes(std::move(_group.m_mailboxes))
 {
+    _group.m_mailboxes.clear();
 }
 
 MailboxGroup::~MailboxGroup()
@@ -83,7 +142,8 @@ MailboxGroup & MailboxGroup::operator = (const MailboxGroup & _group)
         return *this;
     m_name = _group.m_name;
     release();
-    m_mailboxes.resize(_group.m_mailboxes.size());
+    m_mailboxes.clear();
+    m_mailboxes.reserve(_group.m_mailboxes.size());
     for(const Mailbox * mailbox : _group.m_mailboxes)
         m_mailboxes.push_back(new Mailbox(*mailbox));
     return *this;
@@ -93,8 +153,10 @@ MailboxGroup & MailboxGroup::operator = (MailboxGroup && _group)
 {
     if(this == &_group)
         return *this;
-    m_name = std::move(_group.name());
+    m_name = std::move(_group.m_name);
+    release();
     m_mailboxes = std::move(_group.m_mailboxes);
+    _group.m_mailboxes.clear();
     return *this;
 }
 
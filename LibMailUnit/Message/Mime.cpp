@@ -15,11 +15,11 @@
  *                                                                                             *
  ***********************************************************************************************/
 
+#include <algorithm>
+#include <cstring>
 #include <string>
-#include <sstream>
-#include <boost/iostreams/device/file_descriptor.hpp>
-#include <boost/iostreams/stream.hpp>
 #include <boost/algorithm/string.hpp>
+#include <LibMailUnit/Message/EncodedWord.h>
 #include <LibMailUnit/Message/Mime.h>
 #include <LibMailUnit/Api/Include/Message/MailHeader.h>
 
@@ -53,9 +53,55 @@ using namespace LibMailUnit::Message;
 #define CT_MESSAGE "message"
 #define CST_MESSAGE_RFC822 "rfc822"
 
-MimePart::MimePart(std::istream & _stream)
+namespace {
+
+// Searches for a line break followed by a multipart delimiter without splitting the content into lines.
+// Candidates are found by looking for the dash with memchr, which the C library vectorizes.
+// The base64 alphabet contains no dashes, so encoded attachments are skipped in a single call.
+class DelimiterFinder
 {
-    parse(_stream);
+public:
+    explicit DelimiterFinder(const std::string & _boundary) :
+        m_pattern("\n--" + _boundary)
+    {
+    }
+
+    size_t length() const
+    {
+        return m_pattern.size();
+    }
+
+    // Returns a position of the line break or std::string::npos.
+    size_t find(const char * _data, size_t _begin, size_t _end) const
+    {
+        const size_t length = m_pattern.size();
+        for(size_t position = _begin; position + length <= _end;)
+        {
+            const void * dash = std::memchr(&_data[position + 1], '-', _end - length - position + 1);
+            if(nullptr == dash)
+                break;
+            position = static_cast<const char *>(dash) - _data - 1;
+            if(0 == std::memcmp(&_data[position], m_pattern.data(), length))
+                return position;
+            position += 2; // The dash itself cannot start a match
+        }
+        return std::string::npos;
+    }
+
+private:
+    const std::string m_pattern;
+}; // class DelimiterFinder
+
+} // namespace
+
+MimePart::MimePart(const std::shared_ptr<const std::string> & _source, size_t _offset, size_t _length,
+    size_t _depth_limit) :
+    m_source_ptr(_source),
+    m_content_offset(_offset + _length),
+    m_content_length(0),
+    m_transfer_encoding(TransferEncoding::Identity)
+{
+    parse(_offset, _length, _depth_limit);
 }
 
 MimePart::~MimePart()
@@ -64,61 +110,60 @@ MimePart::~MimePart()
         delete part;
 }
 
-void MimePart::parse(std::istream & _stream)
+void MimePart::parse(size_t _offset, size_t _length, size_t _depth_limit)
 {
+    const char * data = m_source_ptr->data() + _offset;
+    size_t line_begin = 0;
+    size_t headers_length = HeaderParser::findEndOfHeaders(data, _length, line_begin);
+    if(std::string::npos == headers_length)
+        headers_length = _length;
     HeaderMap * map = new HeaderMap();
-    HeaderParser::parse(_stream, *map);
+    HeaderParser::parse(data, headers_length, *map);
     m_headers_ptr.reset(map);
-    Header * content_type_hdr = m_headers_ptr->find(MU_MAILHDR_CONTENTTYPE);
-    if(content_type_hdr && !content_type_hdr->values.empty())
-        m_content_type_ptr = parseContentType(content_type_hdr->values[0]);
+    m_content_offset = _offset + headers_length;
+    m_content_length = _length - headers_length;
+    const Header * content_type_hdr = m_headers_ptr->find(MU_MAILHDR_CONTENTTYPE);
+    if(content_type_hdr && content_type_hdr->valueCount() > 0)
+        m_content_type_ptr = parseContentType(content_type_hdr->value(0));
     if(!m_content_type_ptr)
         m_content_type_ptr.reset(new ContentType { CT_TEXT, CST_TEXT_PLAIN });
-    if(boost::iequals(CT_IMAGE, m_content_type_ptr->type))
-        parseImage(_stream);
-    else if(boost::iequals(CT_AUDIO, m_content_type_ptr->type))
-        parseAudio(_stream);
-    else if(boost::iequals(CT_VIDEO, m_content_type_ptr->type))
-        parseVideo(_stream);
-    else if(boost::iequals(CT_APPLICATION, m_content_type_ptr->type))
-        parseApplication(_stream);
-    else if(boost::iequals(CT_MULTIPART, m_content_type_ptr->type))
-        parseMultipart(_stream);
-    else if(boost::iequals(CT_MESSAGE, m_content_type_ptr->type))
-        parseMessage(_stream);
-    else
-        parseText(_stream);
-}
-
-void MimePart::parseText(std::istream & _stream)
-{
-    const size_t buffer_size = 1024;
-    char buffer[buffer_size];
-    while(_stream.read(buffer, buffer_size) || _stream.gcount())
-        m_text_content.append(buffer, buffer + _stream.gcount());
-}
-
-void MimePart::parseImage(std::istream & _stream)
-{
-    parseText(_stream);
-}
-
-void MimePart::parseAudio(std::istream & _stream)
-{
-    parseText(_stream);
+    const Header * encoding_hdr = m_headers_ptr->find(MU_MAILHDR_CONTENTTRANSFERENCODING);
+    if(encoding_hdr && encoding_hdr->valueCount() > 0)
+        m_transfer_encoding = parseTransferEncoding(encoding_hdr->value(0));
+    if(0 == _depth_limit)
+        return;
+    if(boost::iequals(CT_MULTIPART, m_content_type_ptr->type))
+        parseMultipart(_depth_limit - 1);
+    else if(boost::iequals(CT_MESSAGE, m_content_type_ptr->type) &&
+        boost::iequals(CST_MESSAGE_RFC822, m_content_type_ptr->subtype) &&
+        TransferEncoding::Identity == m_transfer_encoding) // RFC 2046 does not allow other encodings
+        parseMessage(_depth_limit - 1);
 }
 
-void MimePart::parseVideo(std::istream & _stream)
+const std::string & MimePart::text() const
 {
-    parseText(_stream);
+    std::call_once(m_text_content_flag, [this]() {
+        const char * content = m_source_ptr->data() + m_content_offset;
+        m_text_content.assign(content, m_content_length);
+    });
+    return m_text_content;
 }
 
-void MimePart::parseApplication(std::istream & _stream)
+size_t MimePart::decode(size_t & _position, char * _output, size_t _output_size) const
 {
-    parseText(_stream);
+    const char * content = m_source_ptr->data() + m_content_offset;
+    switch(m_transfer_encoding)
+    {
+    case TransferEncoding::Base64:
+        return decodeBase64(content, m_content_length, _position, _output, _output_size);
+    case TransferEncoding::QuotedPrintable:
+        return decodeQuotedPrintable(content, m_content_length, _position, _output, _output_size);
+    default:
+        return decodeIdentity(content, m_content_length, _position, _output, _output_size);
+    }
 }
 
-void MimePart::parseMultipart(std::istream & _stream)
+void MimePart::parseMultipart(size_t _depth_limit)
 {
     std::vector<ContentTypeParam>::const_iterator boundary_it = std::find_if(m_content_type_ptr->params.cbegin(),
         m_content_type_ptr->params.cend(), [](const ContentTypeParam & param) {
@@ -129,65 +174,91 @@ void MimePart::parseMultipart(std::istream & _stream)
         // TODO: error!
         return;
     }
-    const std::string boundary_start = std::string("--") + boundary_it->value;
-    const std::string boundary_end = boundary_start + "--";
-    std::stringstream * body = new std::stringstream();
-    std::string line;
-    bool body_open = false;
-    while(std::getline(_stream, line))
+    if(0 == m_content_length)
+        return;
+    const DelimiterFinder finder(boundary_it->value);
+    const char * data = m_source_ptr->data();
+    const size_t end = m_content_offset + m_content_length;
+    // A non-empty content always follows the line break that terminates the headers,
+    // so a delimiter in the first line of the content is found as well.
+    size_t search_begin = m_content_offset - 1;
+    size_t part_begin = std::string::npos;
+    for(;;)
     {
-        if(boost::starts_with(line, boundary_end))
-        {
-            if(body_open)
-            {
-                m_parts.push_back(new MimePart(*body));
-                body_open = false;
-            }
+        size_t delimiter = finder.find(data, search_begin, end);
+        if(std::string::npos == delimiter)
             break;
-        }
-        else if(boost::starts_with(line, boundary_start))
-        {
-            if(body_open)
-            {
-                m_parts.push_back(new MimePart(*body));
-                delete body;
-                body = new std::stringstream();
-            }
-            else
-            {
-                body_open = true;
-            }
-        }
-        else if(body_open)
+        if(std::string::npos != part_begin)
         {
-            (*body) << line << "\n";
+            // The line break before a delimiter belongs to the delimiter.
+            size_t part_end = std::max(delimiter, part_begin);
+            if(part_end > part_begin && '\r' == data[part_end - 1])
+                --part_end;
+            m_parts.push_back(new MimePart(m_source_ptr, part_begin, part_end - part_begin, _depth_limit));
         }
+        size_t suffix = delimiter + finder.length();
+        if(suffix + 2 <= end && '-' == data[suffix] && '-' == data[suffix + 1])
+            return;
+        const char * end_of_line = static_cast<const char *>(std::memchr(&data[suffix], '\n', end - suffix));
+        if(nullptr == end_of_line)
+            return;
+        search_begin = end_of_line - data;
+        part_begin = search_begin + 1;
     }
-    if(body_open)
-    {
-        m_parts.push_back(new MimePart(*body));
-    }
-    delete body;
+    if(std::string::npos != part_begin)
+        m_parts.push_back(new MimePart(m_source_ptr, part_begin, end - part_begin, _depth_limit));
+}
+
+void MimePart::parseMessage(size_t _depth_limit)
+{
+    m_parts.push_back(new MimeMessage(m_source_ptr, m_content_offset, m_content_length, _depth_limit));
 }
 
-void MimePart::parseMessage(std::istream & _stream)
+MimeMessage::MimeMessage(std::istream & _stream, size_t _depth_limit) :
+    MimeMessage(readSource(_stream), _depth_limit)
 {
-    // TODO: implement
-    throw std::runtime_error("The message MIME is not supported yet");
 }
 
-MimeMessage::MimeMessage(std::istream & _stream) :
-    MimePart(_stream)
+MimeMessage::MimeMessage(std::string && _source, size_t _depth_limit) :
+    MimeMessage(std::make_shared<const std::string>(std::move(_source)), _depth_limit)
+{
+}
+
+MimeMessage::MimeMessage(const std::shared_ptr<const std::string> & _source, size_t _depth_limit) :
+    MimeMessage(_source, 0, _source->size(), _depth_limit)
+{
+}
+
+MimeMessage::MimeMessage(const std::shared_ptr<const std::string> & _source, size_t _offset, size_t _length,
+    size_t _depth_limit) :
+    MimePart(_source, _offset, _length, _depth_limit)
 {
     const Header * subject_header = headers().find(MU_MAILHDR_SUBJECT);
-    if(subject_header && !subject_header->values.empty())
-        m_subject = subject_header->values[0];
+    if(subject_header && subject_header->valueCount() > 0)
+        m_subject = decodeEncodedWords(subject_header->value(0));
     parseAddresses(MU_MAILHDR_FROM, m_from_addresses);
     parseAddresses(MU_MAILHDR_TO, m_to_addresses);
     parseAddresses(MU_MAILHDR_CC, m_cc_addresses);
     parseAddresses(MU_MAILHDR_BCC, m_bcc_addresses);
 }
 
+std::shared_ptr<const std::string> MimeMessage::readSource(std::istream & _stream)
+{
+    const size_t buffer_size = 64 * 1024;
+    std::shared_ptr<std::string> source = std::make_shared<std::string>();
+    size_t size = 0;
+    for(;;)
+    {
+        source->resize(size + buffer_size);
+        _stream.read(&(*source)[size], buffer_size);
+        size += _stream.gcount();
+        if(!_stream)
+            break;
+    }
+    source->resize(size);
+    return source;
+}
+
 MimeMessage::~MimeMessage()
 {
     for(const auto & addresses : { m_from_addresses, m_to_addresses, m_cc_addresses, m_bcc_addresses })
@@ -200,8 +271,8 @@ MimeMessage::~MimeMessage()
 void MimeMessage::parseAddresses(const char * _header_name, std::vector<const MailboxGroup *> & _out)
 {
     const Header * header = headers().find(_header_name);
-    if(!header || header->values.empty())
+    if(!header)
         return;
-    for(const std::string & header_value : header->values)
-        _out.push_back(new MailboxGroup(header_value));
+    for(size_t i = 0; i < header->valueCount(); ++i)
+        _out.push_back(new MailboxGroup(header->value(i)));
 }
@@ -19,20 +19,26 @@
 #define __LIBMU_MESSAGE_MIME_H__
 
 #include <memory>
+#include <mutex>
 #include <istream>
+#include <string>
 #include <vector>
 #include <boost/noncopyable.hpp>
 #include <LibMailUnit/Message/Headers.h>
 #include <LibMailUnit/Message/ContentType.h>
+#include <LibMailUnit/Message/TransferEncoding.h>
 #include <LibMailUnit/Message/Mailbox.h>
 
 namespace LibMailUnit {
 namespace Message {
 
+// A part is a range of the message source. Only the headers are copied while parsing,
+// the content is materialized on the first call to the text method.
+// Nested parts are parsed while the _depth_limit is not exhausted, deeper parts are left as plain content.
 class MimePart : private boost::noncopyable
 {
 public:
-    explicit MimePart(std::istream & _stream);
+    MimePart(const std::shared_ptr<const std::string> & _source, size_t _offset, size_t _length, size_t _depth_limit);
     virtual ~MimePart();
 
     const HeaderMap & headers() const
@@ -50,32 +56,54 @@ public:
         return m_parts;
     }
 
-    const std::string & text() const
+    size_t contentOffset() const
     {
-        return m_text_content;
+        return m_content_offset;
     }
 
+    size_t contentLength() const
+    {
+        return m_content_length;
+    }
+
+    const std::string & text() const;
+
+    TransferEncoding transferEncoding() const
+    {
+        return m_transfer_encoding;
+    }
+
+    // Decodes the content by chunks, see the decoders in the TransferEncoding.h for details.
+    size_t decode(size_t & _position, char * _output, size_t _output_size) const;
+
 private:
-    void parse(std::istream & _stream);
-    void parseText(std::istream & _stream);
-    void parseImage(std::istream & _stream);
-    void parseAudio(std::istream & _stream);
-    void parseVideo(std::istream & _stream);
-    void parseApplication(std::istream & _stream);
-    void parseMultipart(std::istream & _stream);
-    void parseMessage(std::istream & _stream);
+    void parse(size_t _offset, size_t _length, size_t _depth_limit);
+    void parseMultipart(size_t _depth_limit);
+    void parseMessage(size_t _depth_limit);
 
 private:
+    std::shared_ptr<const std::string> m_source_ptr;
+    size_t m_content_offset;
+    size_t m_content_length;
     std::shared_ptr<HeaderMap> m_headers_ptr;
     std::shared_ptr<ContentType> m_content_type_ptr;
-    std::string m_text_content;
+    TransferEncoding m_transfer_encoding;
+    mutable std::once_flag m_text_content_flag;
+    mutable std::string m_text_content;
     std::vector<const MimePart *> m_parts;
 }; // class MimePart
 
+// The encapsulated message of a message/rfc822 part is the single child of the part.
 class MimeMessage final : public MimePart
 {
+    friend class MimePart;
+
+public:
+    static const size_t default_depth_limit = 32;
+
 public:
-    explicit MimeMessage(std::istream & _stream);
+    explicit MimeMessage(std::istream & _stream, size_t _depth_limit = default_depth_limit);
+    explicit MimeMessage(std::string && _source, size_t _depth_limit = default_depth_limit);
     ~MimeMessage() override;
 
     const std::string & subject() const
@@ -104,6 +132,10 @@ public:
     }
 
 private:
+    MimeMessage(const std::shared_ptr<const std::string> & _source, size_t _depth_limit);
+    MimeMessage(const std::shared_ptr<const std::string> & _source, size_t _offset, size_t _length,
+        size_t _depth_limit);
+    static std::shared_ptr<const std::string> readSource(std::istream & _stream);
     void parseAddresses(const char * _header_name, std::vector<const MailboxGroup *> & _out);
 
 private:
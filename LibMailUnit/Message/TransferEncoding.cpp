@@ -0,0 +1,256 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of the MailUnit Library.                                                  *
+ *                                                                                             *
+ * MailUnit Library is free software: you can redistribute it and/or modify it under the terms *
+ * of the GNU Lesser General Public License as published by the Free Software Foundation,      *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit Library is distributed in the hope that it will be useful, but WITHOUT ANY         *
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR  *
+ * PURPOSE. See the GNU Lesser General Public License for more details.                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU License General Public License along with        *
+ * MailUnit Library. If not, see <http://www.gnu.org/licenses>.                                *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <boost/algorithm/string.hpp>
+#include <LibMailUnit/Message/TransferEncoding.h>
+
+using namespace LibMailUnit::Message;
+
+namespace {
+
+const uint8_t invalid_symbol = 0xFF;
+const uint32_t invalid_quantum = 0x80000000;
+
+// Maps symbols to the values of the base64 alphabet and hexadecimal digits.
+// Symbols out of an alphabet are mapped to the invalid_symbol value.
+// The base64_quantum tables hold the values already shifted to their places in a quantum,
+// so a quantum is assembled by OR-ing four lookups.
+// The quoted_printable_special table marks symbols that cannot be copied from the quoted-printable content as is.
+class DecodingTables
+{
+public:
+    DecodingTables()
+    {
+        std::fill(std::begin(base64), std::end(base64), invalid_symbol);
+        std::fill(std::begin(hex), std::end(hex), invalid_symbol);
+        std::fill(std::begin(quoted_printable_special), std::end(quoted_printable_special), false);
+        quoted_printable_special['='] = quoted_printable_special[' '] = quoted_printable_special['\t'] = true;
+        const char * alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for(uint8_t i = 0; i < 64; ++i)
+            base64[static_cast<unsigned char>(alphabet[i])] = i;
+        for(size_t i = 0; i < 4; ++i)
+        {
+            for(size_t symbol = 0; symbol < 256; ++symbol)
+            {
+                base64_quantum[i][symbol] = invalid_symbol == base64[symbol] ?
+                    invalid_quantum : static_cast<uint32_t>(base64[symbol]) << (18 - 6 * i);
+            }
+        }
+        for(uint8_t i = 0; i < 10; ++i)
+            hex['0' + i] = i;
+        for(uint8_t i = 0; i < 6; ++i)
+            hex['A' + i] = hex['a' + i] = 10 + i;
+    }
+
+    uint8_t base64[256];
+    uint8_t hex[256];
+    uint32_t base64_quantum[4][256];
+    bool quoted_printable_special[256];
+}; // class DecodingTables
+
+const DecodingTables tables;
+
+inline uint8_t base64Value(char _symbol)
+{
+    return tables.base64[static_cast<unsigned char>(_symbol)];
+}
+
+inline uint8_t hexValue(char _symbol)
+{
+    return tables.hex[static_cast<unsigned char>(_symbol)];
+}
+
+// Decodes whole quanta until a symbol out of the alphabet, that is usually a line break.
+// Most of the base64 content consists of such quanta, so the loop is kept as tight as possible.
+// Returns the number of consumed symbols and increases the _written by the number of decoded bytes.
+inline size_t decodeBase64Quanta(const char * _input, size_t _length, char * _output, size_t _output_size, size_t & _written)
+{
+    const char * input = _input;
+    const char * input_end = _input + _length;
+    char * output = _output;
+    char * output_end = _output + (_output_size - _written);
+    while(input_end - input >= 4 && output_end - output >= 3)
+    {
+        uint32_t quantum =
+            tables.base64_quantum[0][static_cast<unsigned char>(input[0])] |
+            tables.base64_quantum[1][static_cast<unsigned char>(input[1])] |
+            tables.base64_quantum[2][static_cast<unsigned char>(input[2])] |
+            tables.base64_quantum[3][static_cast<unsigned char>(input[3])];
+        if(quantum & invalid_quantum)
+            break;
+        output[0] = static_cast<char>(quantum >> 16);
+        output[1] = static_cast<char>(quantum >> 8);
+        output[2] = static_cast<char>(quantum);
+        input += 4;
+        output += 3;
+    }
+    _written += output - _output;
+    return input - _input;
+}
+
+inline bool isQuotedPrintableSpecial(char _symbol)
+{
+    return tables.quoted_printable_special[static_cast<unsigned char>(_symbol)];
+}
+
+inline bool isWhiteSpace(char _symbol)
+{
+    return ' ' == _symbol || '\t' == _symbol;
+}
+
+} // namespace
+
+TransferEncoding LibMailUnit::Message::parseTransferEncoding(const std::string & _raw_transfer_encoding)
+{
+    std::string encoding = boost::algorithm::trim_copy(_raw_transfer_encoding);
+    if(boost::algorithm::iequals("base64", encoding))
+        return TransferEncoding::Base64;
+    if(boost::algorithm::iequals("quoted-printable", encoding))
+        return TransferEncoding::QuotedPrintable;
+    // 7bit, 8bit, binary and unknown encodings are passed as is.
+    return TransferEncoding::Identity;
+}
+
+size_t LibMailUnit::Message::decodeIdentity(const char * _source, size_t _length, size_t & _position,
+    char * _output, size_t _output_size)
+{
+    size_t size = std::min(_length - std::min(_position, _length), _output_size);
+    std::memcpy(_output, &_source[_position], size);
+    _position += size;
+    return size;
+}
+
+size_t LibMailUnit::Message::decodeBase64(const char * _source, size_t _length, size_t & _position,
+    char * _output, size_t _output_size)
+{
+    size_t position = _position;
+    size_t written = 0;
+    while(position < _length)
+    {
+        position += decodeBase64Quanta(&_source[position], _length - position, &_output[written], _output_size, written);
+        if(position >= _length)
+            break;
+        // Line breaks between quanta are skipped without collecting a quantum.
+        if(invalid_symbol == base64Value(_source[position]) && '=' != _source[position])
+        {
+            ++position;
+            continue;
+        }
+        // A quantum interrupted by a line break, padded or truncated.
+        // Symbols out of the alphabet are ignored as RFC 2045 requires.
+        uint32_t quantum = 0;
+        size_t count = 0;
+        size_t cursor = position;
+        while(cursor < _length && count < 4)
+        {
+            char symbol = _source[cursor++];
+            if('=' == symbol)
+                break;
+            uint8_t value = base64Value(symbol);
+            if(invalid_symbol == value)
+                continue;
+            quantum = quantum << 6 | value;
+            ++count;
+        }
+        if(count < 2)
+        {
+            // There is nothing to decode before the padding or the end of the content.
+            position = cursor;
+            continue;
+        }
+        size_t size = count - 1;
+        if(written + size > _output_size)
+            break;
+        quantum <<= 6 * (4 - count);
+        for(size_t i = 0; i < size; ++i)
+            _output[written++] = static_cast<char>(quantum >> (16 - 8 * i));
+        position = cursor;
+    }
+    _position = position;
+    return written;
+}
+
+size_t LibMailUnit::Message::decodeQuotedPrintable(const char * _source, size_t _length, size_t & _position,
+    char * _output, size_t _output_size)
+{
+    size_t position = _position;
+    size_t written = 0;
+    while(position < _length && written < _output_size)
+    {
+        char symbol = _source[position];
+        if('=' == symbol)
+        {
+            if(position + 2 < _length && invalid_symbol != hexValue(_source[position + 1]) &&
+                invalid_symbol != hexValue(_source[position + 2]))
+            {
+                _output[written++] = static_cast<char>(hexValue(_source[position + 1]) << 4 | hexValue(_source[position + 2]));
+                position += 3;
+                continue;
+            }
+            // A soft line break, possibly with the transport padding.
+            size_t cursor = position + 1;
+            while(cursor < _length && isWhiteSpace(_source[cursor]))
+                ++cursor;
+            if(cursor < _length && '\r' == _source[cursor])
+                ++cursor;
+            if(cursor < _length && '\n' == _source[cursor])
+            {
+                position = cursor + 1;
+                continue;
+            }
+            if(cursor == _length)
+            {
+                position = cursor;
+                continue;
+            }
+            // A malformed sequence is passed as is.
+            _output[written++] = symbol;
+            ++position;
+        }
+        else if(isWhiteSpace(symbol))
+        {
+            // Trailing white spaces are added by transport and must be deleted.
+            size_t cursor = position + 1;
+            while(cursor < _length && isWhiteSpace(_source[cursor]))
+                ++cursor;
+            if(cursor == _length || '\r' == _source[cursor] || '\n' == _source[cursor])
+            {
+                position = cursor;
+                continue;
+            }
+            size_t size = std::min(cursor - position, _output_size - written);
+            std::memcpy(&_output[written], &_source[position], size);
+            written += size;
+            position += size;
+        }
+        else
+        {
+            size_t cursor = position + 1;
+            size_t end = std::min(_length, position + _output_size - written);
+            while(cursor < end && !isQuotedPrintableSpecial(_source[cursor]))
+                ++cursor;
+            std::memcpy(&_output[written], &_source[position], cursor - position);
+            written += cursor - position;
+            position = cursor;
+        }
+    }
+    _position = position;
+    return written;
+}
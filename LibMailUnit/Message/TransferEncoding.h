@@ -0,0 +1,45 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of the MailUnit Library.                                                  *
+ *                                                                                             *
+ * MailUnit Library is free software: you can redistribute it and/or modify it under the terms *
+ * of the GNU Lesser General Public License as published by the Free Software Foundation,      *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit Library is distributed in the hope that it will be useful, but WITHOUT ANY         *
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR  *
+ * PURPOSE. See the GNU Lesser General Public License for more details.                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU License General Public License along with        *
+ * MailUnit Library. If not, see <http://www.gnu.org/licenses>.                                *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#ifndef __LIBMU_MESSAGE_TRANSFERENCODING_H__
+#define __LIBMU_MESSAGE_TRANSFERENCODING_H__
+
+#include <string>
+
+namespace LibMailUnit {
+namespace Message {
+
+enum class TransferEncoding
+{
+    Identity,
+    Base64,
+    QuotedPrintable
+}; // enum class TransferEncoding
+
+TransferEncoding parseTransferEncoding(const std::string & _raw_transfer_encoding);
+
+// The decoders continue from the _position of the _source and move it to the first symbol not decoded yet.
+// The decoding stops when the _output has no room for the next decoded unit,
+// so the content can be decoded by chunks. The number of bytes written to the _output is returned.
+size_t decodeIdentity(const char * _source, size_t _length, size_t & _position, char * _output, size_t _output_size);
+size_t decodeBase64(const char * _source, size_t _length, size_t & _position, char * _output, size_t _output_size);
+size_t decodeQuotedPrintable(const char * _source, size_t _length, size_t & _position, char * _output, size_t _output_size);
+
+} // namespace Message
+} // namespace LibMailUnit
+
+#endif // __LIBMU_MESSAGE_TRANSFERENCODING_H__
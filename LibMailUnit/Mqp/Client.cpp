@@ -20,6 +20,11 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/shared_array.hpp>
 #include <boost/asio.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
 #include <LibMailUnit/Mqp/Client.h>
 
 using namespace LibMailUnit::Mqp;
@@ -131,6 +136,7 @@ private:
     const Command * mp_command;
     ResponseHeader * mp_response_header; // TODO: must not be a pointer (?)
     Message * mp_current_message;
+    std::string m_current_message_encoding;
     size_t m_total_message_count;
     size_t m_current_message_number;
 }; // class Client::Session
@@ -204,9 +210,12 @@ void Client::Session::connect(const asio::ip::tcp::endpoint & _endpoint)
 
 void Client::Session::writeQuery()
 {
+    static const char option_compressed[] = "COMPRESSED ";
     std::string query = boost::trim_copy(mp_command->query());
     if(!boost::ends_with(query, ";"))
         query += ';';
+    if(mp_command->options() & Command::compressed)
+        query.insert(0, option_compressed);
     std::shared_ptr<Client::Session> self = shared_from_this();
     mp_socket->async_write_some(asio::buffer(query), [self](boost::system::error_code error, size_t) {
         if(error)
@@ -306,7 +315,9 @@ void Client::Session::readMessageHeader()
     static const char hdr_to[]      = "TO: ";
     static const char hdr_cc[]      = "CC: ";
     static const char hdr_bcc[]     = "BCC: ";
+    static const char hdr_encoding[] = "ENCODING: ";
     mp_current_message = new Message { };
+    m_current_message_encoding.clear();
     mp_current_message->number = m_current_message_number;
     std::istream header_stream(&m_streambuff);
     std::string line;
@@ -321,6 +332,10 @@ void Client::Session::readMessageHeader()
         {
             mp_current_message->length = boost::lexical_cast<size_t>(line.substr(sizeof(hdr_size) - 1));
         }
+        else if(boost::starts_with(line, hdr_encoding))
+        {
+            m_current_message_encoding = line.substr(sizeof(hdr_encoding) - 1);
+        }
         else if(boost::starts_with(line, hdr_id))
         {
             mp_current_message->id = boost::lexical_cast<size_t>(line.substr(sizeof(hdr_id) - 1));
@@ -374,8 +389,45 @@ void Client::Session::readMessageHeader()
 
 void Client::Session::readMessageBody()
 {
+    static const char encoding_zlib[] = "zlib";
     std::istream body_stream(&m_streambuff);
     body_stream.read(mp_current_message->body, mp_current_message->length);
+    if(!m_current_message_encoding.empty())
+    {
+        std::string body;
+        boost::system::error_code error;
+        if(boost::iequals(encoding_zlib, m_current_message_encoding))
+        {
+            try
+            {
+                boost::iostreams::filtering_istream decoder;
+                decoder.push(boost::iostreams::zlib_decompressor());
+                decoder.push(boost::iostreams::array_source(mp_current_message->body, mp_current_message->length));
+                boost::iostreams::copy(decoder, boost::iostreams::back_inserter(body));
+            }
+            catch(const boost::iostreams::zlib_error &)
+            {
+                error = boost::system::errc::make_error_code(boost::system::errc::illegal_byte_sequence);
+            }
+        }
+        else
+        {
+            error = boost::system::errc::make_error_code(boost::system::errc::not_supported);
+        }
+        if(error)
+        {
+            // The data cannot be handed back as the message, so the session stops here.
+            delete [] mp_current_message->body;
+            delete mp_current_message;
+            mp_current_message = nullptr;
+            raiseError(error);
+            return;
+        }
+        delete [] mp_current_message->body;
+        mp_current_message->length = body.size();
+        mp_current_message->body = new char[body.size() + 1];
+        memcpy(mp_current_message->body, body.c_str(), body.size() + 1);
+    }
     mp_command->callObservers([this](CommandExecutionObserver & observer) {
         observer.onMessageReceived(*mp_command, *mp_current_message);
     });
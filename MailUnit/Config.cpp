@@ -22,6 +22,7 @@
 #include <boost/algorithm/string.hpp>
 #include <MailUnit/Config.h>
 #include <MailUnit/OS/FileSystem.h>
+#include <MailUnit/Storage/StorageExecutor.h>
 
 #define LOPT_HELP            "help"
 #define SOPT_HELP            "h"
@@ -35,6 +36,15 @@
 #define SOPT_MQP_PORT        "m"
 #define SOPT_STORAGE_DIR     "d"
 #define LOPT_STORAGE_DIR     "storage-dir"
+#define LOPT_STORAGE_HEADER  "storage-header"
+#define LOPT_STORAGE_MAXAGE  "storage-max-age"
+#define LOPT_STORAGE_MAXMSG  "storage-max-messages"
+#define LOPT_STORAGE_MAXSIZE "storage-max-size"
+#define LOPT_STORAGE_CLEANUP "storage-cleanup-interval"
+#define LOPT_STORAGE_LAYOUT  "storage-layout"
+#define LOPT_STORAGE_COMPRESS "storage-compression"
+#define LOPT_STORAGE_RECOVER "storage-recover"
+#define LOPT_STORAGE_THREADS "storage-threads"
 #define SOPT_THREAD_COUTN    "t"
 #define LOPT_THREAD_COUTN    "threads"
 #define LOPT_LOGSIZE         "log-size"
@@ -48,6 +58,9 @@
 #define LOG_LEVEL_ERROR      "error"
 #define LOG_LEVEL_FATAL      "fatal"
 
+#define STORAGE_LAYOUT_FILE    "file"
+#define STORAGE_LAYOUT_SEGMENT "segment"
+
 using namespace MailUnit;
 using namespace MailUnit::OS;
 namespace po = boost::program_options;
@@ -85,6 +98,21 @@ void validate(boost::any & _out_value, const std::vector<std::string> & _in_valu
         throw po::validation_error(po::validation_error::invalid_option_value);
 }
 
+namespace Storage {
+
+void validate(boost::any & _out_value, const std::vector<std::string> & _in_values, BlobLayout *, int)
+{
+    po::validators::check_first_occurrence(_out_value);
+    const std::string & input = po::validators::get_single_string(_in_values);
+    if(boost::iequals(input, STORAGE_LAYOUT_FILE))
+        _out_value = boost::any(BlobLayout::file);
+    else if(boost::iequals(input, STORAGE_LAYOUT_SEGMENT))
+        _out_value = boost::any(BlobLayout::segment);
+    else
+        throw po::validation_error(po::validation_error::invalid_option_value);
+}
+
+} // namespace Storage
 } // namespace MailUnit
 
 void MailUnit::loadConfig(int _argc, const char ** _argv, const boost::filesystem::path & _app_dir,
@@ -100,7 +128,8 @@ void MailUnit::loadConfig(int _argc, const char ** _argv, const boost::filesyste
     std::string smtp_pkey_path;
     const boost::uintmax_t defult_max_filesize = Logger::defult_max_filesize;
     cmd_line_only_description.add_options()
-        (LOPT_HELP "," SOPT_HELP, "Print this help.");
+        (LOPT_HELP "," SOPT_HELP, "Print this help.")
+        (LOPT_STORAGE_RECOVER, "Index data files missing in the storage database before start.");
     common_description.add_options()
         (LOPT_SMTP_PORT "," SOPT_SMTP_PORT, po::value(&config->smtp_port)->required(),
             "SMTP server port number.")
@@ -114,6 +143,25 @@ void MailUnit::loadConfig(int _argc, const char ** _argv, const boost::filesyste
             "MQP server port number.")
         (LOPT_STORAGE_DIR "," SOPT_STORAGE_DIR, po::value(&data_dir)->required(),
             "Data storage directory.")
+        (LOPT_STORAGE_HEADER, po::value(&config->storage_indexed_headers)->composing(),
+            "Name of a header to index for the HEADER('<name>') query condition. Can be specified multiple times.")
+        (LOPT_STORAGE_MAXAGE, po::value(&config->storage_max_age)->default_value(0),
+            "Maximum age of a stored message in seconds. 0 means unlimited.")
+        (LOPT_STORAGE_MAXMSG, po::value(&config->storage_max_messages)->default_value(0),
+            "Maximum number of stored messages. The oldest messages are evicted first. 0 means unlimited.")
+        (LOPT_STORAGE_MAXSIZE, po::value(&config->storage_max_bytes)->default_value(0),
+            "Maximum total size of stored messages in bytes. The oldest messages are evicted first. 0 means unlimited.")
+        (LOPT_STORAGE_CLEANUP, po::value(&config->storage_cleanup_interval)->default_value(60),
+            "Interval in seconds between evictions of messages exceeding the storage limits.")
+        (LOPT_STORAGE_LAYOUT,
+            po::value(&config->storage_layout)->default_value(Storage::BlobLayout::file, STORAGE_LAYOUT_FILE),
+            "Layout of stored messages: one file per message or messages packed into segment files. \nValid values: "
+            STORAGE_LAYOUT_FILE ", " STORAGE_LAYOUT_SEGMENT ".")
+        (LOPT_STORAGE_COMPRESS, po::value(&config->storage_compression_level)->default_value(0),
+            "Zlib compression level of stored messages (1 – 9). 0 disables the compression.")
+        (LOPT_STORAGE_THREADS,
+            po::value(&config->storage_thread_count)->default_value(Storage::StorageExecutor::default_thread_count),
+            "Number of threads storing and querying messages.")
         (LOPT_THREAD_COUTN "," SOPT_THREAD_COUTN, po::value(&config->thread_count)->default_value(MU_MIN_THREAD_COUNT),
             "Working thread count (" BOOST_PP_STRINGIZE(MU_MIN_THREAD_COUNT) " – "  BOOST_PP_STRINGIZE(MU_MAX_THREAD_COUNT) ")" )
         (LOPT_LOGSIZE, po::value(&config->log_max_size)->default_value(defult_max_filesize),
@@ -159,6 +207,11 @@ void MailUnit::loadConfig(int _argc, const char ** _argv, const boost::filesyste
     {
         throw ConfigLoadingException("The certificate and private key are required to use SSL/TLS", full_description);
     }
+    if(config->storage_compression_level > 9)
+    {
+        throw ConfigLoadingException("The compression level must be in range 0 – 9", full_description);
+    }
+    config->storage_recover = var_map.count(LOPT_STORAGE_RECOVER) > 0;
     config->use_stdlog = var_map.count(LOPT_STDLOG) > 0;
     if(!log_file.empty())
         config->log_filepath = toAbsolutePath(utf8ToPathString(log_file), _app_dir);
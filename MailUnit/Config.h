@@ -19,11 +19,14 @@
 #define __MU_CONFIG_H__
 
 #include <memory>
+#include <vector>
+#include <string>
 #include <functional>
 #include <boost/filesystem/path.hpp>
 #include <boost/program_options/options_description.hpp>
 #include <MailUnit/Exception.h>
 #include <MailUnit/Logger.h>
+#include <MailUnit/Storage/BlobStore.h>
 
 #define MU_MIN_THREAD_COUNT 1
 #define MU_MAX_THREAD_COUNT 255
@@ -40,6 +43,15 @@ struct Config
     std::string smtp_privet_key_pass;
     uint16_t mqp_port;
     boost::filesystem::path data_dirpath;
+    std::vector<std::string> storage_indexed_headers;
+    uint32_t storage_max_age;
+    uint64_t storage_max_messages;
+    uint64_t storage_max_bytes;
+    uint32_t storage_cleanup_interval;
+    Storage::BlobLayout storage_layout;
+    uint16_t storage_compression_level;
+    bool storage_recover;
+    uint16_t storage_thread_count;
     bool use_stdlog;
     LogLevel log_level;
     boost::uintmax_t log_max_size;
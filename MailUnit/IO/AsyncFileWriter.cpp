@@ -15,25 +15,41 @@
  *                                                                                             *
  ***********************************************************************************************/
 
+#include <array>
 #include <MailUnit/IO/AsyncFileWriter.h>
 
 using namespace MailUnit::IO;
 
-void MailUnit::IO::writeFileAsync(AsyncWriter & _writer, std::shared_ptr<std::ifstream> _stream, AsioCallback _callback)
+namespace {
+
+const size_t chank_size = 1024;
+
+typedef std::shared_ptr<std::array<char, chank_size>> ChankPtr;
+
+// The chank must outlive the asynchronous write, so it is owned by the callback chain.
+void writeChankAsync(AsyncWriter & _writer, std::shared_ptr<std::istream> _stream, uint64_t _length,
+    ChankPtr _chank, AsioCallback _callback)
 {
-    static const size_t chank_size = 1024;
-    char chank[chank_size];
-    size_t symbol_count = _stream->read(chank, chank_size).gcount();
+    size_t symbol_count = _length == 0 ? 0 :
+        _stream->read(_chank->data(), static_cast<std::streamsize>(std::min<uint64_t>(chank_size, _length))).gcount();
     if(symbol_count == 0)
     {
         _callback(boost::system::error_code());
         return;
     }
-    _writer.writeAsync(boost::asio::buffer(const_cast<const char *>(chank), symbol_count),
-        [&_writer, _stream, _callback](const boost::system::error_code & error_code, std::size_t) {
+    _writer.writeAsync(boost::asio::buffer(const_cast<const char *>(_chank->data()), symbol_count),
+        [&_writer, _stream, _length, symbol_count, _chank, _callback](const boost::system::error_code & error_code, std::size_t) {
             if(error_code && !callAsioCallback(_callback, error_code))
                 return;
-            writeFileAsync(_writer, _stream, _callback);
+            writeChankAsync(_writer, _stream, _length - symbol_count, _chank, _callback);
         }
     );
 }
+
+} // namespace
+
+void MailUnit::IO::writeFileAsync(AsyncWriter & _writer, std::shared_ptr<std::istream> _stream, uint64_t _length,
+    AsioCallback _callback)
+{
+    writeChankAsync(_writer, _stream, _length, std::make_shared<std::array<char, chank_size>>(), _callback);
+}
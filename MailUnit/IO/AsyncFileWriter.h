@@ -19,29 +19,35 @@
 #define __MU_IO_ASYNCFILEWRITER_H__
 
 #include <memory>
-#include <fstream>
+#include <istream>
+#include <limits>
+#include <cstdint>
 #include <MailUnit/IO/AsyncOperation.h>
 
 namespace MailUnit {
 namespace IO {
 
-void writeFileAsync(AsyncWriter & _writer, std::shared_ptr<std::ifstream> _stream, AsioCallback _callback);
+void writeFileAsync(AsyncWriter & _writer, std::shared_ptr<std::istream> _stream, uint64_t _length,
+    AsioCallback _callback);
 
 class AsyncFileWriter : public AsyncOperation
 {
 public:
-    explicit AsyncFileWriter(std::shared_ptr<std::ifstream> _stream) :
-        m_stream(_stream)
+    explicit AsyncFileWriter(std::shared_ptr<std::istream> _stream,
+        uint64_t _length = std::numeric_limits<uint64_t>::max()) :
+        m_stream(_stream),
+        m_length(_length)
     {
     }
 
     void run(AsyncWriter & _writer, AsioCallback _callback) override
     {
-        writeFileAsync(_writer, m_stream, _callback);
+        writeFileAsync(_writer, m_stream, m_length, _callback);
     }
 
 private:
-    std::shared_ptr<std::ifstream> m_stream;
+    std::shared_ptr<std::istream> m_stream;
+    uint64_t m_length;
 }; // class AsyncFileWriter
 
 } // namespace IO
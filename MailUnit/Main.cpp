@@ -34,6 +34,8 @@
 #include <MailUnit/Server/Tcp/TcpServer.h>
 #include <MailUnit/Smtp/ServerRequestHandler.h>
 #include <MailUnit/Mqp/ServerRequestHandler.h>
+#include <MailUnit/Storage/RetentionTask.h>
+#include <MailUnit/Storage/StorageExecutor.h>
 
 using namespace MailUnit;
 using namespace MailUnit::Storage;
@@ -74,15 +76,40 @@ void start(const std::shared_ptr<Config> _config)
 
     asio::io_service service;
 
-    std::shared_ptr<Repository> repo = std::make_shared<Repository>(_config->data_dirpath);
+    Repository::Options repository_options;
+    repository_options.indexed_headers = _config->storage_indexed_headers;
+    repository_options.max_age = _config->storage_max_age;
+    repository_options.max_messages = _config->storage_max_messages;
+    repository_options.max_bytes = _config->storage_max_bytes;
+    repository_options.blob_layout = _config->storage_layout;
+    repository_options.compression_level = _config->storage_compression_level;
+    repository_options.recover = _config->storage_recover;
+    std::shared_ptr<Repository> repo = std::make_shared<Repository>(_config->data_dirpath, repository_options);
+    std::shared_ptr<StorageExecutor> storage_executor = std::make_shared<StorageExecutor>(_config->storage_thread_count);
+    if((repository_options.hasRetentionPolicy() || repository_options.blob_layout == BlobLayout::segment) &&
+        _config->storage_cleanup_interval > 0)
+    {
+        startRetentionTask(service, storage_executor, repo, boost::posix_time::seconds(_config->storage_cleanup_interval));
+    }
     // TODO: interface from config
     asio::ip::tcp::endpoint smtp_server_endpoint(asio::ip::tcp::v4(), _config->smtp_port);
-    startTcpServer(service, smtp_server_endpoint, std::make_shared<Smtp::ServerRequestHandler>(repo, *_config));
+    startTcpServer(service, smtp_server_endpoint, std::make_shared<Smtp::ServerRequestHandler>(repo, storage_executor, *_config));
 
     // TODO: interface from config
     //asio::ip::tcp::endpoint storage_server_endpoint(asio::ip::address_v4::from_string("0.0.0.0"), _config->mqp_port);
     asio::ip::tcp::endpoint storage_server_endpoint(asio::ip::tcp::v4(), _config->mqp_port);
-    startTcpServer(service, storage_server_endpoint, std::make_shared<Mqp::ServerRequestHandler>(repo));
+    startTcpServer(service, storage_server_endpoint, std::make_shared<Mqp::ServerRequestHandler>(repo, storage_executor));
+
+    storage_executor->post([repo]() {
+        try
+        {
+            repo->verifyStorage();
+        }
+        catch(const std::exception & error)
+        {
+            LOG_ERROR << "Unable to verify the storage: " << error.what();
+        }
+    });
 
     uint16_t thread_count = _config->thread_count;
     if(thread_count < MU_MIN_THREAD_COUNT) thread_count = MU_MIN_THREAD_COUNT;
@@ -105,6 +132,8 @@ void start(const std::shared_ptr<Config> _config)
         threads[i].join();
     }
     delete [] threads;
+    // Storage tasks post their results to the service, so they are completed before it is destroyed.
+    storage_executor->stop();
 }
 
 } // namespace
@@ -18,7 +18,6 @@
 #include <memory>
 #include <sstream>
 #include <functional>
-#include <atomic>
 #include <boost/noncopyable.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <MailUnit/Logger.h>
@@ -33,6 +32,7 @@
 #define MQP_ENDHDR  "\r\n\r\n"
 #define MQP_ITEM    "ITEM: "
 #define MQP_SIZE    "SIZE: "
+#define MQP_ENCODING "ENCODING: "
 #define MQP_ID      "ID: "
 #define MQP_SUBJECT "SUBJECT: "
 #define MQP_FROM    "FROM: "
@@ -43,6 +43,9 @@
 #define MQP_DELETED "DELETED: "
 #define MQP_MATCHED "MATCHED: "
 
+#define MQP_OPTION_COMPRESSED "COMPRESSED "
+#define MQP_ENCODING_ZLIB     "zlib"
+
 using namespace MailUnit::Mqp;
 using namespace MailUnit::Storage;
 using namespace MailUnit::Server;
@@ -57,7 +60,8 @@ class MqpSession final :
     typedef AsyncSequenceOperation<std::vector<std::unique_ptr<Email>>>::SequenceHolder EmailsHolder;
 
 public:
-    inline explicit MqpSession(TcpSocket _socket, std::shared_ptr<Repository> _repository);
+    inline MqpSession(TcpSocket _socket, std::shared_ptr<Repository> _repository,
+        std::shared_ptr<StorageExecutor> _executor);
     ~MqpSession();
     void start() override;
 
@@ -65,6 +69,7 @@ private:
     size_t findEndOfQuery(const char * _query_piece, size_t _length);
     void read();
     void processQuery();
+    void completeQuery(std::shared_ptr<QueryResult> _result, std::exception_ptr _error);
     bool isQueryEndOfSessionRequest(const std::string & _query);
     void writeEmails(EmailsHolder _emails);
     void writeEmailBodies(EmailsHolder _emails);
@@ -75,11 +80,13 @@ private:
 
 private:
     std::shared_ptr<Repository> m_repository_ptr;
+    std::shared_ptr<StorageExecutor> m_executor_ptr;
     static const size_t s_deadline_timeout = 30000;
-    std::atomic<boost::asio::deadline_timer *> m_deadline_timer;
+    boost::asio::deadline_timer m_deadline_timer;
     static const size_t s_buffer_size = 256;
     char * mp_buffer;
     bool m_position_in_quoted_text;
+    bool m_compressed_response;
     std::string m_query;
 }; // class MqpSession
 
@@ -87,7 +94,7 @@ private:
 
 std::shared_ptr<Session> ServerRequestHandler::createSession(TcpSocket _socket)
 {
-    return std::make_shared<MqpSession>(std::move(_socket), m_repository_ptr);
+    return std::make_shared<MqpSession>(std::move(_socket), m_repository_ptr, m_executor_ptr);
 }
 
 bool ServerRequestHandler::handleError(const boost::system::error_code & _err_code)
@@ -96,12 +103,15 @@ bool ServerRequestHandler::handleError(const boost::system::error_code & _err_co
     return false;
 }
 
-MqpSession::MqpSession(TcpSocket _socket, std::shared_ptr<Repository> _repository) :
+MqpSession::MqpSession(TcpSocket _socket, std::shared_ptr<Repository> _repository,
+    std::shared_ptr<StorageExecutor> _executor) :
     TcpSession(std::move(_socket)),
     m_repository_ptr(_repository),
-    m_deadline_timer(nullptr),
+    m_executor_ptr(_executor),
+    m_deadline_timer(tcpSocket().get_io_service()),
     mp_buffer(new char[s_buffer_size]),
-    m_position_in_quoted_text(false)
+    m_position_in_quoted_text(false),
+    m_compressed_response(false)
 {
     LOG_DEBUG << "New MQP session has started";
 }
@@ -115,7 +125,10 @@ MqpSession::~MqpSession()
 
 void MqpSession::start()
 {
-    read();
+    std::shared_ptr<MqpSession> self(shared_from_this());
+    post([self]() {
+        self->read();
+    });
 }
 
 void MqpSession::read()
@@ -150,9 +163,41 @@ void MqpSession::processQuery()
     {
         return;
     }
+    m_compressed_response = boost::algorithm::istarts_with(query, MQP_OPTION_COMPRESSED);
+    if(m_compressed_response)
+    {
+        query.erase(0, sizeof(MQP_OPTION_COMPRESSED) - 1);
+    }
+    std::shared_ptr<MqpSession> self(shared_from_this());
+    bool accepted = m_executor_ptr->post([self, query]() {
+        std::shared_ptr<QueryResult> result;
+        std::exception_ptr error;
+        try
+        {
+            result = self->m_repository_ptr->executeQuery(query);
+        }
+        catch(...)
+        {
+            error = std::current_exception();
+        }
+        self->post([self, result, error]() {
+            self->completeQuery(result, error);
+        });
+    });
+    if(!accepted)
+    {
+        StorageException error("Storage queue is full");
+        writeError(StatusCode::StorageError, &error);
+    }
+}
+
+void MqpSession::completeQuery(std::shared_ptr<QueryResult> _result, std::exception_ptr _error)
+{
     try
     {
-        std::shared_ptr<QueryResult> query_result = m_repository_ptr->executeQuery(query);
+        if(_error)
+            std::rethrow_exception(_error);
+        std::shared_ptr<QueryResult> query_result = _result;
         QueryGetResult * get = boost::get<QueryGetResult>(query_result.get());
         if(get)
         {
@@ -228,16 +273,27 @@ void MqpSession::writeEmailBodies(EmailsHolder _emails)
     std::shared_ptr<EmailSequenceOperation> emails_operation = EmailSequenceOperation::create(_emails,
         [self, total_count](EmailOperation & email_operation) {
             const std::unique_ptr<Email> & email = email_operation.item();
-            std::shared_ptr<std::ifstream> file(new std::ifstream(email->dataFilePath().string(), std::ios_base::binary));
-            if(!file->is_open())
+            bool pass_encoded = self->m_compressed_response && BlobEncoding::identity != email->dataEncoding();
+            uint64_t length = email->size();
+            std::shared_ptr<std::istream> file;
+            try
+            {
+                file = pass_encoded ? email->openEncodedData(length) : email->openData();
+            }
+            catch(const std::exception & error)
             {
-                // TODO: error
+                LOG_ERROR << "Unable to read the message " << email->id() << ": " << error.what();
+                file = std::make_shared<std::istringstream>();
+                length = 0;
             }
             email_operation.addStep(std::make_unique<AsyncLambdaWriter>(
-                [&email_operation, &email, total_count](std::ostream & stream) {
+                [&email_operation, &email, total_count, pass_encoded, length](std::ostream & stream) {
                     stream <<
                         MQP_ITEM << email_operation.itemIndex() + 1 << '/' << total_count << MQP_ENDLINE <<
-                        MQP_SIZE << boost::filesystem::file_size(email->dataFilePath()) << MQP_ENDLINE <<
+                        MQP_SIZE << length << MQP_ENDLINE;
+                    if(pass_encoded)
+                        stream << MQP_ENCODING << MQP_ENCODING_ZLIB << MQP_ENDLINE;
+                    stream <<
                         MQP_ID << email->id() << MQP_ENDLINE <<
                         MQP_SUBJECT << email->subject() << MQP_ENDLINE;
                     for(const std::string & address : email->addresses(Email::AddressType::from))
@@ -251,7 +307,7 @@ void MqpSession::writeEmailBodies(EmailsHolder _emails)
                     stream << MQP_ENDLINE;
                 }
             ));
-            email_operation.addStep(std::make_unique<AsyncFileWriter>(file));
+            email_operation.addStep(std::make_unique<AsyncFileWriter>(file, length));
         }
     );
     emails_operation->run(*this, [self](const boost::system::error_code &) {
@@ -310,34 +366,23 @@ size_t MqpSession::findEndOfQuery(const char * _query_piece, size_t _length)
 
 void MqpSession::startDeadlineTimer()
 {
-    stopDeadlineTimer();
-    boost::asio::deadline_timer * timer = new boost::asio::deadline_timer(tcpSocket().get_io_service(),
-        boost::posix_time::milliseconds(s_deadline_timeout));
     std::shared_ptr<MqpSession> self(shared_from_this());
-    m_deadline_timer.exchange(timer);
-    timer->async_wait([self, timer](const boost::system::error_code & error) {
-        if(error)
-        {
+    m_deadline_timer.expires_from_now(boost::posix_time::milliseconds(s_deadline_timeout));
+    m_deadline_timer.async_wait(wrap([self](const boost::system::error_code & error) {
+        // The timer could be restarted after this handler had been queued.
+        if(error || self->m_deadline_timer.expires_at() > boost::asio::deadline_timer::traits_type::now())
             return;
-            // TODO: error
-            // TODO: handle boost::asio::error::operation_aborted
-        }
-        delete self->m_deadline_timer.exchange(nullptr);
         std::stringstream message;
         message << MQP_STATUS << StatusCode::Timeout << MQP_ENDHDR;
         self->write(message.str(), [self] {
             self->tcpSocket().close();
         });
         LOG_DEBUG << "MQP timeout has occurred";
-    });
+    }));
 }
 
 void MqpSession::stopDeadlineTimer()
 {
-    boost::asio::deadline_timer * timer = m_deadline_timer.exchange(nullptr);
-    if(nullptr != timer)
-    {
-        timer->cancel();
-        delete timer;
-    }
+    boost::system::error_code error;
+    m_deadline_timer.cancel(error);
 }
@@ -22,6 +22,7 @@
 #include <boost/asio.hpp>
 #include <MailUnit/Server/RequestHandler.h>
 #include <MailUnit/Storage/Repository.h>
+#include <MailUnit/Storage/StorageExecutor.h>
 
 namespace MailUnit {
 namespace Mqp {
@@ -29,8 +30,10 @@ namespace Mqp {
 class ServerRequestHandler : public Server::RequestHandler<boost::asio::ip::tcp::socket>
 {
 public:
-    explicit ServerRequestHandler(std::shared_ptr<Storage::Repository> _repository) :
-        m_repository_ptr(_repository)
+    ServerRequestHandler(std::shared_ptr<Storage::Repository> _repository,
+        std::shared_ptr<Storage::StorageExecutor> _executor) :
+        m_repository_ptr(_repository),
+        m_executor_ptr(_executor)
     {
     }
 
@@ -39,6 +42,7 @@ public:
 
 private:
     std::shared_ptr<Storage::Repository> m_repository_ptr;
+    std::shared_ptr<Storage::StorageExecutor> m_executor_ptr;
 }; // class ServerRequestHandler
 
 } // namespace Storage
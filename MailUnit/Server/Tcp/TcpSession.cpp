@@ -23,12 +23,14 @@ namespace asio = boost::asio;
 
 TcpSession::TcpSession(boost::asio::io_service & _io_service) :
     m_tcp_socket(_io_service),
+    m_strand(_io_service),
     mp_tls_socket(nullptr)
 {
 }
 
 TcpSession::TcpSession(TcpSocket _socket) :
     m_tcp_socket(std::move(_socket)),
+    m_strand(m_tcp_socket.get_io_service()),
     mp_tls_socket(nullptr)
 {
 }
@@ -41,17 +43,17 @@ TcpSession::~TcpSession()
 void TcpSession::writeAsync(const InBuffer & _buffer, WriteCallback _callback)
 {
     if(mp_tls_socket)
-        mp_tls_socket->async_write_some(_buffer, _callback);
+        mp_tls_socket->async_write_some(_buffer, m_strand.wrap(_callback));
     else
-        m_tcp_socket.async_send(_buffer, _callback);
+        m_tcp_socket.async_send(_buffer, m_strand.wrap(_callback));
 }
 
 void TcpSession::readAsync(const OutBuffer & _buffer, ReadCallback _callback)
 {
     if(mp_tls_socket)
-        mp_tls_socket->async_read_some(_buffer, _callback);
+        mp_tls_socket->async_read_some(_buffer, m_strand.wrap(_callback));
     else
-        m_tcp_socket.async_receive(_buffer, _callback);
+        m_tcp_socket.async_receive(_buffer, m_strand.wrap(_callback));
 }
 
 void TcpSession::switchToTlsAsync(TlsContext & _context, HandshakeCallback _callback)
@@ -62,5 +64,10 @@ void TcpSession::switchToTlsAsync(TlsContext & _context, HandshakeCallback _call
         return;
     }
     mp_tls_socket = new TlsSocket(m_tcp_socket, _context);
-    mp_tls_socket->async_handshake(boost::asio::ssl::stream_base::server, _callback);
+    mp_tls_socket->async_handshake(boost::asio::ssl::stream_base::server, m_strand.wrap(_callback));
+}
+
+void TcpSession::post(Handler _handler)
+{
+    m_strand.post(_handler);
 }
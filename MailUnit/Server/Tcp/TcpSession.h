@@ -36,6 +36,7 @@ private:
 public:
     typedef std::function<void(const boost::system::error_code &, size_t)> ReadCallback;
     typedef std::function<void(const boost::system::error_code &)> HandshakeCallback;
+    typedef std::function<void()> Handler;
 
     typedef boost::asio::mutable_buffers_1 OutBuffer;
 
@@ -46,6 +47,7 @@ public:
     void writeAsync(const InBuffer & _buffer, WriteCallback _callback) override;
     void readAsync(const OutBuffer & _buffer, ReadCallback _callback);
     void switchToTlsAsync(TlsContext & _context, HandshakeCallback _callback);
+    void post(Handler _handler);
 
 protected:
     TcpSocket & tcpSocket()
@@ -53,8 +55,16 @@ protected:
         return m_tcp_socket;
     }
 
+    template<typename HandlerT>
+    auto wrap(HandlerT _handler)
+    {
+        return m_strand.wrap(_handler);
+    }
+
 private:
     TcpSocket m_tcp_socket;
+    // All handlers of the session are serialized, so the session state needs no synchronization.
+    boost::asio::io_service::strand m_strand;
     TlsSocket * mp_tls_socket;
 }; // class TcpSession
 
@@ -0,0 +1,156 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#ifndef __MU_SLAB_ALLOCATOR_H__
+#define __MU_SLAB_ALLOCATOR_H__
+
+#include <cstddef>
+#include <new>
+
+namespace MailUnit {
+
+// Pool of equally sized blocks. Released blocks are kept in a free list of the calling thread
+// and are handed out again instead of going back to the heap.
+template<std::size_t BlockSize>
+class SlabPool
+{
+public:
+    static const std::size_t block_size = BlockSize < sizeof(void *) ? sizeof(void *) : BlockSize;
+    static const std::size_t max_free_blocks = 256;
+
+public:
+    static void * acquire()
+    {
+        FreeList & list = freeList();
+        if(nullptr == list.head)
+            return ::operator new(block_size);
+        Block * block = list.head;
+        list.head = block->next;
+        --list.size;
+        return block;
+    }
+
+    static void release(void * _block) noexcept
+    {
+        FreeList & list = freeList();
+        if(list.size >= max_free_blocks)
+        {
+            ::operator delete(_block);
+            return;
+        }
+        Block * block = static_cast<Block *>(_block);
+        block->next = list.head;
+        list.head = block;
+        ++list.size;
+    }
+
+    static std::size_t freeBlockCount()
+    {
+        return freeList().size;
+    }
+
+private:
+    struct Block
+    {
+        Block * next;
+    }; // struct Block
+
+    struct FreeList
+    {
+        FreeList() :
+            head(nullptr),
+            size(0)
+        {
+        }
+
+        ~FreeList()
+        {
+            while(nullptr != head)
+            {
+                Block * next = head->next;
+                ::operator delete(head);
+                head = next;
+            }
+        }
+
+        Block * head;
+        std::size_t size;
+    }; // struct FreeList
+
+private:
+    static FreeList & freeList()
+    {
+        static thread_local FreeList list;
+        return list;
+    }
+}; // class SlabPool
+
+// Allocator for single objects, e.g. for std::allocate_shared. Arrays are taken from the heap.
+template<typename Type>
+class SlabAllocator
+{
+public:
+    typedef Type value_type;
+
+    template<typename OtherType>
+    struct rebind
+    {
+        typedef SlabAllocator<OtherType> other;
+    }; // struct rebind
+
+public:
+    SlabAllocator() noexcept
+    {
+    }
+
+    template<typename OtherType>
+    SlabAllocator(const SlabAllocator<OtherType> &) noexcept
+    {
+    }
+
+    Type * allocate(std::size_t _count)
+    {
+        static_assert(alignof(Type) <= alignof(std::max_align_t), "Over-aligned types are not supported");
+        if(1 == _count)
+            return static_cast<Type *>(SlabPool<sizeof(Type)>::acquire());
+        return static_cast<Type *>(::operator new(_count * sizeof(Type)));
+    }
+
+    void deallocate(Type * _pointer, std::size_t _count) noexcept
+    {
+        if(1 == _count)
+            SlabPool<sizeof(Type)>::release(_pointer);
+        else
+            ::operator delete(_pointer);
+    }
+}; // class SlabAllocator
+
+template<typename Type, typename OtherType>
+inline bool operator == (const SlabAllocator<Type> &, const SlabAllocator<OtherType> &) noexcept
+{
+    return true;
+}
+
+template<typename Type, typename OtherType>
+inline bool operator != (const SlabAllocator<Type> &, const SlabAllocator<OtherType> &) noexcept
+{
+    return false;
+}
+
+} // namespace MailUnit
+
+#endif // __MU_SLAB_ALLOCATOR_H__
@@ -20,6 +20,8 @@
 #define BOOST_MPL_LIMIT_VECTOR_SIZE 30 // Max count of the state machine's rows
 #define FUSION_MAX_VECTOR_SIZE 20 // Max count of the state machine's states
 
+#include <map>
+#include <mutex>
 #include <boost/optional.hpp>
 #include <boost/mpl/vector.hpp>
 #include <boost/msm/front/state_machine_def.hpp>
@@ -28,12 +30,17 @@
 #include <boost/scope_exit.hpp>
 #include <MailUnit/Exception.h>
 #include <MailUnit/Logger.h>
+#include <MailUnit/SlabAllocator.h>
 #include <MailUnit/Smtp/Protocol.h>
 
 #define VERB_EHLO     "EHLO"
+#define VERB_HELO     "HELO"
 #define VERB_MAIL     "MAIL"
 #define VERB_RCPT     "RCPT"
 #define VERB_DATA     "DATA"
+#define VERB_RSET     "RSET"
+#define VERB_NOOP     "NOOP"
+#define VERB_VRFY     "VRFY"
 #define VERB_QUIT     "QUIT"
 #define VERB_STARTTLS "STARTTLS"
 #define END_OF_DATA   "\r\n.\r\n"
@@ -42,6 +49,7 @@ using namespace MailUnit;
 using namespace MailUnit::Storage;
 using namespace MailUnit::Smtp;
 using boost::msm::front::Row;
+using boost::msm::front::Internal;
 using boost::msm::front::none;
 
 namespace {
@@ -119,7 +127,11 @@ enum class EventId
     rcptTo     = 4,
     dataHeader = 5,
     data       = 6,
-    quit       = 7
+    quit       = 7,
+    helo       = 8,
+    reset      = 9,
+    noop       = 10,
+    verify     = 11
 }; // enum class EventId
 
 template<EventId id>
@@ -140,6 +152,10 @@ using RcptToEvent     = Event<EventId::rcptTo>;
 using DataHeaderEvent = Event<EventId::dataHeader>;
 using RawDataEvent    = Event<EventId::data>;
 using QuitEvent       = Event<EventId::quit>;
+using HeloEvent       = Event<EventId::helo>;
+using ResetEvent      = Event<EventId::reset>;
+using NoopEvent       = Event<EventId::noop>;
+using VerifyEvent     = Event<EventId::verify>;
 
 enum class StateId
 {
@@ -245,6 +261,12 @@ public:
         return *m_current_email_ptr;
     }
 
+    void resetEmail()
+    {
+        if(!m_current_email_ptr->fromAddresses().empty() || !m_current_email_ptr->toAddresses().empty())
+            m_current_email_ptr = mr_repositry.createRawEmail();
+    }
+
     void writeResponse(const Response & _response)
     {
         mr_transport.addNextAction([this, _response]() {
@@ -268,8 +290,18 @@ public:
 
     void storeEmail()
     {
-        mr_repositry.storeEmail(*m_current_email_ptr);
+        std::shared_ptr<RawEmail> raw_email(std::move(m_current_email_ptr));
         m_current_email_ptr = mr_repositry.createRawEmail();
+        mr_transport.addNextAction([this, raw_email]() {
+            Repository & repository = mr_repositry;
+            mr_transport.requestForStore(
+                [&repository, raw_email]() {
+                    repository.storeEmail(*raw_email);
+                },
+                [this](bool _stored) {
+                    mr_transport.requestForWrite(_stored ? ResponseCode::ok : ResponseCode::internalError);
+                });
+        });
     }
 
     void quit()
@@ -351,14 +383,75 @@ public:
     template<typename SourceStateT, typename TargetStateT>
     void operator ()(const EventBase &, ProtocolController & _protocol, SourceStateT &, TargetStateT &)
     {
-        Response response(ResponseCode::ok);
-        for(const ProtocolExtenstion * ext : _protocol.extensions())
-            response.addExtenstion(*ext);
-        _protocol.writeResponse(response);
+        _protocol.writeResponse(response(_protocol.extensions()));
         _protocol.listen();
     }
+
+private:
+    static Response response(const std::vector<const ProtocolExtenstion *> & _extensions);
 }; // class EhloAction
 
+Response EhloAction::response(const std::vector<const ProtocolExtenstion *> & _extensions)
+{
+    // The reply is built once per set of extensions.
+    static std::mutex mutex;
+    static std::map<unsigned int, Response> responses;
+    unsigned int key = 0;
+    for(const ProtocolExtenstion * ext : _extensions)
+        key |= 1u << static_cast<unsigned int>(ext->id());
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = responses.find(key);
+    if(responses.end() == it)
+        it = responses.emplace(key, Response(ResponseCode::ok, _extensions)).first;
+    return it->second;
+}
+
+class HeloAction
+{
+public:
+    template<typename SourceStateT, typename TargetStateT>
+    void operator ()(const EventBase &, ProtocolController & _protocol, SourceStateT &, TargetStateT &)
+    {
+        _protocol.writeResponse(ResponseCode::ok);
+        _protocol.listen();
+    }
+}; // class HeloAction
+
+class ResetAction
+{
+public:
+    template<typename SourceStateT, typename TargetStateT>
+    void operator ()(const EventBase &, ProtocolController & _protocol, SourceStateT &, TargetStateT &)
+    {
+        _protocol.resetEmail();
+        _protocol.writeResponse(ResponseCode::ok);
+        _protocol.listen();
+    }
+}; // class ResetAction
+
+class NoopAction
+{
+public:
+    template<typename SourceStateT, typename TargetStateT>
+    void operator ()(const EventBase &, ProtocolController & _protocol, SourceStateT &, TargetStateT &)
+    {
+        _protocol.writeResponse(ResponseCode::ok);
+        _protocol.listen();
+    }
+}; // class NoopAction
+
+class VerifyAction
+{
+public:
+    template<typename SourceStateT, typename TargetStateT>
+    void operator ()(const EventBase &, ProtocolController & _protocol, SourceStateT &, TargetStateT &)
+    {
+        // Mailboxes are not verified, any address is accepted on delivery.
+        _protocol.writeResponse(ResponseCode::userNotVerified);
+        _protocol.listen();
+    }
+}; // class VerifyAction
+
 class StartTlsAction
 {
 public:
@@ -478,7 +571,6 @@ void DataAction::operator ()(const EventBase & _event, ProtocolController & _pro
         _target_state.resetTail();
         _protocol.setInputMode(InputMode::verb);
         _protocol.storeEmail();
-        _protocol.writeResponse(ResponseCode::ok);
         _protocol.listen();
     }
     else
@@ -498,8 +590,8 @@ bool DataAction::tryWriteTail(const EventBase & _event, DataState & _state)
     const char * data = _event.data();
     std::size_t data_length = _event.dataLenght();
     std::size_t right_length = std::min(s_end_of_data_mark_length, data_length);
-    std::size_t tail_length = left_length + right_length;
-    char * tail = new char[tail_length];
+    // The tail and the beginning of the data are both shorter than the end of data mark.
+    char tail[2 * sizeof(END_OF_DATA)] = { };
     strncpy(tail, _state.tail(), left_length);
     strncpy(&tail[left_length], data, right_length);
     bool result = false;
@@ -513,7 +605,6 @@ bool DataAction::tryWriteTail(const EventBase & _event, DataState & _state)
             _event.email().data().write(begin_data, data_length);
         result = true;
     }
-    delete [] tail;
     return result;
 }
 
@@ -571,20 +662,26 @@ public:
         Row< StartState       , ReadyEvent       , ReadyState       , ReadyAction        , none           >,
         // +------------------+----------------- +---------------- -+-------------------+-----------------+
         Row< ReadyState       , EhloEvent        , EhloState        , EhloAction        , none            >,
+        Row< ReadyState       , HeloEvent        , EhloState        , HeloAction        , none            >,
+        Row< ReadyState       , ResetEvent       , ReadyState       , ResetAction       , none            >,
         Row< ReadyState       , QuitEvent        , QuitState        , QuitAction        , none            >,
         // +------------------+----------------- +---------------- -+-------------------+-----------------+
         Row< EhloState        , MailFromEvent    , MailFromState    , MailFromAction    , none            >,
         Row< EhloState        , StartTlsEvent    , StartTlsState    , StartTlsAction    , StartTlsGuard   >,
+        Row< EhloState        , ResetEvent       , EhloState        , ResetAction       , none            >,
         Row< EhloState        , QuitEvent        , QuitState        , QuitAction        , none            >,
         // +------------------+----------------- +---------------- -+-------------------+-----------------+
-        Row< StartTlsState    , EhloEvent        , EhloState        , EhloAction        , none           >,
+        Row< StartTlsState    , EhloEvent        , EhloState        , EhloAction        , none            >,
+        Row< StartTlsState    , HeloEvent        , EhloState        , HeloAction        , none            >,
         // +------------------+----------------- +---------------- -+-------------------+-----------------+
         Row< MailFromState    , MailFromEvent    , MailFromState    , MailFromAction    , MailFromGuard   >,
         Row< MailFromState    , RcptToEvent      , RcptToState      , RcptToAction      , none            >,
+        Row< MailFromState    , ResetEvent       , EhloState        , ResetAction       , none            >,
         Row< MailFromState    , QuitEvent        , QuitState        , QuitAction        , none            >,
         // +------------------+----------------- +---------------- -+-------------------+-----------------+
         Row< RcptToState      , RcptToEvent      , RcptToState      , RcptToAction      , none            >,
         Row< RcptToState      , DataHeaderEvent  , DataHeaderState  , DataHeaderAction  , none            >,
+        Row< RcptToState      , ResetEvent       , EhloState        , ResetAction       , none            >,
         Row< RcptToState      , QuitEvent        , QuitState        , QuitAction        , none            >,
         // +------------------+----------------- +---------------- -+-------------------+-----------------+
         Row< DataHeaderState  , RawDataEvent     , DataState        , DataAction        , none            >,
@@ -592,10 +689,17 @@ public:
         Row< DataState        , RawDataEvent     , DataState        , DataAction        , DataGuard       >,
         // +------------------+----------------- +---------------- -+-------------------+-----------------+
         Row< DataState        , MailFromEvent    , MailFromState    , MailFromAction    , none            >,
+        Row< DataState        , ResetEvent       , EhloState        , ResetAction       , none            >,
         Row< DataState        , QuitEvent        , QuitState        , QuitAction        , none            >
         // +------------------+----------------- +---------------- -+-------------------+-----------------+
     > { };
 
+    // The commands are allowed in any state and do not change it.
+    struct internal_transition_table : boost::mpl::vector<
+        Internal< NoopEvent       , NoopAction       , none            >,
+        Internal< VerifyEvent     , VerifyAction     , none            >
+    > { };
+
 public:
     ProtocolImplDef(Repository & _repositry, ProtocolTransport & _transport) :
         ProtocolController(_repositry, _transport)
@@ -603,18 +707,97 @@ public:
     }
 
 protected:
+    // An exception must not leave the state machine, otherwise it stays in the event processing mode
+    // and queues all the following events. The session could not be used after a bad command.
     void no_transition(const EventBase & , ProtocolImplDef &, int)
     {
-        throw ProtocolException(ResponseCode::badCommandsSequence, "Bad commands sequence");
+        writeResponse(ResponseCode::badCommandsSequence);
+        listen();
     }
 
     void exception_caught(const EventBase & , ProtocolImplDef &, std::exception & _error)
     {
-        throw ProtocolException(ResponseCode::badCommandsSequence,
-            std::string("State machine's exception has occurred: ") + _error.what());
+        const ProtocolException * protocol_error = dynamic_cast<const ProtocolException *>(&_error);
+        if(protocol_error)
+        {
+            LOG_ERROR << "SMTP error: " << protocol_error->what();
+            writeResponse(protocol_error->response());
+        }
+        else
+        {
+            LOG_ERROR << "State machine's exception has occurred: " << _error.what();
+            writeResponse(ResponseCode::badCommandsSequence);
+        }
+        listen();
     }
 }; // class ProtocolImplDef
 
+enum class Verb
+{
+    unknown,
+    ehlo,
+    helo,
+    mail,
+    rcpt,
+    data,
+    rset,
+    noop,
+    vrfy,
+    quit,
+    startTls
+}; // enum class Verb
+
+// Folds four octets to a lowercase code. Only letters occur in verbs, so the folding
+// can not make a non-letter octet equal to a verb letter.
+constexpr uint32_t verbCode(char _c0, char _c1, char _c2, char _c3)
+{
+    return ((static_cast<uint32_t>(static_cast<unsigned char>(_c0)) << 24) |
+        (static_cast<uint32_t>(static_cast<unsigned char>(_c1)) << 16) |
+        (static_cast<uint32_t>(static_cast<unsigned char>(_c2)) << 8) |
+        static_cast<uint32_t>(static_cast<unsigned char>(_c3))) | 0x20202020u;
+}
+
+constexpr uint32_t verbCode(const char (& _verb)[5])
+{
+    return verbCode(_verb[0], _verb[1], _verb[2], _verb[3]);
+}
+
+inline bool isVerbEnd(const char * _data, size_t _data_length, size_t _verb_length)
+{
+    return _data_length == _verb_length || ' ' == _data[_verb_length] || '\r' == _data[_verb_length];
+}
+
+Verb classifyVerb(const char * _data, size_t _data_length)
+{
+    static const size_t s_verb_length = 4;
+    if(_data_length < s_verb_length)
+        return Verb::unknown;
+    Verb verb = Verb::unknown;
+    switch(verbCode(_data[0], _data[1], _data[2], _data[3]))
+    {
+    case verbCode(VERB_EHLO): verb = Verb::ehlo; break;
+    case verbCode(VERB_HELO): verb = Verb::helo; break;
+    case verbCode(VERB_MAIL): verb = Verb::mail; break;
+    case verbCode(VERB_RCPT): verb = Verb::rcpt; break;
+    case verbCode(VERB_DATA): verb = Verb::data; break;
+    case verbCode(VERB_RSET): verb = Verb::rset; break;
+    case verbCode(VERB_NOOP): verb = Verb::noop; break;
+    case verbCode(VERB_VRFY): verb = Verb::vrfy; break;
+    case verbCode(VERB_QUIT): verb = Verb::quit; break;
+    case verbCode('S', 'T', 'A', 'R'):
+        if(_data_length >= sizeof(VERB_STARTTLS) - 1 &&
+            verbCode(_data[4], _data[5], _data[6], _data[7]) == verbCode('T', 'T', 'L', 'S') &&
+            isVerbEnd(_data, _data_length, sizeof(VERB_STARTTLS) - 1))
+        {
+            return Verb::startTls;
+        }
+        return Verb::unknown;
+    default:
+        return Verb::unknown;
+    }
+    return isVerbEnd(_data, _data_length, s_verb_length) ? verb : Verb::unknown;
+}
+
 std::ptrdiff_t findEndOfLinePosition(const char * _data, size_t _data_length)
 {
     boost::iterator_range<const char *> data_range(_data, _data + _data_length);
@@ -633,6 +816,16 @@ public:
     {
     }
 
+    static void * operator new(std::size_t)
+    {
+        return SlabPool<sizeof(ProtocolImpl)>::acquire();
+    }
+
+    static void operator delete(void * _pointer)
+    {
+        SlabPool<sizeof(ProtocolImpl)>::release(_pointer);
+    }
+
     template<typename EventT>
     void processEvent(const char * _data, std::size_t _data_length) noexcept;
 }; // class Protocol::ProtocolImpl
@@ -690,15 +883,14 @@ bool ProtocolTransport::callNextAction()
 
 Protocol::Protocol(Repository & _repository, ProtocolTransport & _transport) :
     mp_impl(new ProtocolImpl(boost::ref(_repository), boost::ref(_transport))),
-    mp_data(nullptr),
-    m_data_length(0)
+    m_data_length(0),
+    m_line_too_long(false)
 {
 }
 
 Protocol::~Protocol()
 {
     delete mp_impl;
-    free(mp_data);
 }
 
 void Protocol::enableStartTls(bool _enable)
@@ -726,60 +918,102 @@ void Protocol::processInput(const char * _data, size_t _data_length) noexcept
         mp_impl->processEvent<RawDataEvent>(_data, _data_length);
         return;
     }
-    std::ptrdiff_t end_of_line_pos = findEndOfLinePosition(_data, _data_length);
+    if(m_line_too_long)
+    {
+        skipLongLine(_data, _data_length);
+        return;
+    }
+    // The CRLF can be split between two reads.
+    size_t search_from = m_data_length > 0 ? m_data_length - 1 : 0;
+    size_t copied_length = extendData(_data, _data_length);
+    std::ptrdiff_t end_of_line_pos = findEndOfLinePosition(&m_data[search_from], m_data_length - search_from);
     if(end_of_line_pos < 0)
     {
-        extendData(_data, _data_length);
-        mp_impl->listen();
+        if(m_data_length < s_max_line_length)
+        {
+            mp_impl->listen();
+            return;
+        }
+        m_line_too_long = true;
+        skipLongLine(&_data[copied_length], _data_length - copied_length);
         return;
     }
-    extendData(_data, end_of_line_pos);
+    size_t line_length = search_from + end_of_line_pos + sizeof(MU_SMTP_ENDLINE) - 1;
     BOOST_SCOPE_EXIT(this_) {
         this_->resetData();
     } BOOST_SCOPE_EXIT_END
 
-    if(strncmp(VERB_EHLO, mp_data, sizeof(VERB_EHLO) - 1) == 0)
-    {
-        mp_impl->processEvent<EhloEvent>(_data, _data_length);
-    }
-    else if(strncmp(VERB_MAIL, mp_data, sizeof(VERB_MAIL) - 1) == 0)
-    {
-        mp_impl->processEvent<MailFromEvent>(_data, _data_length);
-    }
-    else if(strncmp(VERB_RCPT, mp_data, sizeof(VERB_RCPT) - 1) == 0)
-    {
-        mp_impl->processEvent<RcptToEvent>(_data, _data_length);
-    }
-    else if(strncmp(VERB_DATA, mp_data, sizeof(VERB_DATA) - 1) == 0)
-    {
-        mp_impl->processEvent<DataHeaderEvent>(_data, _data_length);
-    }
-    else if(strncmp(VERB_STARTTLS, mp_data, sizeof(VERB_STARTTLS) - 1) == 0)
-    {
-        mp_impl->processEvent<StartTlsEvent>(_data, _data_length);
-    }
-    else if(strncmp(VERB_QUIT, mp_data, sizeof(VERB_QUIT) - 1) == 0)
-    {
-        mp_impl->processEvent<QuitEvent>(_data, _data_length);
-    }
-    else
+    switch(classifyVerb(m_data, line_length))
     {
+    case Verb::ehlo:
+        mp_impl->processEvent<EhloEvent>(m_data, line_length);
+        break;
+    case Verb::helo:
+        mp_impl->processEvent<HeloEvent>(m_data, line_length);
+        break;
+    case Verb::mail:
+        mp_impl->processEvent<MailFromEvent>(m_data, line_length);
+        break;
+    case Verb::rcpt:
+        mp_impl->processEvent<RcptToEvent>(m_data, line_length);
+        break;
+    case Verb::data:
+        mp_impl->processEvent<DataHeaderEvent>(m_data, line_length);
+        break;
+    case Verb::rset:
+        mp_impl->processEvent<ResetEvent>(m_data, line_length);
+        break;
+    case Verb::noop:
+        mp_impl->processEvent<NoopEvent>(m_data, line_length);
+        break;
+    case Verb::vrfy:
+        mp_impl->processEvent<VerifyEvent>(m_data, line_length);
+        break;
+    case Verb::startTls:
+        mp_impl->processEvent<StartTlsEvent>(m_data, line_length);
+        break;
+    case Verb::quit:
+        mp_impl->processEvent<QuitEvent>(m_data, line_length);
+        break;
+    default:
         mp_impl->writeResponse(ResponseCode::unrecognizedCommand);
         mp_impl->listen();
+        break;
     }
 }
 
 void Protocol::resetData() noexcept
 {
-    free(mp_data);
     m_data_length = 0;
-    mp_data = nullptr;
+    m_line_too_long = false;
+}
+
+size_t Protocol::extendData(const char * _data, size_t _data_length) noexcept
+{
+    size_t length = std::min(_data_length, s_max_line_length - m_data_length);
+    memcpy(&m_data[m_data_length], _data, length);
+    m_data_length += length;
+    return length;
 }
 
-void Protocol::extendData(const char * _data, size_t _data_length) noexcept
+void Protocol::skipLongLine(const char * _data, size_t _data_length) noexcept
 {
-    size_t new_length = m_data_length + _data_length;
-    mp_data = static_cast<char *>(nullptr == mp_data ? malloc(new_length) : realloc(mp_data, new_length));
-    memcpy(&mp_data[m_data_length], _data, _data_length);
-    m_data_length = new_length;
+    // Only the last octet of the line is kept to find a CRLF split between two reads.
+    char * last_octet = &m_data[s_max_line_length - 1];
+    std::ptrdiff_t end_of_line_pos = -1;
+    if(_data_length > 0 && '\r' == *last_octet && '\n' == _data[0])
+        end_of_line_pos = 0;
+    else
+        end_of_line_pos = findEndOfLinePosition(_data, _data_length);
+    if(end_of_line_pos < 0)
+    {
+        if(_data_length > 0)
+            *last_octet = _data[_data_length - 1];
+        mp_impl->listen();
+        return;
+    }
+    static const Response response(ResponseCode::unrecognizedCommand, "Line too long");
+    resetData();
+    mp_impl->writeResponse(response);
+    mp_impl->listen();
 }
@@ -31,12 +31,15 @@ class ProtocolTransport
 {
 public:
     typedef std::function<void()> Action;
+    typedef std::function<void()> StoreTask;
+    typedef std::function<void(bool)> StoreCallback;
 
 public:
     virtual ~ProtocolTransport() { }
     virtual void requestForRead() = 0;
     virtual void requestForWrite(const Response & _response) = 0;
     virtual void requestForSwitchToTls() = 0;
+    virtual void requestForStore(StoreTask _task, StoreCallback _callback) = 0;
     virtual void requestForExit() = 0;
 
     void addNextAction(Action _action)
@@ -62,13 +65,17 @@ public:
 
 private:
     void resetData() noexcept;
-    void extendData(const char * _data, size_t _data_length) noexcept;
+    size_t extendData(const char * _data, size_t _data_length) noexcept;
+    void skipLongLine(const char * _data, size_t _data_length) noexcept;
 
 private:
+    // RFC 5321 limits a command line to 512 octets including the CRLF.
+    static const size_t s_max_line_length = 512;
     class ProtocolImpl;
     ProtocolImpl * mp_impl;
-    char * mp_data;
+    char m_data[s_max_line_length];
     size_t m_data_length;
+    bool m_line_too_long;
 }; // class Protocol
 
 } // namespace Smtp
@@ -16,6 +16,7 @@
  ***********************************************************************************************/
 
 #include <sstream>
+#include <map>
 #include <boost/preprocessor/stringize.hpp>
 #include <boost/asio/ip/host_name.hpp>
 #include <MailUnit/Smtp/Response.h>
@@ -39,6 +40,71 @@ std::string greeting()
     return result.str();
 }
 
+std::shared_ptr<const std::string> makeWireData(ResponseCode _code, const std::string & _message,
+    const std::vector<const ProtocolExtenstion *> & _extensions)
+{
+    std::stringstream stream;
+    if(_extensions.empty())
+    {
+        stream << static_cast<short>(_code) << ' ' << _message << MU_SMTP_ENDLINE;
+    }
+    else
+    {
+        stream << static_cast<short>(_code) << '-' << _message << MU_SMTP_ENDLINE;
+        std::size_t len = _extensions.size();
+        for(std::size_t i = 0; i < len - 1; ++i)
+        {
+            stream << static_cast<short>(_code) << '-' << *_extensions[i] << MU_SMTP_ENDLINE;
+        }
+        stream << static_cast<short>(_code) << ' ' << *_extensions.back() << MU_SMTP_ENDLINE;
+    }
+    return std::make_shared<const std::string>(stream.str());
+}
+
+typedef std::map<ResponseCode, std::shared_ptr<const std::string>> WireDataMap;
+
+WireDataMap makeDefaultWireData()
+{
+    static const ResponseCode codes[] =
+    {
+        ResponseCode::status,
+        ResponseCode::help,
+        ResponseCode::ready,
+        ResponseCode::closing,
+        ResponseCode::ok,
+        ResponseCode::forward,
+        ResponseCode::userNotVerified,
+        ResponseCode::intermediate,
+        ResponseCode::serviceNotAvailable,
+        ResponseCode::mailboxBusy,
+        ResponseCode::internalError,
+        ResponseCode::insufficientSystemStorage,
+        ResponseCode::invalidParameters,
+        ResponseCode::unrecognizedCommand,
+        ResponseCode::unrecognizedParameters,
+        ResponseCode::commandNotImplemented,
+        ResponseCode::badCommandsSequence,
+        ResponseCode::commandParameterNotImplemented,
+        ResponseCode::mailboxUnavailable,
+        ResponseCode::forwardPath,
+        ResponseCode::mailActionAborted,
+        ResponseCode::mailboxNameNotAllowed,
+        ResponseCode::transactionFailed,
+        ResponseCode::mailAddressNotRecognized
+    };
+    WireDataMap result;
+    for(ResponseCode code : codes)
+        result[code] = makeWireData(code, responseCodeDefaultMessage(code), { });
+    return result;
+}
+
+std::shared_ptr<const std::string> defaultWireData(ResponseCode _code)
+{
+    static const WireDataMap wire_data = makeDefaultWireData();
+    WireDataMap::const_iterator it = wire_data.find(_code);
+    return wire_data.end() == it ? makeWireData(_code, responseCodeDefaultMessage(_code), { }) : it->second;
+}
+
 } // namespace
 
 std::string MailUnit::Smtp::responseCodeDefaultMessage(ResponseCode _code)
@@ -98,27 +164,26 @@ std::string MailUnit::Smtp::responseCodeDefaultMessage(ResponseCode _code)
     }
 }
 
-void Response::addExtenstion(const ProtocolExtenstion & _extension)
+Response::Response(ResponseCode _code) :
+    m_code(_code),
+    m_wire_data_ptr(defaultWireData(_code))
+{
+}
+
+Response::Response(ResponseCode _code, const std::string & _message) :
+    m_code(_code),
+    m_wire_data_ptr(makeWireData(_code, _message, { }))
+{
+}
+
+Response::Response(ResponseCode _code, const std::vector<const ProtocolExtenstion *> & _extensions) :
+    m_code(_code),
+    m_wire_data_ptr(makeWireData(_code, responseCodeDefaultMessage(_code), _extensions))
 {
-    std::stringstream strstream;
-    strstream << _extension;
-    m_extenstions.push_back(strstream.str());
 }
 
 void Response::print(std::ostream & _stream) const
 {
-    if(m_extenstions.empty())
-    {
-        _stream << static_cast<short>(m_code) << ' ' << m_message;
-    }
-    else
-    {
-        _stream << static_cast<short>(m_code) << '-' << m_message << MU_SMTP_ENDLINE;
-        std::size_t len = m_extenstions.size();
-        for(std::size_t i = 0; i < len - 1; ++i)
-        {
-            _stream << static_cast<short>(m_code) << '-' << m_extenstions[i] << MU_SMTP_ENDLINE;
-        }
-        _stream << static_cast<short>(m_code) << ' ' << m_extenstions.back();
-    }
+    // The trailing CRLF is not printed.
+    _stream.write(m_wire_data_ptr->data(), m_wire_data_ptr->size() - (sizeof(MU_SMTP_ENDLINE) - 1));
 }
@@ -18,6 +18,7 @@
 #ifndef __MU_SMTP_RESPONSE_H__
 #define __MU_SMTP_RESPONSE_H__
 
+#include <memory>
 #include <vector>
 #include <sstream>
 #include <MailUnit/Smtp/ProtocolExtension.h>
@@ -57,24 +58,17 @@ enum class ResponseCode : short
 
 std::string responseCodeDefaultMessage(ResponseCode _code);
 
+// The reply is serialized once on construction. Copies share the immutable wire buffer,
+// so it can be passed to an asynchronous write as long as a copy is alive.
 class Response
 {
 public:
-    Response(ResponseCode _code) :
-        Response(_code, responseCodeDefaultMessage(_code))
-    {
-    }
-
-    Response(ResponseCode _code, const std::string & _message) :
-        m_code(_code),
-        m_message(_message)
-    {
-    }
-
+    Response(ResponseCode _code);
+    Response(ResponseCode _code, const std::string & _message);
+    Response(ResponseCode _code, const std::vector<const ProtocolExtenstion *> & _extensions);
     Response(const Response &) = default;
     Response & operator = (const Response &) = default;
 
-    void addExtenstion(const ProtocolExtenstion & _extension);
     void print(std::ostream & _stream) const;
 
     ResponseCode code() const
@@ -82,10 +76,15 @@ public:
         return m_code;
     }
 
+    // The serialized reply including the trailing CRLF.
+    const std::string & wireData() const
+    {
+        return *m_wire_data_ptr;
+    }
+
 private:
     ResponseCode m_code;
-    std::string m_message;
-    std::vector<std::string> m_extenstions;
+    std::shared_ptr<const std::string> m_wire_data_ptr;
 }; // class Response
 
 } // namespace Smtp
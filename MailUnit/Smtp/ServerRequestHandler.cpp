@@ -15,13 +15,13 @@
  *                                                                                             *
  ***********************************************************************************************/
 
-#include <sstream>
-#include <atomic>
+#include <cstdint>
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <MailUnit/Logger.h>
+#include <MailUnit/SlabAllocator.h>
 #include <MailUnit/Server/Tcp/TcpSession.h>
 #include <MailUnit/Smtp/Protocol.h>
 #include <MailUnit/Smtp/ServerRequestHandler.h>
@@ -39,12 +39,14 @@ class SmtpSession final :
     public ProtocolTransport
 {
 public:
-    inline SmtpSession(TcpSocket _socket, std::shared_ptr<Repository> _repository, const Config & _config);
+    inline SmtpSession(TcpSocket _socket, std::shared_ptr<Repository> _repository,
+        std::shared_ptr<StorageExecutor> _executor, const Config & _config);
     ~SmtpSession() override;
     void start() override;
     void requestForRead() override;
     void requestForWrite(const Response & _response) override;
     void requestForSwitchToTls() override;
+    void requestForStore(StoreTask _task, StoreCallback _callback) override;
     void requestForExit() override;
 
 private:
@@ -54,24 +56,33 @@ private:
 private:
     static const size_t s_buffer_size = 1024;
     std::shared_ptr<Repository> m_repository_ptr;
-    char * mp_buffer;
-    Protocol * mp_protocol;
+    std::shared_ptr<StorageExecutor> m_executor_ptr;
+    char m_buffer[s_buffer_size];
+    Protocol m_protocol;
     const Config & mr_config;
+    // Keeps the wire buffer of the reply being written alive.
+    boost::optional<Response> m_current_response;
     static const size_t s_deadline_timeout = 30000;
-    std::atomic<boost::asio::deadline_timer *> m_deadline_timer;
+    boost::asio::deadline_timer m_deadline_timer;
+    // Tells a handler of an expired timer that was already queued when the deadline was stopped or restarted.
+    uint64_t m_deadline_generation;
 }; // class SmtpSession
 
 } // namespace
 
-ServerRequestHandler::ServerRequestHandler(std::shared_ptr<Storage::Repository> _repository, const Config & _config) :
+ServerRequestHandler::ServerRequestHandler(std::shared_ptr<Storage::Repository> _repository,
+    std::shared_ptr<Storage::StorageExecutor> _executor, const Config & _config) :
     m_repository_ptr(_repository),
+    m_executor_ptr(_executor),
     mr_config(_config)
 {
 }
 
 std::shared_ptr<Session> ServerRequestHandler::createSession(boost::asio::ip::tcp::socket _socket)
 {
-    return std::make_shared<SmtpSession>(std::move(_socket), m_repository_ptr, mr_config);
+    // Sessions with their buffers are recycled through the slab pool instead of the heap.
+    return std::allocate_shared<SmtpSession>(SlabAllocator<SmtpSession>(),
+        std::move(_socket), m_repository_ptr, m_executor_ptr, mr_config);
 }
 
 bool ServerRequestHandler::handleError(const boost::system::error_code & _err_code)
@@ -80,44 +91,47 @@ bool ServerRequestHandler::handleError(const boost::system::error_code & _err_co
     return false;
 }
 
-SmtpSession::SmtpSession(TcpSocket _socket, std::shared_ptr<Repository> _repository, const Config & _config) :
+SmtpSession::SmtpSession(TcpSocket _socket, std::shared_ptr<Repository> _repository,
+    std::shared_ptr<StorageExecutor> _executor, const Config & _config) :
     TcpSession(std::move(_socket)),
     m_repository_ptr(_repository),
-    mp_buffer(new char[s_buffer_size]),
+    m_executor_ptr(_executor),
+    m_protocol(*m_repository_ptr, *this),
     mr_config(_config),
-    m_deadline_timer(nullptr)
+    m_deadline_timer(tcpSocket().get_io_service()),
+    m_deadline_generation(0)
 {
     LOG_DEBUG << "New SMTP session has started";
-    mp_protocol = new Protocol(*m_repository_ptr, *this);
     if(mr_config.use_smtp_starttls)
-        mp_protocol->enableStartTls(true);
+        m_protocol.enableStartTls(true);
 }
 
 SmtpSession::~SmtpSession()
 {
     LOG_DEBUG << "SMTP session has closed";
     stopDeadlineTimer();
-    delete [] mp_buffer;
-    delete mp_protocol;
 }
 
 void SmtpSession::start()
 {
-    mp_protocol->start();
-    callNextAction();
+    auto self(shared_from_this());
+    post([self]() {
+        self->m_protocol.start();
+        self->callNextAction();
+    });
 }
 
 void SmtpSession::requestForRead()
 {
     startDeadlineTimer();
     auto self(shared_from_this());
-    readAsync(boost::asio::buffer(mp_buffer, s_buffer_size - 1),
+    readAsync(boost::asio::buffer(m_buffer, s_buffer_size - 1),
         [self](const boost::system::error_code & ec, std::size_t length)
         {
             if(ec) return; // TODO: log
             self->stopDeadlineTimer();
-            self->mp_buffer[length] = '\0';
-            self->mp_protocol->processInput(self->mp_buffer, length);
+            self->m_buffer[length] = '\0';
+            self->m_protocol.processInput(self->m_buffer, length);
             // TODO: handle error
             self->callNextAction();
         });
@@ -125,13 +139,13 @@ void SmtpSession::requestForRead()
 
 void SmtpSession::requestForWrite(const Response & _response)
 {
-    std::stringstream data;
-    data << _response << MU_SMTP_ENDLINE;
+    m_current_response = _response;
     auto self(shared_from_this());
-    writeAsync(boost::asio::buffer(data.str()),
+    writeAsync(boost::asio::buffer(m_current_response->wireData()),
         [self](const boost::system::error_code &, std::size_t)
         {
             // TODO: handle error
+            self->m_current_response = boost::none;
             self->callNextAction();
         });
 }
@@ -157,6 +171,31 @@ void SmtpSession::requestForSwitchToTls()
         });
 }
 
+void SmtpSession::requestForStore(StoreTask _task, StoreCallback _callback)
+{
+    auto self(shared_from_this());
+    bool accepted = m_executor_ptr->post([self, _task, _callback]() {
+        bool stored = true;
+        try
+        {
+            _task();
+        }
+        catch(const std::exception & error)
+        {
+            LOG_ERROR << "Unable to store a message: " << error.what();
+            stored = false;
+        }
+        self->post([self, _callback, stored]() {
+            _callback(stored);
+        });
+    });
+    if(!accepted)
+    {
+        LOG_WARN << "Storage queue is full, the message has been rejected";
+        _callback(false);
+    }
+}
+
 void SmtpSession::requestForExit()
 {
     // Just do nothing
@@ -164,35 +203,25 @@ void SmtpSession::requestForExit()
 
 void SmtpSession::startDeadlineTimer()
 {
-    stopDeadlineTimer();
-    boost::asio::deadline_timer * timer = new boost::asio::deadline_timer(tcpSocket().get_io_service(),
-        boost::posix_time::milliseconds(s_deadline_timeout));
     std::shared_ptr<SmtpSession> self(shared_from_this());
-    m_deadline_timer.exchange(timer);
-    timer->async_wait([self, timer](const boost::system::error_code & error) {
-        if(error)
-        {
-           return;
-           // TODO: error
-           // TODO: handle boost::asio::error::operation_aborted
-        }
-        delete self->m_deadline_timer.exchange(nullptr);
-        std::stringstream message;
-        message << Response(ResponseCode::serviceNotAvailable, "Error: timeout exceeded") << MU_SMTP_ENDLINE;
-        self->writeAsync(boost::asio::buffer(message.str()), [self](const boost::system::error_code &, std::size_t) {
+    uint64_t generation = ++m_deadline_generation;
+    m_deadline_timer.expires_from_now(boost::posix_time::milliseconds(s_deadline_timeout));
+    m_deadline_timer.async_wait(wrap([self, generation](const boost::system::error_code & error) {
+        // The deadline could be stopped or restarted after this handler had been queued.
+        if(error || generation != self->m_deadline_generation)
+            return;
+        static const Response response(ResponseCode::serviceNotAvailable, "Error: timeout exceeded");
+        self->writeAsync(boost::asio::buffer(response.wireData()), [self](const boost::system::error_code &, std::size_t) {
           // TODO: handle error
           self->tcpSocket().close();
         });
         LOG_DEBUG << "SMTP timeout has occurred";
-    });
+    }));
 }
 
 void SmtpSession::stopDeadlineTimer()
 {
-    boost::asio::deadline_timer * timer = m_deadline_timer.exchange(nullptr);
-    if(nullptr != timer)
-    {
-        timer->cancel();
-        delete timer;
-    }
+    ++m_deadline_generation;
+    boost::system::error_code error;
+    m_deadline_timer.cancel(error);
 }
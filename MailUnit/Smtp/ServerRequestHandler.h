@@ -24,6 +24,7 @@
 #include <MailUnit/Config.h>
 #include <MailUnit/Server/RequestHandler.h>
 #include <MailUnit/Storage/Repository.h>
+#include <MailUnit/Storage/StorageExecutor.h>
 
 namespace MailUnit {
 namespace Smtp {
@@ -31,12 +32,14 @@ namespace Smtp {
 class ServerRequestHandler : public MailUnit::Server::RequestHandler<boost::asio::ip::tcp::socket>
 {
 public:
-    ServerRequestHandler(std::shared_ptr<MailUnit::Storage::Repository> _repository, const Config & _config);
+    ServerRequestHandler(std::shared_ptr<MailUnit::Storage::Repository> _repository,
+        std::shared_ptr<MailUnit::Storage::StorageExecutor> _executor, const Config & _config);
     std::shared_ptr<Server::Session> createSession(boost::asio::ip::tcp::socket _socket) override;
     bool handleError(const boost::system::error_code & _err_code) override;
 
 private:
     std::shared_ptr<MailUnit::Storage::Repository> m_repository_ptr;
+    std::shared_ptr<MailUnit::Storage::StorageExecutor> m_executor_ptr;
     const Config & mr_config;
 }; // class ServerRequestHandler
 
@@ -0,0 +1,484 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <boost/uuid/random_generator.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/restrict.hpp>
+#include <openssl/evp.h>
+#include <zlib.h>
+#include <MailUnit/OS/FileSystem.h>
+#include <MailUnit/Storage/BlobStore.h>
+#include <MailUnit/Storage/StorageException.h>
+
+using namespace MailUnit::Storage;
+namespace fs = boost::filesystem;
+namespace io = boost::iostreams;
+
+namespace {
+
+static const char segment_ext[] = ".seg";
+static const char compressed_file_ext[] = ".z";
+static const char head_file_ext[] = ".h";
+static const char body_file_ext[] = ".b";
+static const size_t copy_buffer_size = 64 * 1024;
+static const size_t data_id_length = 36;
+
+uint64_t copyData(std::istream & _in, std::ostream & _out, uint64_t _length)
+{
+    char buffer[copy_buffer_size];
+    uint64_t copied = 0;
+    while(copied < _length)
+    {
+        std::streamsize chunk = static_cast<std::streamsize>(std::min<uint64_t>(copy_buffer_size, _length - copied));
+        std::streamsize read = _in.read(buffer, chunk).gcount();
+        if(read <= 0)
+            break;
+        _out.write(buffer, read);
+        copied += read;
+    }
+    return copied;
+}
+
+void writeLittleEndian(std::ostream & _out, uint64_t _value, size_t _size)
+{
+    for(size_t i = 0; i < _size; ++i)
+    {
+        _out.put(static_cast<char>((_value >> (i * 8)) & 0xFF));
+    }
+}
+
+std::string makeDataIdSuffix(BlobKind _kind, BlobEncoding _encoding)
+{
+    std::string suffix;
+    if(BlobKind::head == _kind)
+        suffix = head_file_ext;
+    else if(BlobKind::body == _kind)
+        suffix = body_file_ext;
+    if(BlobEncoding::zlib == _encoding)
+        suffix += compressed_file_ext;
+    return suffix;
+}
+
+uint32_t makeRecordSignature(BlobKind _kind, BlobEncoding _encoding)
+{
+    switch(_kind)
+    {
+    case BlobKind::head:
+        return BlobStore::head_segment_record_signature;
+    case BlobKind::body:
+        return BlobEncoding::zlib == _encoding ?
+            BlobStore::compressed_body_segment_record_signature : BlobStore::body_segment_record_signature;
+    default:
+        return BlobEncoding::zlib == _encoding ?
+            BlobStore::compressed_segment_record_signature : BlobStore::segment_record_signature;
+    }
+}
+
+// Reads the streams one after another.
+class SequenceSource
+{
+public:
+    typedef char char_type;
+    typedef io::source_tag category;
+
+    explicit SequenceSource(const std::vector<std::shared_ptr<std::istream>> & _streams) :
+        m_state_ptr(std::make_shared<State>())
+    {
+        m_state_ptr->streams = _streams;
+        m_state_ptr->index = 0;
+    }
+
+    std::streamsize read(char * _buffer, std::streamsize _size)
+    {
+        State & state = *m_state_ptr;
+        for(; state.index < state.streams.size(); ++state.index)
+        {
+            std::streamsize read = state.streams[state.index]->read(_buffer, _size).gcount();
+            if(read > 0)
+                return read;
+        }
+        return -1;
+    }
+
+private:
+    // Boost.Iostreams copies the device, so the position is shared by the copies.
+    struct State
+    {
+        std::vector<std::shared_ptr<std::istream>> streams;
+        size_t index;
+    };
+
+private:
+    std::shared_ptr<State> m_state_ptr;
+}; // class SequenceSource
+
+class FileBlobStore : public BlobStore
+{
+public:
+    FileBlobStore(const fs::path & _data_directory, DeletionQueue & _deletion_queue) :
+        BlobStore(_data_directory, _deletion_queue)
+    {
+    }
+
+    BlobLocation store(std::istream & _data, uint64_t _length, BlobEncoding _encoding, BlobKind _kind) override;
+
+    void reset() override
+    {
+    }
+
+    std::string activeSegment() override
+    {
+        return std::string();
+    }
+}; // class FileBlobStore
+
+class SegmentBlobStore : public BlobStore
+{
+public:
+    SegmentBlobStore(const fs::path & _data_directory, DeletionQueue & _deletion_queue, uint64_t _segment_size) :
+        BlobStore(_data_directory, _deletion_queue),
+        m_segment_size(_segment_size),
+        m_active_segment_size(0)
+    {
+    }
+
+    BlobLocation store(std::istream & _data, uint64_t _length, BlobEncoding _encoding, BlobKind _kind) override;
+
+    void reset() override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        closeSegment();
+    }
+
+    std::string activeSegment() override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_active_segment;
+    }
+
+private:
+    void openSegment();
+    void closeSegment();
+
+private:
+    std::mutex m_mutex;
+    uint64_t m_segment_size;
+    std::string m_active_segment;
+    uint64_t m_active_segment_size;
+    std::ofstream m_segment_stream;
+}; // class SegmentBlobStore
+
+thread_local static boost::uuids::random_generator uuid_generator;
+
+} // namespace
+
+fs::path BlobStore::dataFilePath(const std::string & _data_id) const
+{
+    fs::path path = m_data_directory;
+    // Message files are spread over the data/ab/cd/ directories; segments are few and stay at the top level.
+    if(!isSegment(_data_id) && _data_id.size() > shard_depth * shard_prefix_length)
+    {
+        for(size_t level = 0; level < shard_depth; ++level)
+            path /= MailUnit::OS::utf8ToPathString(_data_id.substr(level * shard_prefix_length, shard_prefix_length));
+    }
+    return path / fs::path(MailUnit::OS::utf8ToPathString(_data_id));
+}
+
+size_t BlobStore::shardDataFiles()
+{
+    size_t count = 0;
+    std::vector<fs::path> paths;
+    for(fs::directory_iterator it(m_data_directory), end; it != end; ++it)
+    {
+        const fs::path & path = it->path();
+        if(fs::is_regular_file(path) && !path.has_extension() && path.filename().native().size() == data_id_length)
+            paths.push_back(path);
+    }
+    for(const fs::path & path : paths)
+    {
+        fs::path sharded_path = dataFilePath(path.filename().string());
+        fs::create_directories(sharded_path.parent_path());
+        fs::rename(path, sharded_path);
+        ++count;
+    }
+    return count;
+}
+
+bool BlobStore::isSegment(const std::string & _data_id)
+{
+    return boost::algorithm::ends_with(_data_id, segment_ext);
+}
+
+bool BlobStore::parseDataId(const std::string & _data_id, BlobKind & _kind, BlobEncoding & _encoding)
+{
+    if(_data_id.size() < data_id_length)
+        return false;
+    std::string suffix = _data_id.substr(data_id_length);
+    const BlobKind kinds[] = { BlobKind::message, BlobKind::head, BlobKind::body };
+    const BlobEncoding encodings[] = { BlobEncoding::identity, BlobEncoding::zlib };
+    for(BlobKind kind : kinds)
+    {
+        for(BlobEncoding encoding : encodings)
+        {
+            // Heads are never compressed.
+            if(BlobKind::head == kind && BlobEncoding::zlib == encoding)
+                continue;
+            if(makeDataIdSuffix(kind, encoding) == suffix)
+            {
+                _kind = kind;
+                _encoding = encoding;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool BlobStore::parseRecordSignature(uint32_t _signature, BlobKind & _kind, BlobEncoding & _encoding)
+{
+    switch(_signature)
+    {
+    case segment_record_signature:
+        _kind = BlobKind::message;
+        _encoding = BlobEncoding::identity;
+        return true;
+    case compressed_segment_record_signature:
+        _kind = BlobKind::message;
+        _encoding = BlobEncoding::zlib;
+        return true;
+    case head_segment_record_signature:
+        _kind = BlobKind::head;
+        _encoding = BlobEncoding::identity;
+        return true;
+    case body_segment_record_signature:
+        _kind = BlobKind::body;
+        _encoding = BlobEncoding::identity;
+        return true;
+    case compressed_body_segment_record_signature:
+        _kind = BlobKind::body;
+        _encoding = BlobEncoding::zlib;
+        return true;
+    default:
+        return false;
+    }
+}
+
+void BlobStore::release(const std::vector<std::string> & _data_ids)
+{
+    std::vector<fs::path> paths;
+    for(const std::string & data_id : _data_ids)
+    {
+        // Segments are reclaimed by the compaction only.
+        if(!isSegment(data_id))
+            paths.push_back(dataFilePath(data_id));
+    }
+    mr_deletion_queue.enqueue(paths);
+}
+
+BlobLocation FileBlobStore::store(std::istream & _data, uint64_t _length, BlobEncoding _encoding, BlobKind _kind)
+{
+    BlobLocation location = { boost::uuids::to_string(uuid_generator()) + makeDataIdSuffix(_kind, _encoding), 0, 0 };
+    fs::path path = dataFilePath(location.data_id);
+    boost::system::error_code error;
+    fs::create_directories(path.parent_path(), error);
+    std::ofstream out(path.string(), std::ios_base::binary);
+    if(!out.is_open())
+        throw StorageException("Unable to create a data file");
+    location.length = copyData(_data, out, _length);
+    out.flush();
+    if(!out)
+        throw StorageException("Unable to write a data file");
+    return location;
+}
+
+BlobLocation SegmentBlobStore::store(std::istream & _data, uint64_t _length, BlobEncoding _encoding, BlobKind _kind)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_segment_stream.is_open())
+        openSegment();
+    BlobLocation location = { m_active_segment, m_active_segment_size + segment_record_header_size, 0 };
+    writeLittleEndian(m_segment_stream, makeRecordSignature(_kind, _encoding), sizeof(uint32_t));
+    writeLittleEndian(m_segment_stream, _length, sizeof(uint64_t));
+    location.length = copyData(_data, m_segment_stream, _length);
+    if(location.length < _length)
+    {
+        // Keep the record length declared in the header valid for a sequential scan.
+        for(uint64_t i = location.length; i < _length; ++i)
+            m_segment_stream.put('\0');
+    }
+    m_segment_stream.flush();
+    if(!m_segment_stream)
+    {
+        closeSegment();
+        throw StorageException("Unable to write a segment file");
+    }
+    m_active_segment_size = location.offset + _length;
+    if(m_active_segment_size >= m_segment_size)
+        closeSegment();
+    return location;
+}
+
+void SegmentBlobStore::openSegment()
+{
+    m_active_segment = boost::uuids::to_string(uuid_generator()) + segment_ext;
+    m_active_segment_size = 0;
+    m_segment_stream.open(dataFilePath(m_active_segment).string(), std::ios_base::binary | std::ios_base::app);
+    if(!m_segment_stream.is_open())
+    {
+        m_active_segment.clear();
+        throw StorageException("Unable to create a segment file");
+    }
+}
+
+void SegmentBlobStore::closeSegment()
+{
+    if(m_segment_stream.is_open())
+        m_segment_stream.close();
+    m_segment_stream.clear();
+    m_active_segment.clear();
+    m_active_segment_size = 0;
+}
+
+void MailUnit::Storage::encodeBlob(std::istream & _in, std::ostream & _out, BlobEncoding _encoding, int _level)
+{
+    io::filtering_ostream out;
+    if(BlobEncoding::zlib == _encoding)
+        out.push(io::zlib_compressor(io::zlib_params(_level)));
+    out.push(_out);
+    io::copy(_in, out);
+}
+
+std::string MailUnit::Storage::hashBlob(std::istream & _in)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+    std::unique_ptr<EVP_MD_CTX, void(*)(EVP_MD_CTX *)> context(EVP_MD_CTX_new(), &EVP_MD_CTX_free);
+    if(!context || 1 != EVP_DigestInit_ex(context.get(), EVP_sha256(), nullptr))
+        throw StorageException("Unable to initialize a blob hash");
+    char buffer[8192];
+    while(_in)
+    {
+        _in.read(buffer, sizeof(buffer));
+        if(_in.gcount() > 0)
+            EVP_DigestUpdate(context.get(), buffer, static_cast<size_t>(_in.gcount()));
+    }
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    EVP_DigestFinal_ex(context.get(), digest, &digest_length);
+    std::string result;
+    result.reserve(digest_length * 2);
+    for(unsigned int i = 0; i < digest_length; ++i)
+    {
+        result += hex_digits[digest[i] >> 4];
+        result += hex_digits[digest[i] & 0x0F];
+    }
+    return result;
+}
+
+std::shared_ptr<std::istream> MailUnit::Storage::openBlob(const fs::path & _path, uint64_t _offset, uint64_t _length,
+    BlobEncoding _encoding)
+{
+    io::file_source source(_path.string(), std::ios_base::binary);
+    if(!source.is_open())
+        throw StorageException("Unable to open a data file");
+    std::shared_ptr<io::filtering_istream> stream = std::make_shared<io::filtering_istream>();
+    if(BlobEncoding::zlib == _encoding)
+        stream->push(io::zlib_decompressor());
+    stream->push(io::restrict(source, static_cast<io::stream_offset>(_offset), static_cast<io::stream_offset>(_length)));
+    return stream;
+}
+
+std::shared_ptr<std::istream> MailUnit::Storage::concatenateStreams(
+    const std::vector<std::shared_ptr<std::istream>> & _streams)
+{
+    std::shared_ptr<io::filtering_istream> stream = std::make_shared<io::filtering_istream>();
+    stream->push(SequenceSource(_streams));
+    return stream;
+}
+
+std::shared_ptr<std::istream> MailUnit::Storage::openZlibBlob(const std::string & _prefix, const fs::path & _path,
+    uint64_t _offset, uint64_t _length, uint64_t _size, uint64_t & _encoded_length)
+{
+    static const size_t zlib_header_size = 2;
+    static const size_t zlib_trailer_size = 4;
+    static const size_t max_stored_block_size = 0xFFFF;
+    if(_length < zlib_header_size + zlib_trailer_size)
+        throw StorageException("A zlib blob is too short");
+    unsigned char header[zlib_header_size];
+    unsigned char trailer[zlib_trailer_size];
+    {
+        std::ifstream blob(_path.string(), std::ios_base::binary);
+        if(!blob.is_open())
+            throw StorageException("Unable to open a data file");
+        blob.seekg(static_cast<std::streamoff>(_offset));
+        blob.read(reinterpret_cast<char *>(header), sizeof(header));
+        blob.seekg(static_cast<std::streamoff>(_offset + _length - sizeof(trailer)));
+        blob.read(reinterpret_cast<char *>(trailer), sizeof(trailer));
+        if(!blob)
+            throw StorageException("Unable to read a zlib blob");
+    }
+    // The prefix goes into stored deflate blocks between the zlib header of the blob and its deflate blocks,
+    // and the checksum of the blob is combined with the checksum of the prefix.
+    std::ostringstream prefix;
+    prefix.write(reinterpret_cast<const char *>(header), sizeof(header));
+    for(size_t position = 0; position < _prefix.size(); position += max_stored_block_size)
+    {
+        size_t block_size = std::min(max_stored_block_size, _prefix.size() - position);
+        prefix.put(' ');
+        writeLittleEndian(prefix, block_size, sizeof(uint16_t));
+        writeLittleEndian(prefix, ~block_size & max_stored_block_size, sizeof(uint16_t));
+        prefix.write(_prefix.data() + position, static_cast<std::streamsize>(block_size));
+    }
+    uLong blob_checksum = 0;
+    for(unsigned char byte : trailer)
+        blob_checksum = (blob_checksum << 8) | byte;
+    uLong prefix_checksum = adler32(adler32(0, Z_NULL, 0),
+        reinterpret_cast<const Bytef *>(_prefix.data()), static_cast<uInt>(_prefix.size()));
+    uLong checksum = adler32_combine(prefix_checksum, blob_checksum, static_cast<z_off_t>(_size));
+    std::string suffix;
+    for(size_t i = zlib_trailer_size; i > 0; --i)
+        suffix += static_cast<char>((checksum >> ((i - 1) * 8)) & 0xFF);
+    std::shared_ptr<std::istream> blocks = openBlob(_path, _offset + zlib_header_size,
+        _length - zlib_header_size - zlib_trailer_size);
+    _encoded_length = prefix.str().size() + _length - zlib_header_size;
+    return concatenateStreams({
+        std::make_shared<std::istringstream>(prefix.str()),
+        blocks,
+        std::make_shared<std::istringstream>(suffix)
+    });
+}
+
+std::unique_ptr<BlobStore> MailUnit::Storage::createBlobStore(BlobLayout _layout, const fs::path & _data_directory,
+    DeletionQueue & _deletion_queue, uint64_t _segment_size)
+{
+    switch(_layout)
+    {
+    case BlobLayout::segment:
+        return std::make_unique<SegmentBlobStore>(_data_directory, _deletion_queue, _segment_size);
+    default:
+        return std::make_unique<FileBlobStore>(_data_directory, _deletion_queue);
+    }
+}
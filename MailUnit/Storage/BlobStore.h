@@ -0,0 +1,132 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#ifndef __MU_STORAGE_BLOBSTORE_H__
+#define __MU_STORAGE_BLOBSTORE_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <istream>
+#include <cstdint>
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem/path.hpp>
+#include <MailUnit/Storage/DeletionQueue.h>
+
+namespace MailUnit {
+namespace Storage {
+
+enum class BlobLayout
+{
+    file,
+    segment
+}; // enum class BlobLayout
+
+enum class BlobEncoding
+{
+    identity = 0,
+    zlib     = 1
+}; // enum class BlobEncoding
+
+// A message is stored as a head blob with its header block and a body blob that is shared
+// by the messages with the same body. Whole message blobs are left by the older versions.
+enum class BlobKind
+{
+    message,
+    head,
+    body
+}; // enum class BlobKind
+
+struct BlobLocation
+{
+    std::string data_id;
+    uint64_t offset;
+    uint64_t length;
+}; // struct BlobLocation
+
+class BlobStore : private boost::noncopyable
+{
+public:
+    static const uint64_t default_segment_size = 64 * 1024 * 1024;
+    // The signature of a segment record tells the kind and the encoding of the blob that follows it.
+    static const uint32_t segment_record_signature = 0x3152554D; // "MUR1"
+    static const uint32_t compressed_segment_record_signature = 0x5A52554D; // "MURZ"
+    static const uint32_t head_segment_record_signature = 0x3148554D; // "MUH1"
+    static const uint32_t body_segment_record_signature = 0x3142554D; // "MUB1"
+    static const uint32_t compressed_body_segment_record_signature = 0x5A42554D; // "MUBZ"
+    // A head blob starts with the hex SHA-256 of its body, so the index can be recovered from the blobs.
+    static const size_t head_reference_size = 64;
+    static const size_t segment_record_header_size = sizeof(uint32_t) + sizeof(uint64_t);
+    static const size_t shard_prefix_length = 2;
+    static const size_t shard_depth = 2;
+
+public:
+    virtual ~BlobStore()
+    {
+    }
+
+    virtual BlobLocation store(std::istream & _data, uint64_t _length, BlobEncoding _encoding, BlobKind _kind) = 0;
+
+    virtual void reset() = 0;
+
+    virtual std::string activeSegment() = 0;
+
+    void release(const std::vector<std::string> & _data_ids);
+
+    boost::filesystem::path dataFilePath(const std::string & _data_id) const;
+
+    size_t shardDataFiles();
+
+    static bool isSegment(const std::string & _data_id);
+
+    static bool parseDataId(const std::string & _data_id, BlobKind & _kind, BlobEncoding & _encoding);
+
+    static bool parseRecordSignature(uint32_t _signature, BlobKind & _kind, BlobEncoding & _encoding);
+
+protected:
+    BlobStore(const boost::filesystem::path & _data_directory, DeletionQueue & _deletion_queue) :
+        m_data_directory(_data_directory),
+        mr_deletion_queue(_deletion_queue)
+    {
+    }
+
+protected:
+    boost::filesystem::path m_data_directory;
+    DeletionQueue & mr_deletion_queue;
+}; // class BlobStore
+
+void encodeBlob(std::istream & _in, std::ostream & _out, BlobEncoding _encoding, int _level);
+
+std::string hashBlob(std::istream & _in);
+
+std::shared_ptr<std::istream> openBlob(const boost::filesystem::path & _path, uint64_t _offset, uint64_t _length,
+    BlobEncoding _encoding = BlobEncoding::identity);
+
+std::shared_ptr<std::istream> concatenateStreams(const std::vector<std::shared_ptr<std::istream>> & _streams);
+
+// Opens a zlib stream of the _prefix followed by the zlib blob of the _size decoded bytes.
+// The blob is passed through without inflating it.
+std::shared_ptr<std::istream> openZlibBlob(const std::string & _prefix, const boost::filesystem::path & _path,
+    uint64_t _offset, uint64_t _length, uint64_t _size, uint64_t & _encoded_length);
+
+std::unique_ptr<BlobStore> createBlobStore(BlobLayout _layout, const boost::filesystem::path & _data_directory,
+    DeletionQueue & _deletion_queue, uint64_t _segment_size = BlobStore::default_segment_size);
+
+} // namespace Storage
+} // namespace MailUnit
+
+#endif // __MU_STORAGE_BLOBSTORE_H__
@@ -0,0 +1,85 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <boost/filesystem/operations.hpp>
+#include <MailUnit/Storage/DeletionQueue.h>
+#include <MailUnit/Logger.h>
+
+using namespace MailUnit::Storage;
+namespace fs = boost::filesystem;
+
+DeletionQueue::DeletionQueue() :
+    m_stopped(false)
+{
+    m_thread = std::thread([this]() {
+        run();
+    });
+}
+
+DeletionQueue::~DeletionQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+    }
+    m_condition.notify_one();
+    m_thread.join();
+}
+
+void DeletionQueue::enqueue(const fs::path & _path)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_paths.push_back(_path);
+    }
+    m_condition.notify_one();
+}
+
+void DeletionQueue::enqueue(const std::vector<fs::path> & _paths)
+{
+    if(_paths.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_paths.insert(m_paths.end(), _paths.begin(), _paths.end());
+    }
+    m_condition.notify_one();
+}
+
+void DeletionQueue::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for(;;)
+    {
+        m_condition.wait(lock, [this]() {
+            return m_stopped || !m_paths.empty();
+        });
+        if(m_paths.empty())
+            return;
+        std::deque<fs::path> paths;
+        paths.swap(m_paths);
+        lock.unlock();
+        for(const fs::path & path : paths)
+        {
+            boost::system::error_code error;
+            fs::remove_all(path, error);
+            if(error)
+                LOG_WARN << "Unable to delete \"" << path.string() << "\": " << error.message();
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,54 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#ifndef __MU_STORAGE_DELETIONQUEUE_H__
+#define __MU_STORAGE_DELETIONQUEUE_H__
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <boost/noncopyable.hpp>
+#include <boost/filesystem/path.hpp>
+
+namespace MailUnit {
+namespace Storage {
+
+class DeletionQueue final : private boost::noncopyable
+{
+public:
+    DeletionQueue();
+    ~DeletionQueue();
+    void enqueue(const boost::filesystem::path & _path);
+    void enqueue(const std::vector<boost::filesystem::path> & _paths);
+
+private:
+    void run();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<boost::filesystem::path> m_paths;
+    bool m_stopped;
+    std::thread m_thread;
+}; // class DeletionQueue
+
+} // namespace Storage
+} // namespace MailUnit
+
+#endif // __MU_STORAGE_DELETIONQUEUE_H__
@@ -28,6 +28,7 @@ namespace qi = boost::spirit::qi;
 BOOST_FUSION_ADAPT_STRUCT(
     BinaryCondition,
     (Identifier, identifier)
+    (IdentifierArgument, argument)
     (ConditionBinaryOperator, operator_)
     (ConditionValue, value)
 )
@@ -102,6 +103,8 @@ public:
 private:
     OperationSymbols m_operation;
     Rule<std::string()> m_identifier;
+    Rule<std::string()> m_string;
+    Rule<std::string()> m_identifier_argument;
     Rule<ConditionValue()> m_condition_value;
     Rule<BinaryCondition()> m_binary_condition;
     ConditionBinaryOperatorSymbols m_binary_operator;
@@ -117,8 +120,10 @@ Grammar::Grammar() :
     Grammar::base_type(m_expression)
 {
     m_identifier                   %= qi::lexeme[qi::ascii::alpha > *qi::ascii::alnum];
-    m_condition_value              %= qi::long_long | ("'" > qi::lexeme[*(~qi::ascii::char_('\''))] > "'");
-    m_binary_condition             %= m_identifier > m_binary_operator > m_condition_value;
+    m_string                       %= "'" > qi::lexeme[*(~qi::ascii::char_('\''))] > "'";
+    m_identifier_argument          %= "(" > m_string > ")";
+    m_condition_value              %= qi::long_long | m_string;
+    m_binary_condition             %= m_identifier > -m_identifier_argument > m_binary_operator > m_condition_value;
     m_bracketed_condition_sequence %= "(" > m_condition_sequence > ")";
     m_condition_sequence_operand   %= m_binary_condition | m_bracketed_condition_sequence;
     m_right_condition_sequence     %= qi::ascii::no_case[m_join_operator] > m_condition_sequence_operand;
@@ -242,7 +247,12 @@ std::ostream & operator << (std::ostream & _stream, ConditionJoinOperator _opera
 
 std::ostream & operator << (std::ostream & _stream, const BinaryCondition & _condition)
 {
-    _stream << _condition.identifier << ' ' << _condition.operator_ << ' ' << _condition.value;
+    _stream << _condition.identifier;
+    if(_condition.argument.is_initialized())
+    {
+        _stream << "('" << _condition.argument.get() << "')";
+    }
+    _stream << ' ' << _condition.operator_ << ' ' << _condition.value;
     return _stream;
 }
 
@@ -19,6 +19,7 @@
 #define __MU_STORAGE_EDSL_H__
 
 #include <memory>
+#include <cstdint>
 #include <string>
 #include <ostream>
 #include <vector>
@@ -40,7 +41,9 @@ enum class Operation
 
 typedef std::string Identifier;
 
-typedef boost::variant<int, std::string> ConditionValue;
+typedef boost::optional<std::string> IdentifierArgument;
+
+typedef boost::variant<int64_t, std::string> ConditionValue;
 
 enum class ConditionBinaryOperator
 {
@@ -55,6 +58,7 @@ enum class ConditionBinaryOperator
 struct BinaryCondition
 {
     Identifier identifier;
+    IdentifierArgument argument;
     ConditionBinaryOperator operator_;
     ConditionValue value;
 }; // struct SimpleCondition
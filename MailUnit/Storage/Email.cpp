@@ -1,5 +1,7 @@
 #include <sstream>
 #include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <MailUnit/OS/FileSystem.h>
 #include <MailUnit/Storage/Email.h>
 #include <LibMailUnit/Api/Include/Message/MailHeader.h>
@@ -11,45 +13,65 @@ namespace fs = boost::filesystem;
 
 namespace {
 
+// Calls _action for each address of the _address_list.
+// The list is parsed into the stack buffers and only unusually long lists fall back to the heap.
+template<typename Action>
+void forEachAddress(const char * _address_list, Action _action)
+{
+    MU_AddressListItem items[16];
+    char arena[1024];
+    size_t item_count = sizeof(items) / sizeof(items[0]);
+    size_t arena_size = sizeof(arena);
+    if(muAddressListParse(_address_list, items, &item_count, arena, &arena_size))
+    {
+        for(size_t i = 0; i < item_count; ++i)
+            _action(items[i].address);
+        return;
+    }
+    std::vector<MU_AddressListItem> heap_items;
+    std::vector<char> heap_arena;
+    do
+    {
+        heap_items.resize(item_count);
+        heap_arena.resize(arena_size);
+    }
+    while(!muAddressListParse(_address_list, heap_items.data(), &item_count, heap_arena.data(), &arena_size));
+    for(size_t i = 0; i < item_count; ++i)
+        _action(heap_items[i].address);
+}
+
 void collectAddressesFromHeader(MU_MailHeaderList * _headers, const char * _header_name,
     Email::AddressSet & _collection)
 {
-    MU_MailHeader * header = muMailHeaderByName(_headers, _header_name);
-    if(nullptr == header)
+    MU_MailHeaderView header;
+    if(!muMailHeaderFind(_headers, _header_name, &header))
         return;
-    size_t value_count = muMailHeaderValueCount(header);
-    for(size_t value_index = 0; value_index < value_count; ++value_index)
+    for(size_t value_index = 0; value_index < header.value_count; ++value_index)
     {
-        const char * header_value = muMailHeaderValue(header, value_index);
-        if(nullptr == header_value)
-            continue;
-        MU_MailboxGroup * group = muMailboxGroupParse(header_value);
-        if(nullptr == group)
-            continue;
-        size_t mailbox_count = muMailboxCount(group);
-        for(size_t mailbox_index = 0; mailbox_index < mailbox_count; ++mailbox_index)
-        {
-            MU_Mailbox * mailbox = muMailbox(group, mailbox_index);
-            if(nullptr != mailbox)
-                _collection.insert(muMailboxAddress(mailbox));
-            muFree(mailbox);
-        }
-        muFree(group);
+        forEachAddress(header.values[value_index], [&_collection](const char * _address) {
+            _collection.insert(_address);
+        });
     }
-    muFree(header);
+}
+
+void collectHeaderValues(MU_MailHeaderList * _headers, const std::string & _header_name,
+    Email::HeaderList & _collection)
+{
+    MU_MailHeaderView header;
+    if(!muMailHeaderFind(_headers, _header_name.c_str(), &header))
+        return;
+    std::string name = boost::to_lower_copy(_header_name);
+    for(size_t value_index = 0; value_index < header.value_count; ++value_index)
+        _collection.push_back(std::make_pair(name, boost::trim_copy(std::string(header.values[value_index]))));
 }
 
 std::time_t getDateTimeFromHeaders(MU_MailHeaderList * _headers)
 {
-    MU_MailHeader * date_time_header = muMailHeaderByName(_headers, MU_MAILHDR_DATE);
-    if(nullptr == date_time_header || muMailHeaderValueCount(date_time_header) == 0)
-        return 0;
-    const char * date_time_string = muMailHeaderValue(date_time_header, 0);
-    muFree(date_time_header);
-    if(nullptr == date_time_string)
+    MU_MailHeaderView date_time_header;
+    if(!muMailHeaderFind(_headers, MU_MAILHDR_DATE, &date_time_header) || date_time_header.value_count == 0)
         return 0;
     MU_DateTime date_time;
-    if(!muDateTimeParse(date_time_string, &date_time))
+    if(!muDateTimeParse(date_time_header.values[0], &date_time))
         return 0;
     return muDateTimeToUnixTime(&date_time);
 }
@@ -59,7 +81,13 @@ std::time_t getDateTimeFromHeaders(MU_MailHeaderList * _headers)
 Email::Email(uint32_t _id, const boost::filesystem::path & _data_file_path, bool _parse_file) :
     m_id(_id),
     m_data_file_path(_data_file_path),
-    m_sending_time(0)
+    m_data_offset(0),
+    m_data_length(0),
+    m_data_encoding(BlobEncoding::identity),
+    m_head_offset(0),
+    m_head_length(0),
+    m_sending_time(0),
+    m_size(0)
 {
     if(!fs::is_regular_file(m_data_file_path) && !fs::is_symlink(m_data_file_path))
     {
@@ -70,64 +98,111 @@ Email::Email(uint32_t _id, const boost::filesystem::path & _data_file_path, bool
     if(_parse_file)
     {
         OS::File file(m_data_file_path, OS::file_open_read);
-        parseHeaders(file);
+        parseHeaders(muMailHeadersParseFile(file), std::vector<std::string>());
     }
 }
 
-Email::Email(const RawEmail & _raw, const boost::filesystem::path & _data_file_path) :
+Email::Email(const RawEmail & _raw, const std::vector<std::string> & _indexed_headers) :
     m_id(new_object_id),
-    m_data_file_path(_data_file_path)
+    m_data_file_path(_raw.dataFilePath()),
+    m_data_offset(0),
+    m_data_encoding(BlobEncoding::identity),
+    m_head_offset(0),
+    m_head_length(0),
+    m_sending_time(0)
 {
-    fs::copy(_raw.dataFilePath(), m_data_file_path);
+    m_size = fs::file_size(m_data_file_path);
+    m_data_length = m_size;
     OS::File file(m_data_file_path, OS::file_open_read);
-    parseHeaders(file);
+    parseHeaders(muMailHeadersParseFile(file), _indexed_headers);
     appendFrom(_raw);
     appendBcc(_raw);
 }
 
-void Email::parseHeaders(MU_File _file)
+Email::Email(const boost::filesystem::path & _data_file_path, const std::string & _data,
+    const std::vector<std::string> & _indexed_headers) :
+    m_id(new_object_id),
+    m_data_file_path(_data_file_path),
+    m_data_offset(0),
+    m_data_length(_data.size()),
+    m_data_encoding(BlobEncoding::identity),
+    m_head_offset(0),
+    m_head_length(0),
+    m_sending_time(0),
+    m_size(_data.size())
 {
-    MU_MailHeaderList * headers = muMailHeadersParseFile(_file);
-    if(nullptr == headers)
-        return;
-    MU_MailHeader * subject_header = muMailHeaderByName(headers, MU_MAILHDR_SUBJECT);
-    if(nullptr != subject_header && muMailHeaderValueCount(subject_header) > 0)
-        m_subject = muMailHeaderValue(subject_header, 0);
-    muFree(subject_header);
-    m_sending_time = getDateTimeFromHeaders(headers);
-    collectAddressesFromHeader(headers, MU_MAILHDR_FROM, m_from_addresses);
-    collectAddressesFromHeader(headers, MU_MAILHDR_TO, m_to_addresses);
-    collectAddressesFromHeader(headers, MU_MAILHDR_CC, m_cc_addresses);
-    collectAddressesFromHeader(headers, MU_MAILHDR_BCC, m_bcc_addresses);
-    muFree(headers);
+    parseHeaders(muMailHeadersParseString(_data.c_str()), _indexed_headers);
 }
 
-void Email::appendFrom(const RawEmail & _raw)
+std::string Email::normalizeMessageId(const std::string & _message_id)
 {
-    for(const std::string raw_from : _raw.fromAddresses())
+    std::string result = boost::trim_copy(_message_id);
+    if(result.size() >= 2 && result.front() == '<' && result.back() == '>')
+        result = result.substr(1, result.size() - 2);
+    return result;
+}
+
+std::shared_ptr<std::istream> Email::openData() const
+{
+    std::shared_ptr<std::istream> data = openBlob(m_data_file_path, m_data_offset, m_data_length, m_data_encoding);
+    if(0 == m_head_length)
+        return data;
+    return concatenateStreams({ openBlob(m_head_file_path, m_head_offset, m_head_length), data });
+}
+
+std::shared_ptr<std::istream> Email::openEncodedData(uint64_t & _length) const
+{
+    if(BlobEncoding::zlib != m_data_encoding)
+        throw StorageException("Message data is not compressed");
+    std::string head;
+    if(m_head_length > 0)
+    {
+        std::shared_ptr<std::istream> stream = openBlob(m_head_file_path, m_head_offset, m_head_length);
+        head.assign(std::istreambuf_iterator<char>(*stream), std::istreambuf_iterator<char>());
+    }
+    return openZlibBlob(head, m_data_file_path, m_data_offset, m_data_length, m_size - head.size(), _length);
+}
+
+void Email::parseHeaders(MU_MailHeaderList * _headers, const std::vector<std::string> & _indexed_headers)
+{
+    if(nullptr == _headers)
+        return;
+    MU_MailHeaderView header;
+    if(muMailHeaderFind(_headers, MU_MAILHDR_SUBJECT, &header) && header.value_count > 0)
     {
-        MU_MailboxGroup * group = muMailboxGroupParse(raw_from.c_str());
-        size_t mailbox_count = muMailboxCount(group);
-        for(size_t i = 0; i < mailbox_count; ++i)
+        // A decoded byte takes up to three bytes of UTF-8 and at least one symbol of the value,
+        // so the value is decoded once; the second call only guards against an unexpected charset.
+        const char * subject = header.values[0];
+        m_subject.resize(std::strlen(subject) * 3);
+        size_t length = muMailHeaderDecodeValue(subject, &m_subject[0], m_subject.size() + 1);
+        if(length > m_subject.size())
         {
-            MU_Mailbox * mailbox = muMailbox(group, i);
-            if(nullptr == mailbox)
-            {
-                muFree(mailbox);
-                continue;
-            }
-            const char * address = muMailboxAddress(mailbox);
-            if(nullptr == address)
-            {
-                muFree(mailbox);
-                continue;
-            }
-            std::string address_str(address);
-            if(!containsAddress(address_str, AddressType::from))
-                m_from_addresses.insert(address_str);
-            muFree(mailbox);
+            m_subject.resize(length);
+            muMailHeaderDecodeValue(subject, &m_subject[0], m_subject.size() + 1);
         }
-        muFree(group);
+        m_subject.resize(length);
+    }
+    m_sending_time = getDateTimeFromHeaders(_headers);
+    collectAddressesFromHeader(_headers, MU_MAILHDR_FROM, m_from_addresses);
+    collectAddressesFromHeader(_headers, MU_MAILHDR_TO, m_to_addresses);
+    collectAddressesFromHeader(_headers, MU_MAILHDR_CC, m_cc_addresses);
+    collectAddressesFromHeader(_headers, MU_MAILHDR_BCC, m_bcc_addresses);
+    if(muMailHeaderFind(_headers, MU_MAILHDR_MESSAGEID, &header) && header.value_count > 0)
+        m_message_id = normalizeMessageId(header.values[0]);
+    for(const std::string & header_name : _indexed_headers)
+        collectHeaderValues(_headers, header_name, m_indexed_headers);
+    muFree(_headers);
+}
+
+void Email::appendFrom(const RawEmail & _raw)
+{
+    for(const std::string & raw_from : _raw.fromAddresses())
+    {
+        forEachAddress(raw_from.c_str(), [this](const char * _address) {
+            std::string address(_address);
+            if(!containsAddress(address, AddressType::from))
+                m_from_addresses.insert(address);
+        });
     }
 }
 
@@ -135,30 +210,11 @@ void Email::appendBcc(const RawEmail & _raw)
 {
     for(const std::string & raw_to: _raw.toAddresses())
     {
-        MU_MailboxGroup * group = muMailboxGroupParse(raw_to.c_str());
-        if(nullptr == group)
-            continue;
-        size_t mailbox_count = muMailboxCount(group);
-        for(size_t i = 0; i < mailbox_count; ++i)
-        {
-            MU_Mailbox * mailbox = muMailbox(group, i);
-            if(nullptr == mailbox)
-            {
-                muFree(mailbox);
-                continue;
-            }
-            const char * address = muMailboxAddress(mailbox);
-            if(nullptr == address)
-            {
-                muFree(mailbox);
-                continue;
-            }
-            std::string address_str(address);
-            if(!containsAddress(address_str, AddressType::to) && !containsAddress(address_str, AddressType::cc))
-                m_bcc_addresses.insert(address_str);
-            muFree(mailbox);
-        }
-        muFree(group);
+        forEachAddress(raw_to.c_str(), [this](const char * _address) {
+            std::string address(_address);
+            if(!containsAddress(address, AddressType::to) && !containsAddress(address, AddressType::cc))
+                m_bcc_addresses.insert(address);
+        });
     }
 }
 
@@ -18,6 +18,7 @@
 #ifndef __MU_STORAGE_EMAIL_H__
 #define __MU_STORAGE_EMAIL_H__
 
+#include <memory>
 #include <vector>
 #include <set>
 #include <string>
@@ -27,8 +28,10 @@
 #include <boost/noncopyable.hpp>
 #include <boost/filesystem.hpp>
 #include <LibMailUnit/Api/Include/Def.h>
+#include <LibMailUnit/Api/Include/Message/MailHeader.h>
 #include <MailUnit/String.h>
 #include <MailUnit/Storage/StorageException.h>
+#include <MailUnit/Storage/BlobStore.h>
 
 namespace MailUnit {
 namespace Storage {
@@ -99,6 +102,8 @@ class Email
 public:
     typedef std::set<std::string, StringLessICompare> AddressSet;
 
+    typedef std::vector<std::pair<std::string, std::string>> HeaderList;
+
     enum class AddressType : short
     {
         from = 0,
@@ -112,7 +117,11 @@ public:
 public:
     Email(uint32_t _id, const boost::filesystem::path & _data_file_path, bool _parse_file);
 
-    Email(const RawEmail & _raw, const boost::filesystem::path & _data_file_path);
+    explicit Email(const RawEmail & _raw,
+        const std::vector<std::string> & _indexed_headers = std::vector<std::string>());
+
+    Email(const boost::filesystem::path & _data_file_path, const std::string & _data,
+        const std::vector<std::string> & _indexed_headers);
 
     Email(const Email &) = default;
 
@@ -146,6 +155,59 @@ public:
         return m_data_file_path;
     }
 
+    boost::uintmax_t dataOffset() const
+    {
+        return m_data_offset;
+    }
+
+    boost::uintmax_t dataLength() const
+    {
+        return m_data_length;
+    }
+
+    BlobEncoding dataEncoding() const
+    {
+        return m_data_encoding;
+    }
+
+    void setDataLocation(const boost::filesystem::path & _data_file_path, boost::uintmax_t _data_offset,
+        boost::uintmax_t _data_length, BlobEncoding _data_encoding)
+    {
+        m_data_file_path = _data_file_path;
+        m_data_offset = _data_offset;
+        m_data_length = _data_length;
+        m_data_encoding = _data_encoding;
+    }
+
+    const boost::filesystem::path & headFilePath() const
+    {
+        return m_head_file_path;
+    }
+
+    boost::uintmax_t headOffset() const
+    {
+        return m_head_offset;
+    }
+
+    boost::uintmax_t headLength() const
+    {
+        return m_head_length;
+    }
+
+    // The header block is read from the head blob and the rest from the data blob.
+    // Messages stored as a whole have no head.
+    void setHeadLocation(const boost::filesystem::path & _head_file_path, boost::uintmax_t _head_offset,
+        boost::uintmax_t _head_length)
+    {
+        m_head_file_path = _head_file_path;
+        m_head_offset = _head_offset;
+        m_head_length = _head_length;
+    }
+
+    std::shared_ptr<std::istream> openData() const;
+
+    std::shared_ptr<std::istream> openEncodedData(uint64_t & _length) const;
+
     std::time_t sendingTime() const
     {
         return m_sending_time;
@@ -156,20 +218,51 @@ public:
         m_sending_time = _date_time;
     }
 
+    const std::string & messageId() const
+    {
+        return m_message_id;
+    }
+
+    boost::uintmax_t size() const
+    {
+        return m_size;
+    }
+
+    void setSize(boost::uintmax_t _size)
+    {
+        m_size = _size;
+    }
+
+    const HeaderList & indexedHeaders() const
+    {
+        return m_indexed_headers;
+    }
+
+    static std::string normalizeMessageId(const std::string & _message_id);
+
 private:
-    void parseHeaders(MU_File _file);
+    void parseHeaders(MU_MailHeaderList * _headers, const std::vector<std::string> & _indexed_headers);
     void appendFrom(const RawEmail & _raw);
     void appendBcc(const RawEmail & _raw);
 
 private:
     uint32_t m_id;
     boost::filesystem::path  m_data_file_path;
+    boost::uintmax_t m_data_offset;
+    boost::uintmax_t m_data_length;
+    BlobEncoding m_data_encoding;
+    boost::filesystem::path m_head_file_path;
+    boost::uintmax_t m_head_offset;
+    boost::uintmax_t m_head_length;
     AddressSet m_from_addresses;
     AddressSet m_to_addresses;
     AddressSet m_cc_addresses;
     AddressSet m_bcc_addresses;
     std::string m_subject;
     std::time_t m_sending_time;
+    std::string m_message_id;
+    boost::uintmax_t m_size;
+    HeaderList m_indexed_headers;
 }; // class Email
 
 
@@ -16,7 +16,13 @@
  ***********************************************************************************************/
 
 #include <sstream>
+#include <fstream>
+#include <unordered_map>
 #include <cstdint>
+#include <thread>
+#include <atomic>
+#include <iterator>
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/filesystem/operations.hpp>
@@ -36,6 +42,14 @@ namespace {
 
 static const MailUnit::OS::PathString tmp_file_ext = MU_PATHSTR(".tmp");
 static const MailUnit::OS::PathString db_filename = MU_PATHSTR("index.db");
+static const MailUnit::OS::PathString data_dirname = MU_PATHSTR("data");
+static const MailUnit::OS::PathString temp_dirname = MU_PATHSTR("tmp");
+static const MailUnit::OS::PathString trash_dir_ext = MU_PATHSTR(".trash");
+static const MailUnit::OS::PathString running_marker_filename = MU_PATHSTR("running");
+static const int schema_version = 2;
+static const size_t data_filename_length = 36;
+static const size_t recovery_batch_size = 5000;
+static const size_t recovery_progress_step = 10000;
 
 namespace TableMessage {
 static const std::string table_name           = "Message";
@@ -43,6 +57,16 @@ static const std::string column_id            = "Id";
 static const std::string column_data_id       = "DataId";
 static const std::string column_subject       = "Subject";
 static const std::string column_sending_time  = "SendingTime";
+static const std::string column_message_id    = "MessageId";
+static const std::string column_size          = "Size";
+static const std::string column_receiving_time = "ReceivingTime";
+static const std::string column_data_offset   = "DataOffset";
+static const std::string column_data_length   = "DataLength";
+static const std::string column_encoding      = "Encoding";
+static const std::string column_data_hash     = "DataHash";
+static const std::string column_head_id       = "HeadId";
+static const std::string column_head_offset   = "HeadOffset";
+static const std::string column_head_length   = "HeadLength";
 } // namespace TableMessage
 
 namespace TableExchange {
@@ -53,6 +77,29 @@ static const std::string column_message = "Message";
 static const std::string column_reason  = "Reason";
 } // namespace TableExchange
 
+namespace TableHeader {
+static const std::string table_name     = "Header";
+static const std::string column_id      = "Id";
+static const std::string column_message = "Message";
+static const std::string column_name    = "Name";
+static const std::string column_value   = "Value";
+} // namespace TableHeader
+
+namespace TableSchemaVersion {
+static const std::string table_name     = "SchemaVersion";
+static const std::string column_version = "Version";
+} // namespace TableSchemaVersion
+
+namespace TableDropSet {
+static const std::string table_name     = "temp.DropSet";
+static const std::string column_id      = "Id";
+static const std::string column_data_id = "DataId";
+static const std::string column_data_offset = "DataOffset";
+static const std::string column_data_length = "DataLength";
+static const std::string column_head_id = "HeadId";
+static const std::string column_head_length = "HeadLength";
+} // namespace TableDropSet
+
 inline std::string prepareSqlValueString(const std::string & _string)
 {
     return boost::replace_all_copy(_string, "'", "''");
@@ -70,8 +117,9 @@ inline std::string formatSqliteError(const std::string & _message, int _error)
 class EdsToSqlMapper : public boost::static_visitor<>
 {
 public:
-    explicit EdsToSqlMapper(std::ostream & _sql) :
-        mr_sql(_sql)
+    EdsToSqlMapper(std::ostream & _sql, const std::vector<std::string> & _indexed_headers) :
+        mr_sql(_sql),
+        mr_indexed_headers(_indexed_headers)
     {
     }
 
@@ -89,9 +137,13 @@ public:
 private:
     void addMailboxCause(Edsl::ConditionBinaryOperator _operator,
         Email::AddressType _address_type, const std::string & _address);
+    void addHeaderCause(const Edsl::BinaryCondition & _bin_condition);
+    void addStringComparison(const std::string & _column, Edsl::ConditionBinaryOperator _operator,
+        const std::string & _value, const char * _cause_name);
 
 private:
     std::ostream & mr_sql;
+    const std::vector<std::string> & mr_indexed_headers;
 }; // class EdsToSqlMapper
 
 void EdsToSqlMapper::mapToSqlWhereClause(const Edsl::ConditionSequence & _sequence)
@@ -114,6 +166,17 @@ void EdsToSqlMapper::mapToSqlWhereClause(const Edsl::ConditionSequence & _sequen
 
 void EdsToSqlMapper::operator ()(const Edsl::BinaryCondition & _bin_condition)
 {
+    if(boost::algorithm::iequals("HEADER", _bin_condition.identifier))
+    {
+        addHeaderCause(_bin_condition);
+        return;
+    }
+    if(_bin_condition.argument.is_initialized())
+    {
+        std::stringstream message;
+        message << '"' << _bin_condition.identifier << "\" does not accept an argument";
+        throw StorageException(message.str());
+    }
     if(boost::algorithm::iequals("ID", _bin_condition.identifier))
     {
         mr_sql << TableMessage::table_name << '.' << TableMessage::column_id <<
@@ -141,28 +204,80 @@ void EdsToSqlMapper::operator ()(const Edsl::BinaryCondition & _bin_condition)
     }
     else if(boost::algorithm::iequals("SUBJECT", _bin_condition.identifier))
     {
-        mr_sql << TableMessage::table_name << '.' << TableMessage::column_subject;
-        if(_bin_condition.operator_ == Edsl::ConditionBinaryOperator::equal)
-        {
-            mr_sql << " = '";
-        }
-        else if(_bin_condition.operator_ == Edsl::ConditionBinaryOperator::not_equal)
-        {
-            mr_sql << " <> '";
-        }
-        else
-        {
-            std::stringstream message;
-            message << '"' << _bin_condition.operator_ << "\" is not supported operator for Subject causes";
-            throw StorageException(message.str());
-        }
-        mr_sql << boost::get<std::string>(_bin_condition.value) << "' ";
+        addStringComparison(TableMessage::table_name + '.' + TableMessage::column_subject,
+            _bin_condition.operator_, boost::get<std::string>(_bin_condition.value), "Subject");
     }
     else if(boost::algorithm::iequals("TIME", _bin_condition.identifier))
     {
         mr_sql << TableMessage::table_name << '.' << TableMessage::column_sending_time <<
             ' ' << _bin_condition.operator_ << ' ' << _bin_condition.value;
     }
+    else if(boost::algorithm::iequals("MESSAGEID", _bin_condition.identifier))
+    {
+        addStringComparison(TableMessage::table_name + '.' + TableMessage::column_message_id,
+            _bin_condition.operator_, Email::normalizeMessageId(boost::get<std::string>(_bin_condition.value)),
+            "MessageId");
+    }
+    else if(boost::algorithm::iequals("SIZE", _bin_condition.identifier))
+    {
+        const int64_t * size = boost::get<int64_t>(&_bin_condition.value);
+        if(nullptr == size)
+            throw StorageException("Size requires a numeric value");
+        mr_sql << TableMessage::table_name << '.' << TableMessage::column_size <<
+            ' ' << _bin_condition.operator_ << ' ' << *size;
+    }
+    else
+    {
+        std::stringstream message;
+        message << "Unknown identifier: \"" << _bin_condition.identifier << '"';
+        throw StorageException(message.str());
+    }
+}
+
+void EdsToSqlMapper::addHeaderCause(const Edsl::BinaryCondition & _bin_condition)
+{
+    if(!_bin_condition.argument.is_initialized() || _bin_condition.argument->empty())
+    {
+        throw StorageException("Header name is required for Header causes");
+    }
+    // Only the configured headers are stored, so any other one would never match.
+    const std::string & header_name = *_bin_condition.argument;
+    if(std::none_of(mr_indexed_headers.begin(), mr_indexed_headers.end(), [&header_name](const std::string & _name) {
+        return boost::algorithm::iequals(header_name, _name);
+    }))
+    {
+        std::stringstream message;
+        message << "Header \"" << header_name << "\" is not indexed";
+        throw StorageException(message.str());
+    }
+    mr_sql << TableMessage::table_name << '.' << TableMessage::column_id << " IN (SELECT " <<
+        TableHeader::table_name << '.' << TableHeader::column_message << " FROM " << TableHeader::table_name <<
+        " WHERE " << TableHeader::table_name << '.' << TableHeader::column_name << " = '" <<
+        prepareSqlValueString(boost::to_lower_copy(*_bin_condition.argument)) << "' AND ";
+    addStringComparison(TableHeader::table_name + '.' + TableHeader::column_value,
+        _bin_condition.operator_, boost::get<std::string>(_bin_condition.value), "Header");
+    mr_sql << ')';
+}
+
+void EdsToSqlMapper::addStringComparison(const std::string & _column, Edsl::ConditionBinaryOperator _operator,
+    const std::string & _value, const char * _cause_name)
+{
+    mr_sql << _column;
+    if(_operator == Edsl::ConditionBinaryOperator::equal)
+    {
+        mr_sql << " = '";
+    }
+    else if(_operator == Edsl::ConditionBinaryOperator::not_equal)
+    {
+        mr_sql << " <> '";
+    }
+    else
+    {
+        std::stringstream message;
+        message << '"' << _operator << "\" is not supported operator for " << _cause_name << " causes";
+        throw StorageException(message.str());
+    }
+    mr_sql << prepareSqlValueString(_value) << "' ";
 }
 
 void EdsToSqlMapper::addMailboxCause(Edsl::ConditionBinaryOperator _operator,
@@ -187,7 +302,7 @@ void EdsToSqlMapper::addMailboxCause(Edsl::ConditionBinaryOperator _operator,
             throw StorageException(message.str());
         }
     }
-    mr_sql << '\'' << _address << "')";
+    mr_sql << '\'' << prepareSqlValueString(_address) << "')";
 }
 
 thread_local static class
@@ -198,11 +313,6 @@ public:
         return uuidToPathString(m_generator());
     }
 
-    inline boost::uuids::uuid genUuid()
-    {
-        return m_generator();
-    }
-
     inline MailUnit::OS::PathString uuidToPathString(const boost::uuids::uuid & _uuid) const
     {
 #ifdef MU_PATHISWIDECHAR
@@ -230,6 +340,44 @@ inline std::string getUtf8Filename(const fs::path & _path)
 #endif
 }
 
+inline std::string makeBlobKey(const std::string & _data_id, uint64_t _offset)
+{
+    return _data_id + ':' + boost::lexical_cast<std::string>(_offset);
+}
+
+inline uint64_t readLittleEndian(const unsigned char * _data, size_t _size)
+{
+    uint64_t value = 0;
+    for(size_t i = 0; i < _size; ++i)
+        value |= static_cast<uint64_t>(_data[i]) << (i * 8);
+    return value;
+}
+
+void loadBlob(const fs::path & _path, uint64_t _offset, uint64_t _length, BlobEncoding _encoding, std::string & _data)
+{
+    std::shared_ptr<std::istream> stream = openBlob(_path, _offset, _length, _encoding);
+    _data.assign(std::istreambuf_iterator<char>(*stream), std::istreambuf_iterator<char>());
+}
+
+// Returns the length of the header block with the empty line that ends it.
+// A message without the empty line is a header block entirely.
+uint64_t findHeadLength(std::istream & _data, uint64_t _size)
+{
+    std::string line;
+    uint64_t length = 0;
+    while(std::getline(_data, line) && !_data.eof())
+    {
+        length += line.size() + 1;
+        if(std::all_of(line.begin(), line.end(), [](char _symbol) {
+            return ' ' == _symbol || '\t' == _symbol || '\r' == _symbol;
+        }))
+        {
+            return length;
+        }
+    }
+    return _size;
+}
+
 inline Email * reverseFindEmail(std::vector<std::unique_ptr<Email>> & _emails, uint32_t _id)
 {
     auto it = std::find_if(_emails.rbegin(), _emails.rend(), [_id](const auto & email) {
@@ -241,22 +389,67 @@ inline Email * reverseFindEmail(std::vector<std::unique_ptr<Email>> & _emails, u
 } // namespace
 
 
-Repository::Repository(const fs::path & _storage_direcotiry) :
-    m_storage_direcotiry(_storage_direcotiry)
+struct Repository::RecoveredEmail
+{
+    std::unique_ptr<Email> email;
+    std::string data_id;
+    std::string data_hash;
+    std::string head_id;
+}; // struct Repository::RecoveredEmail
+
+// Heads are recovered after all of the data files are scanned because their bodies can be anywhere.
+struct Repository::RecoveredBlobs
+{
+    struct Body
+    {
+        BlobLocation location;
+        BlobEncoding encoding;
+        uint64_t size;
+    };
+
+    struct Head
+    {
+        boost::filesystem::path path;
+        BlobLocation location;
+        std::string body_hash;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Body> bodies;
+    std::vector<Head> heads;
+}; // struct Repository::RecoveredBlobs
+
+Repository::Repository(const fs::path & _storage_direcotiry, const Options & _options) :
+    m_storage_direcotiry(_storage_direcotiry),
+    m_data_directory(_storage_direcotiry / data_dirname),
+    m_temp_directory(_storage_direcotiry / temp_dirname),
+    m_options(_options),
+    m_unclean_shutdown(false)
 {
     initStorageDirectory();
+    m_blob_store_ptr = createBlobStore(m_options.blob_layout, m_data_directory,
+        m_deletion_queue, m_options.segment_size);
     std::string db_utf8_filepath = getUtf8Filename(makeNewFileName(db_filename, false));
     int result = sqlite3_open(db_utf8_filepath.c_str(), &mp_sqlite);
     if(SQLITE_OK != result)
     {
         throw StorageException(formatSqliteError("Unable to connect to the SQLite database", result));
     }
-    prepareDatabase();
+    if(prepareDatabase())
+        shardDataFiles();
+    // The write-ahead log lets the integrity check read the database while messages are being stored.
+    // It is enabled after the schema is prepared because the vacuum mode of a new database is set before
+    // anything is written to it.
+    executeSql("PRAGMA journal_mode = WAL;", "Unable to set the SQLite journal mode");
+    if(m_options.recover)
+        recoverIndex();
 }
 
 Repository::~Repository()
 {
     sqlite3_close(mp_sqlite);
+    boost::system::error_code error;
+    fs::remove(makeNewFileName(running_marker_filename, false), error);
 }
 
 void Repository::initStorageDirectory()
@@ -264,6 +457,31 @@ void Repository::initStorageDirectory()
     try
     {
         fs::create_directories(m_storage_direcotiry);
+        bool new_data_directory = !fs::exists(m_data_directory);
+        fs::create_directories(m_data_directory);
+        fs::path running_marker = makeNewFileName(running_marker_filename, false);
+        m_unclean_shutdown = fs::exists(running_marker);
+        std::ofstream(running_marker.string());
+        if(fs::exists(m_temp_directory))
+        {
+            // Nothing can be receiving yet, so every temporary file is left by a previous process.
+            fs::rename(m_temp_directory, makeNewFileName(generateUniqueFilename() + trash_dir_ext, false));
+        }
+        fs::create_directories(m_temp_directory);
+        for(fs::directory_iterator it(m_storage_direcotiry), end; it != end; ++it)
+        {
+            const fs::path & path = it->path();
+            if((fs::is_directory(path) && path.extension() == trash_dir_ext) ||
+                (fs::is_regular_file(path) && path.extension() == tmp_file_ext))
+            {
+                m_deletion_queue.enqueue(path);
+            }
+            else if(new_data_directory && fs::is_regular_file(path) &&
+                !path.has_extension() && path.filename().native().size() == data_filename_length)
+            {
+                fs::rename(path, m_data_directory / path.filename());
+            }
+        }
     }
     catch(const fs::filesystem_error & error)
     {
@@ -277,18 +495,54 @@ void Repository::initStorageDirectory()
 
 boost::filesystem::path Repository::makeNewFileName(const MailUnit::OS::PathString & _base, bool _temp)
 {
-    return m_storage_direcotiry / boost::filesystem::path(_temp ? _base + tmp_file_ext : _base);
+    return _temp ?
+        m_temp_directory / boost::filesystem::path(_base + tmp_file_ext) :
+        m_storage_direcotiry / boost::filesystem::path(_base);
 }
 
-void Repository::prepareDatabase()
+void Repository::shardDataFiles()
 {
+    try
+    {
+        size_t count = m_blob_store_ptr->shardDataFiles();
+        if(count > 0)
+        {
+            LOG_INFO << "Data files have been moved to the sharded layout: " << count;
+        }
+    }
+    catch(const fs::filesystem_error & error)
+    {
+        std::stringstream message;
+        message << "An error occurred during a data files migration." << std::endl <<
+                   "Path: " << error.path1() << std::endl <<
+                   "Error: " << error.what();
+        throw(StorageException(message.str()));
+    }
+}
+
+
+bool Repository::prepareDatabase()
+{
+    if(readSchemaVersion() == schema_version)
+        return false;
     std::stringstream sql;
     sql <<
+        "PRAGMA auto_vacuum = INCREMENTAL;\n" <<
         "CREATE TABLE IF NOT EXISTS " << TableMessage::table_name << "(\n" <<
         TableMessage::column_id <<  " INTEGER PRIMARY KEY AUTOINCREMENT,\n" <<
         TableMessage::column_data_id << " VARCHAR(36),\n" <<
         TableMessage::column_sending_time << " INTEGER,\n" <<
-        TableMessage::column_subject << " TEXT\n);\n" <<
+        TableMessage::column_subject << " TEXT,\n" <<
+        TableMessage::column_message_id << " TEXT,\n" <<
+        TableMessage::column_size << " INTEGER,\n" <<
+        TableMessage::column_receiving_time << " INTEGER,\n" <<
+        TableMessage::column_data_offset << " INTEGER,\n" <<
+        TableMessage::column_data_length << " INTEGER,\n" <<
+        TableMessage::column_encoding << " INTEGER,\n" <<
+        TableMessage::column_data_hash << " VARCHAR(64),\n" <<
+        TableMessage::column_head_id << " VARCHAR(36),\n" <<
+        TableMessage::column_head_offset << " INTEGER,\n" <<
+        TableMessage::column_head_length << " INTEGER\n);\n" <<
 
         "CREATE TABLE IF NOT EXISTS " << TableExchange::table_name << "(\n" <<
         TableExchange::column_id << " INTEGER PRIMARY KEY AUTOINCREMENT,\n" <<
@@ -298,22 +552,484 @@ void Repository::prepareDatabase()
         "FOREIGN KEY(" << TableExchange::column_message << ") REFERENCES " <<
         TableMessage::table_name << "(" << TableMessage::column_id << ")\n);\n" <<
 
+        "CREATE TABLE IF NOT EXISTS " << TableHeader::table_name << "(\n" <<
+        TableHeader::column_id << " INTEGER PRIMARY KEY AUTOINCREMENT,\n" <<
+        TableHeader::column_message << " INTEGER,\n" <<
+        TableHeader::column_name << " VARCHAR(250),\n" <<
+        TableHeader::column_value << " TEXT,\n" <<
+        "FOREIGN KEY(" << TableHeader::column_message << ") REFERENCES " <<
+        TableMessage::table_name << "(" << TableMessage::column_id << ")\n);";
+    executeSql(sql.str(), "Unable to initialize SQLite database");
+    upgradeDatabase();
+    enableIncrementalVacuum();
+    sql.str(std::string());
+    sql <<
         "CREATE INDEX IF NOT EXISTS iMessageSubject ON " << TableMessage::table_name <<
         "(" << TableMessage::column_subject << ");\n" <<
         "CREATE INDEX IF NOT EXISTS iMessageTime ON " << TableMessage::table_name <<
         "(" << TableMessage::column_sending_time << ");\n" <<
+        "CREATE INDEX IF NOT EXISTS iMessageMessageId ON " << TableMessage::table_name <<
+        "(" << TableMessage::column_message_id << ");\n" <<
+        "CREATE INDEX IF NOT EXISTS iMessageSize ON " << TableMessage::table_name <<
+        "(" << TableMessage::column_size << ");\n" <<
+        "CREATE INDEX IF NOT EXISTS iMessageDataHash ON " << TableMessage::table_name <<
+        "(" << TableMessage::column_data_hash << ");\n" <<
+        "CREATE INDEX IF NOT EXISTS iMessageData ON " << TableMessage::table_name <<
+        "(" << TableMessage::column_data_id << ", " << TableMessage::column_data_offset << ");\n" <<
+        "CREATE INDEX IF NOT EXISTS iMessageHead ON " << TableMessage::table_name <<
+        "(" << TableMessage::column_head_id << ", " << TableMessage::column_head_offset << ");\n" <<
         "CREATE INDEX IF NOT EXISTS iExchangeMailbox ON " << TableExchange::table_name <<
         "(" << TableExchange::column_mailbox << ");\n" <<
         "CREATE INDEX IF NOT EXISTS iExchangeMessage ON " << TableExchange::table_name <<
-        "(" << TableExchange::column_message << ");";
+        "(" << TableExchange::column_message << ");\n" <<
+        "CREATE INDEX IF NOT EXISTS iHeaderNameValue ON " << TableHeader::table_name <<
+        "(" << TableHeader::column_name << ", " << TableHeader::column_value << ");\n" <<
+        "CREATE INDEX IF NOT EXISTS iHeaderMessage ON " << TableHeader::table_name <<
+        "(" << TableHeader::column_message << ");\n" <<
+        "CREATE TABLE IF NOT EXISTS " << TableSchemaVersion::table_name << "(" <<
+        TableSchemaVersion::column_version << " INTEGER);\n" <<
+        "DELETE FROM " << TableSchemaVersion::table_name << ";\n" <<
+        "INSERT INTO " << TableSchemaVersion::table_name << " (" << TableSchemaVersion::column_version <<
+        ") VALUES (" << schema_version << ");";
+    executeSql(sql.str(), "Unable to initialize SQLite database");
+    LOG_INFO << "Database schema has been updated to version " << schema_version;
+    return true;
+}
+
+// The auto_vacuum mode of an existing database changes only after a full VACUUM,
+// so databases created before the retention support are rebuilt once.
+void Repository::enableIncrementalVacuum()
+{
+    static const int incremental_vacuum = 2;
+    int mode = incremental_vacuum;
+    querySql("PRAGMA auto_vacuum;", "Unable to read the SQLite vacuum mode",
+        [&mode](char ** _values) {
+            if(nullptr != _values[0])
+                mode = boost::lexical_cast<int>(_values[0]);
+        });
+    if(incremental_vacuum == mode)
+        return;
+    executeSql("PRAGMA auto_vacuum = INCREMENTAL;\nVACUUM;", "Unable to enable the incremental vacuum");
+    LOG_INFO << "Database has been rebuilt to enable the incremental vacuum";
+}
+
+int Repository::readSchemaVersion()
+{
+    int version = 0;
+    std::stringstream sql;
+    sql << "SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name = '" <<
+        TableSchemaVersion::table_name << "';";
+    querySql(sql.str(), "Unable to read the database schema",
+        [&version](char ** _values) {
+            version = boost::lexical_cast<int>(_values[0]);
+        });
+    if(0 == version)
+        return 0;
+    version = 0;
+    sql.str(std::string());
+    sql << "SELECT MAX(" << TableSchemaVersion::column_version << ") FROM " << TableSchemaVersion::table_name << ";";
+    querySql(sql.str(), "Unable to read the database schema version",
+        [&version](char ** _values) {
+            if(nullptr != _values[0])
+                version = boost::lexical_cast<int>(_values[0]);
+        });
+    return version;
+}
+
+void Repository::verifyStorage()
+{
+    if(!m_unclean_shutdown)
+        return;
+    // The check reads through its own connection, so it holds neither the database mutex
+    // nor the stores that wait for it.
+    std::string db_utf8_filepath = getUtf8Filename(makeNewFileName(db_filename, false));
+    sqlite3 * connection = nullptr;
+    int result = sqlite3_open_v2(db_utf8_filepath.c_str(), &connection, SQLITE_OPEN_READONLY, nullptr);
+    if(SQLITE_OK != result)
+    {
+        sqlite3_close(connection);
+        throw StorageException(formatSqliteError("Unable to connect to the SQLite database", result));
+    }
+    std::vector<std::string> problems;
+    try
+    {
+        querySql(connection, "PRAGMA quick_check;", "Unable to check the database integrity",
+            [&problems](char ** _values) {
+                if(nullptr != _values[0])
+                    problems.push_back(_values[0]);
+            });
+    }
+    catch(...)
+    {
+        sqlite3_close(connection);
+        throw;
+    }
+    sqlite3_close(connection);
+    m_unclean_shutdown = false;
+    if(1 == problems.size() && "ok" == problems.front())
+    {
+        LOG_INFO << "Database integrity has been verified after an unclean shutdown";
+        return;
+    }
+    for(const std::string & problem : problems)
+    {
+        LOG_ERROR << "Database integrity problem: " << problem;
+    }
+    LOG_ERROR << "The database index has to be recovered from the data files";
+}
+
+void Repository::upgradeDatabase()
+{
+    const struct
+    {
+        std::string name;
+        const char * type;
+        const char * initializer;
+    } message_columns[] = {
+        { TableMessage::column_message_id, "TEXT", nullptr },
+        { TableMessage::column_size, "INTEGER", nullptr },
+        { TableMessage::column_receiving_time, "INTEGER", TableMessage::column_sending_time.c_str() },
+        { TableMessage::column_data_offset, "INTEGER", "0" },
+        { TableMessage::column_data_length, "INTEGER", TableMessage::column_size.c_str() },
+        { TableMessage::column_encoding, "INTEGER", "0" },
+        { TableMessage::column_data_hash, "VARCHAR(64)", nullptr },
+        { TableMessage::column_head_id, "VARCHAR(36)", nullptr },
+        { TableMessage::column_head_offset, "INTEGER", nullptr },
+        { TableMessage::column_head_length, "INTEGER", nullptr }
+    };
+    for(const auto & column : message_columns)
+    {
+        if(columnExists(TableMessage::table_name, column.name))
+            continue;
+        std::stringstream sql;
+        sql << "ALTER TABLE " << TableMessage::table_name << " ADD COLUMN " <<
+            column.name << ' ' << column.type << ';';
+        if(nullptr != column.initializer)
+        {
+            sql << "\nUPDATE " << TableMessage::table_name << " SET " <<
+                column.name << " = " << column.initializer << ';';
+        }
+        executeSql(sql.str(), "Unable to upgrade SQLite database");
+        LOG_INFO << "Column " << column.name << " has been added to the " << TableMessage::table_name << " table";
+    }
+}
+
+void Repository::recoverIndex()
+{
+    std::unordered_set<std::string> indexed_blobs;
+    std::stringstream sql;
+    sql << "SELECT DISTINCT " << TableMessage::column_data_id << ", " << TableMessage::column_data_offset <<
+        " FROM " << TableMessage::table_name << " UNION SELECT " << TableMessage::column_head_id << ", " <<
+        TableMessage::column_head_offset << " - " << BlobStore::head_reference_size << " FROM " <<
+        TableMessage::table_name << " WHERE " << TableMessage::column_head_id << " IS NOT NULL;";
+    querySql(sql.str(), "Unable to select indexed data files",
+        [&indexed_blobs](char ** _values) {
+            if(nullptr != _values[0])
+                indexed_blobs.insert(makeBlobKey(_values[0],
+                    nullptr == _values[1] ? 0 : boost::lexical_cast<uint64_t>(_values[1])));
+        });
+    std::vector<fs::path> paths;
+    for(fs::recursive_directory_iterator it(m_data_directory), end; it != end; ++it)
+    {
+        const fs::path & path = it->path();
+        if(!fs::is_regular_file(path))
+            continue;
+        std::string data_id = getUtf8Filename(path.filename());
+        BlobKind kind;
+        BlobEncoding encoding;
+        if(BlobStore::isSegment(data_id) ||
+            (BlobStore::parseDataId(data_id, kind, encoding) &&
+             indexed_blobs.end() == indexed_blobs.find(makeBlobKey(data_id, 0))))
+        {
+            paths.push_back(path);
+        }
+    }
+    LOG_INFO << "Index recovery started, data files to scan: " << paths.size();
+    RecoveredBlobs blobs;
+    std::atomic<size_t> scanned_count(0);
+    std::atomic<size_t> recovered_count(0);
+    typedef std::function<void(size_t, std::vector<RecoveredEmail> &)> RecoverAction;
+    auto run_workers = [this](size_t _count, const RecoverAction & _recover) {
+        std::atomic<size_t> next_index(0);
+        auto worker = [&]() {
+            std::vector<RecoveredEmail> batch;
+            for(size_t index = next_index++; index < _count; index = next_index++)
+            {
+                _recover(index, batch);
+                if(batch.size() >= recovery_batch_size)
+                {
+                    try
+                    {
+                        insertRecoveredEmails(batch);
+                    }
+                    catch(const std::exception & error)
+                    {
+                        LOG_ERROR << "Unable to store recovered messages: " << error.what();
+                    }
+                }
+            }
+            try
+            {
+                insertRecoveredEmails(batch);
+            }
+            catch(const std::exception & error)
+            {
+                LOG_ERROR << "Unable to store recovered messages: " << error.what();
+            }
+        };
+        unsigned int thread_count = m_options.recovery_threads > 0 ?
+            m_options.recovery_threads : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::thread> threads;
+        for(unsigned int i = 1; i < thread_count && i < _count; ++i)
+        {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for(std::thread & thread : threads)
+        {
+            thread.join();
+        }
+    };
+    run_workers(paths.size(), [&](size_t _index, std::vector<RecoveredEmail> & _batch) {
+        const fs::path & path = paths[_index];
+        try
+        {
+            size_t batch_size = _batch.size();
+            if(BlobStore::isSegment(getUtf8Filename(path.filename())))
+                recoverSegment(path, indexed_blobs, blobs, _batch);
+            else
+                recoverDataFile(path, blobs, _batch);
+            recovered_count += _batch.size() - batch_size;
+        }
+        catch(const std::exception & error)
+        {
+            LOG_WARN << "Unable to recover data file " << path << ": " << error.what();
+        }
+        size_t scanned = ++scanned_count;
+        if(scanned % recovery_progress_step == 0)
+        {
+            LOG_INFO << "Index recovery progress: " << scanned << " of " << paths.size() <<
+                " data files scanned, messages recovered: " << recovered_count.load();
+        }
+    });
+    run_workers(blobs.heads.size(), [&](size_t _index, std::vector<RecoveredEmail> & _batch) {
+        try
+        {
+            size_t batch_size = _batch.size();
+            recoverHead(_index, blobs, _batch);
+            recovered_count += _batch.size() - batch_size;
+        }
+        catch(const std::exception & error)
+        {
+            LOG_WARN << "Unable to recover message head " << blobs.heads[_index].path << ": " << error.what();
+        }
+    });
+    // A body is left without a head when the server stops between storing them.
+    for(const RecoveredBlobs::Head & head : blobs.heads)
+    {
+        blobs.bodies.erase(head.body_hash);
+    }
+    std::vector<std::string> orphan_bodies;
+    for(const auto & body : blobs.bodies)
+    {
+        orphan_bodies.push_back(body.second.location.data_id);
+    }
+    m_blob_store_ptr->release(orphan_bodies);
+    LOG_INFO << "Index recovery finished, messages recovered: " << recovered_count.load() <<
+        ", orphan bodies: " << orphan_bodies.size();
+}
+
+void Repository::recoverDataFile(const fs::path & _path, RecoveredBlobs & _blobs, std::vector<RecoveredEmail> & _batch)
+{
+    std::string data_id = getUtf8Filename(_path.filename());
+    BlobKind kind;
+    BlobEncoding encoding;
+    if(!BlobStore::parseDataId(data_id, kind, encoding))
+        throw StorageException("Unknown data file");
+    BlobLocation location = { data_id, 0, fs::file_size(_path) };
+    recoverBlob(_path, location, kind, encoding, _blobs, _batch);
+}
+
+void Repository::recoverSegment(const fs::path & _path, const std::unordered_set<std::string> & _indexed_blobs,
+    RecoveredBlobs & _blobs, std::vector<RecoveredEmail> & _batch)
+{
+    std::string segment = getUtf8Filename(_path.filename());
+    uint64_t segment_size = fs::file_size(_path);
+    std::ifstream stream(_path.string(), std::ios_base::binary);
+    if(!stream.is_open())
+        throw StorageException("Unable to open a segment file");
+    unsigned char header[BlobStore::segment_record_header_size];
+    for(uint64_t position = 0; position + sizeof(header) <= segment_size;)
+    {
+        stream.seekg(static_cast<std::streamoff>(position));
+        if(!stream.read(reinterpret_cast<char *>(header), sizeof(header)))
+            break;
+        uint64_t offset = position + sizeof(header);
+        uint32_t signature = static_cast<uint32_t>(readLittleEndian(header, sizeof(uint32_t)));
+        uint64_t length = readLittleEndian(header + sizeof(uint32_t), sizeof(uint64_t));
+        BlobKind kind;
+        BlobEncoding encoding;
+        if(!BlobStore::parseRecordSignature(signature, kind, encoding) || offset + length > segment_size)
+        {
+            LOG_WARN << "Segment " << segment << " has an incomplete record at " << position;
+            break;
+        }
+        if(_indexed_blobs.end() == _indexed_blobs.find(makeBlobKey(segment, offset)))
+        {
+            BlobLocation location = { segment, offset, length };
+            recoverBlob(_path, location, kind, encoding, _blobs, _batch);
+        }
+        position = offset + length;
+    }
+}
+
+void Repository::recoverBlob(const fs::path & _path, const BlobLocation & _location, BlobKind _kind,
+    BlobEncoding _encoding, RecoveredBlobs & _blobs, std::vector<RecoveredEmail> & _batch)
+{
+    std::string data;
+    if(BlobKind::head == _kind)
+    {
+        if(_location.length < BlobStore::head_reference_size)
+            throw StorageException("A message head is too short");
+        loadBlob(_path, _location.offset, BlobStore::head_reference_size, BlobEncoding::identity, data);
+        BlobLocation location = {
+            _location.data_id,
+            _location.offset + BlobStore::head_reference_size,
+            _location.length - BlobStore::head_reference_size
+        };
+        std::lock_guard<std::mutex> lock(_blobs.mutex);
+        _blobs.heads.push_back({ _path, location, data });
+        return;
+    }
+    loadBlob(_path, _location.offset, _location.length, _encoding, data);
+    std::istringstream data_stream(data);
+    std::string data_hash = hashBlob(data_stream);
+    if(BlobKind::body == _kind)
+    {
+        std::lock_guard<std::mutex> lock(_blobs.mutex);
+        _blobs.bodies.insert(std::make_pair(data_hash, RecoveredBlobs::Body { _location, _encoding, data.size() }));
+        return;
+    }
+    std::unique_ptr<Email> email = std::make_unique<Email>(_path, data, m_options.indexed_headers);
+    email->setDataLocation(_path, _location.offset, _location.length, _encoding);
+    _batch.push_back({ std::move(email), _location.data_id, data_hash, std::string() });
+}
+
+void Repository::recoverHead(size_t _index, RecoveredBlobs & _blobs, std::vector<RecoveredEmail> & _batch)
+{
+    const RecoveredBlobs::Head & head = _blobs.heads[_index];
+    RecoveredBlobs::Body body;
+    auto body_it = _blobs.bodies.find(head.body_hash);
+    if(_blobs.bodies.end() != body_it)
+    {
+        body = body_it->second;
+    }
+    else
+    {
+        // The body is shared with a message that is still indexed.
+        std::lock_guard<std::mutex> lock(m_database_mutex);
+        if(!findBlob(head.body_hash, body.location, body.encoding, body.size))
+            throw StorageException("Message body is not found");
+    }
+    std::string data;
+    loadBlob(head.path, head.location.offset, head.location.length, BlobEncoding::identity, data);
+    std::unique_ptr<Email> email = std::make_unique<Email>(head.path, data, m_options.indexed_headers);
+    email->setHeadLocation(head.path, head.location.offset, head.location.length);
+    email->setDataLocation(m_blob_store_ptr->dataFilePath(body.location.data_id), body.location.offset,
+        body.location.length, body.encoding);
+    email->setSize(head.location.length + body.size);
+    _batch.push_back({ std::move(email), body.location.data_id, head.body_hash, head.location.data_id });
+}
+
+void Repository::insertRecoveredEmails(std::vector<RecoveredEmail> & _batch)
+{
+    if(_batch.empty())
+        return;
+    std::lock_guard<std::mutex> lock(m_database_mutex);
+    try
+    {
+        executeSql("BEGIN TRANSACTION;", "Unable to begin a recovery transaction");
+        for(const RecoveredEmail & recovered : _batch)
+        {
+            uint32_t message_id = insertMessage(*recovered.email, recovered.data_id, recovered.data_hash,
+                recovered.head_id);
+            insertExchange(*recovered.email, message_id);
+            insertHeaders(*recovered.email, message_id);
+        }
+        executeSql("COMMIT;", "Unable to commit a recovery transaction");
+    }
+    catch(...)
+    {
+        _batch.clear();
+        if(0 == sqlite3_get_autocommit(mp_sqlite))
+            sqlite3_exec(mp_sqlite, "ROLLBACK;", nullptr, nullptr, nullptr);
+        throw;
+    }
+    _batch.clear();
+}
+
+bool Repository::columnExists(const std::string & _table, const std::string & _column)
+{
+    struct CallbackArgs
+    {
+        const std::string * column;
+        bool exists;
+    } callback_args = { &_column, false };
+    std::string sql = "PRAGMA table_info(" + _table + ");";
     char * error = nullptr;
-    int insert_result = sqlite3_exec(mp_sqlite, sql.str().c_str(), nullptr, nullptr, &error);
-    if(SQLITE_OK != insert_result)
+    int pragma_result = sqlite3_exec(mp_sqlite, sql.c_str(),
+        [](void * pargs, int count, char ** values, char **) {
+            CallbackArgs * args = static_cast<CallbackArgs *>(pargs);
+            if(count > 1 && nullptr != values[1] && boost::algorithm::iequals(*args->column, values[1]))
+                args->exists = true;
+            return 0;
+        }, &callback_args, &error);
+    if(SQLITE_OK != pragma_result)
     {
-        std::string er_string("Unable to initialize SQLite database:\n");
+        std::string er_string("Unable to read a table schema:\n");
         er_string += error;
         sqlite3_free(error);
-        throw StorageException(formatSqliteError(er_string, insert_result));
+        throw StorageException(formatSqliteError(er_string, pragma_result));
+    }
+    return callback_args.exists;
+}
+
+void Repository::querySql(const std::string & _sql, const std::string & _error_message,
+    const std::function<void(char **)> & _row_callback)
+{
+    querySql(mp_sqlite, _sql, _error_message, _row_callback);
+}
+
+void Repository::querySql(sqlite3 * _connection, const std::string & _sql, const std::string & _error_message,
+    const std::function<void(char **)> & _row_callback)
+{
+    char * error = nullptr;
+    int sql_result = sqlite3_exec(_connection, _sql.c_str(),
+        [](void * pcallback, int, char ** values, char **) {
+            (*static_cast<const std::function<void(char **)> *>(pcallback))(values);
+            return 0;
+        }, const_cast<std::function<void(char **)> *>(&_row_callback), &error);
+    if(SQLITE_OK != sql_result)
+    {
+        std::string er_string(_error_message);
+        er_string += ":\n";
+        er_string += error;
+        sqlite3_free(error);
+        throw StorageException(formatSqliteError(er_string, sql_result));
+    }
+}
+
+void Repository::executeSql(const std::string & _sql, const std::string & _error_message)
+{
+    char * error = nullptr;
+    int sql_result = sqlite3_exec(mp_sqlite, _sql.c_str(), nullptr, nullptr, &error);
+    if(SQLITE_OK != sql_result)
+    {
+        std::string er_string(_error_message);
+        er_string += ":\n";
+        er_string += error;
+        sqlite3_free(error);
+        throw StorageException(formatSqliteError(er_string, sql_result));
     }
 }
 
@@ -325,23 +1041,132 @@ std::unique_ptr<RawEmail> Repository::createRawEmail()
 uint32_t Repository::storeEmail(RawEmail & _raw_email)
 {
     _raw_email.flush();
-    boost::uuids::uuid data_id = unique_id_generator.genUuid();
-    fs::path data_filepath = makeNewFileName(unique_id_generator.uuidToPathString(data_id), false);
-    boost::scoped_ptr<Email> email(new Email(_raw_email, data_filepath));
-    uint32_t message_id = insertMessage(*email, boost::uuids::to_string(data_id));
+    boost::scoped_ptr<Email> email(new Email(_raw_email, m_options.indexed_headers));
+    // Copies of a message sent to several recipients differ in the headers only,
+    // so the body is stored apart and shared by its hash.
+    uint64_t head_length;
+    std::string body_hash;
+    {
+        std::ifstream data(_raw_email.dataFilePath().string(), std::ios_base::binary);
+        if(!data.is_open())
+            throw StorageException("Unable to open a raw e-mail file");
+        head_length = findHeadLength(data, email->size());
+        data.clear();
+        data.seekg(static_cast<std::streamoff>(head_length));
+        body_hash = hashBlob(data);
+    }
+    std::shared_lock<std::shared_timed_mutex> generation_lock(m_generation_mutex);
+    BlobLocation head_location = storeHead(_raw_email, head_length, body_hash);
+    BlobLocation location;
+    BlobEncoding encoding = BlobEncoding::identity;
+    uint64_t body_size;
+    // The lookup and the insertion of a message that shares a blob must not be separated,
+    // otherwise the last reference to the blob can be dropped in between.
+    std::unique_lock<std::mutex> lock(m_database_mutex);
+    if(findBlob(body_hash, location, encoding, body_size))
+    {
+        LOG_DEBUG << "Message body is shared with an existing blob: " << location.data_id;
+    }
+    else
+    {
+        lock.unlock();
+        location = storeBlob(_raw_email, head_length, email->size() - head_length, encoding);
+        lock.lock();
+    }
+    email->setHeadLocation(m_blob_store_ptr->dataFilePath(head_location.data_id),
+        head_location.offset + BlobStore::head_reference_size, head_length);
+    email->setDataLocation(m_blob_store_ptr->dataFilePath(location.data_id), location.offset,
+        location.length, encoding);
+    uint32_t message_id = insertMessage(*email, location.data_id, body_hash, head_location.data_id);
     insertExchange(*email, message_id);
+    insertHeaders(*email, message_id);
     LOG_DEBUG << "Message has been stored: " << message_id;
     return message_id;
 }
 
-uint32_t Repository::insertMessage(const Email & _email, const std::string & _data_id)
+bool Repository::findBlob(const std::string & _data_hash, BlobLocation & _location, BlobEncoding & _encoding,
+    uint64_t & _size)
+{
+    bool found = false;
+    std::stringstream sql;
+    sql << "SELECT " << TableMessage::column_data_id << ", " << TableMessage::column_data_offset << ", " <<
+        TableMessage::column_data_length << ", " << TableMessage::column_encoding << ", " <<
+        TableMessage::column_size << " - IFNULL(" << TableMessage::column_head_length << ", 0)" <<
+        " FROM " << TableMessage::table_name << " WHERE " << TableMessage::column_data_hash << " = '" <<
+        prepareSqlValueString(_data_hash) << "' LIMIT 1;";
+    querySql(sql.str(), "Unable to find a message blob",
+        [&](char ** _values) {
+            if(nullptr == _values[0] || nullptr == _values[1] || nullptr == _values[2])
+                return;
+            _location.data_id = _values[0];
+            _location.offset = boost::lexical_cast<uint64_t>(_values[1]);
+            _location.length = boost::lexical_cast<uint64_t>(_values[2]);
+            _encoding = nullptr == _values[3] ? BlobEncoding::identity :
+                static_cast<BlobEncoding>(boost::lexical_cast<int>(_values[3]));
+            _size = nullptr == _values[4] ? _location.length : boost::lexical_cast<uint64_t>(_values[4]);
+            found = true;
+        });
+    return found;
+}
+
+BlobLocation Repository::storeHead(RawEmail & _raw_email, uint64_t _length, const std::string & _body_hash)
+{
+    std::ifstream data(_raw_email.dataFilePath().string(), std::ios_base::binary);
+    if(!data.is_open())
+        throw StorageException("Unable to open a raw e-mail file");
+    std::string head(_body_hash);
+    head.resize(BlobStore::head_reference_size + _length);
+    data.read(&head[BlobStore::head_reference_size], static_cast<std::streamsize>(_length));
+    std::istringstream head_stream(head);
+    return m_blob_store_ptr->store(head_stream, head.size(), BlobEncoding::identity, BlobKind::head);
+}
+
+BlobLocation Repository::storeBlob(RawEmail & _raw_email, uint64_t _offset, uint64_t _size, BlobEncoding & _encoding)
+{
+    std::ifstream data(_raw_email.dataFilePath().string(), std::ios_base::binary);
+    if(!data.is_open())
+        throw StorageException("Unable to open a raw e-mail file");
+    data.seekg(static_cast<std::streamoff>(_offset));
+    _encoding = BlobEncoding::identity;
+    if(m_options.compression_level > 0)
+    {
+        RawEmail compressed_email(makeNewFileName(generateUniqueFilename(), true));
+        encodeBlob(data, compressed_email.data(), BlobEncoding::zlib, m_options.compression_level);
+        compressed_email.flush();
+        boost::uintmax_t compressed_size = fs::file_size(compressed_email.dataFilePath());
+        if(compressed_size < _size)
+        {
+            std::ifstream compressed_data(compressed_email.dataFilePath().string(), std::ios_base::binary);
+            _encoding = BlobEncoding::zlib;
+            return m_blob_store_ptr->store(compressed_data, compressed_size, _encoding, BlobKind::body);
+        }
+        data.clear();
+        data.seekg(static_cast<std::streamoff>(_offset));
+    }
+    return m_blob_store_ptr->store(data, _size, _encoding, BlobKind::body);
+}
+
+uint32_t Repository::insertMessage(const Email & _email, const std::string & _data_id,
+    const std::string & _data_hash, const std::string & _head_id)
 {
     std::stringstream sql;
     sql << "INSERT INTO " << TableMessage::table_name << " (" <<
         TableMessage::column_subject << ", " << TableMessage::column_data_id << ", " <<
-        TableMessage::column_sending_time << ") VALUES ('" <<
-        prepareSqlValueString(_email.subject()) << "','" << _data_id << "', " << _email.sendingTime() <<
-        ");\nSELECT last_insert_rowid();";
+        TableMessage::column_sending_time << ", " << TableMessage::column_message_id << ", " <<
+        TableMessage::column_size << ", " << TableMessage::column_receiving_time << ", " <<
+        TableMessage::column_data_offset << ", " << TableMessage::column_data_length << ", " <<
+        TableMessage::column_encoding << ", " << TableMessage::column_data_hash << ", " <<
+        TableMessage::column_head_id << ", " << TableMessage::column_head_offset << ", " <<
+        TableMessage::column_head_length << ") VALUES ('" <<
+        prepareSqlValueString(_email.subject()) << "','" << _data_id << "', " << _email.sendingTime() << ", '" <<
+        prepareSqlValueString(_email.messageId()) << "', " << _email.size() << ", " << std::time(nullptr) <<
+        ", " << _email.dataOffset() << ", " << _email.dataLength() << ", " <<
+        static_cast<int>(_email.dataEncoding()) << ", '" << prepareSqlValueString(_data_hash) << "', ";
+    if(_head_id.empty())
+        sql << "NULL, NULL, NULL";
+    else
+        sql << '\'' << _head_id << "', " << _email.headOffset() << ", " << _email.headLength();
+    sql << ");\nSELECT last_insert_rowid();";
     uint32_t message_id;
     char * error = nullptr;
     int insert_result = sqlite3_exec(mp_sqlite, sql.str().c_str(),
@@ -395,6 +1220,24 @@ void Repository::insertExchange(const Email & _email, uint32_t _message_id)
     }
 }
 
+void Repository::insertHeaders(const Email & _email, uint32_t _message_id)
+{
+    const Email::HeaderList & headers = _email.indexedHeaders();
+    if(headers.empty())
+        return;
+    std::stringstream sql;
+    for(const auto & header : headers)
+    {
+        sql << "INSERT INTO " << TableHeader::table_name << " (" <<
+            TableHeader::column_message << ", " <<
+            TableHeader::column_name << ", " <<
+            TableHeader::column_value << ") VALUES (" <<
+            _message_id << ", '" << prepareSqlValueString(header.first) << "', '" <<
+            prepareSqlValueString(header.second) << "');\n";
+    }
+    executeSql(sql.str(), "Unable to store a header object");
+}
+
 std::shared_ptr<QueryResult> Repository::executeQuery(const std::string & _edsl_query)
 {
     std::string query = boost::algorithm::trim_copy(_edsl_query);
@@ -422,7 +1265,14 @@ void Repository::findEmails(const Edsl::Expression & _expression, std::vector<st
            TableMessage::table_name  << '.' << TableMessage::column_data_id  << ',' <<
            TableMessage::table_name  << '.' << TableMessage::column_subject  << ',' <<
            TableExchange::table_name << '.' << TableExchange::column_reason  << ',' <<
-           TableExchange::table_name << '.' << TableExchange::column_mailbox <<
+           TableExchange::table_name << '.' << TableExchange::column_mailbox << ',' <<
+           TableMessage::table_name  << '.' << TableMessage::column_data_offset << ',' <<
+           TableMessage::table_name  << '.' << TableMessage::column_size << ',' <<
+           TableMessage::table_name  << '.' << TableMessage::column_data_length << ',' <<
+           TableMessage::table_name  << '.' << TableMessage::column_encoding << ',' <<
+           TableMessage::table_name  << '.' << TableMessage::column_head_id << ',' <<
+           TableMessage::table_name  << '.' << TableMessage::column_head_offset << ',' <<
+           TableMessage::table_name  << '.' << TableMessage::column_head_length <<
            " FROM " << TableMessage::table_name <<
            " INNER JOIN " <<TableExchange::table_name << " ON " <<
            TableExchange::table_name << '.' << TableExchange::column_message << '=' <<
@@ -434,6 +1284,7 @@ void Repository::findEmails(const Edsl::Expression & _expression, std::vector<st
         std::vector<std::unique_ptr<Email>> * result;
     } callback_args = { this, &_result };
     char * error = nullptr;
+    std::lock_guard<std::mutex> lock(m_database_mutex);
     int select_result = sqlite3_exec(mp_sqlite, sql.str().c_str(),
         [](void * pargs, int, char ** values, char **) {
             CallbackArgs * args = static_cast<CallbackArgs *>(pargs);
@@ -441,10 +1292,24 @@ void Repository::findEmails(const Edsl::Expression & _expression, std::vector<st
             Email * email = reverseFindEmail(*args->result, id);
             if(nullptr == email)
             {
-                MailUnit::OS::PathString data_id = MailUnit::OS::utf8ToPathString(values[1]);
-                email = new Email(id, args->repository->makeNewFileName(data_id, false), false);
+                fs::path data_file_path = args->repository->m_blob_store_ptr->dataFilePath(values[1]);
+                email = new Email(id, data_file_path, false);
                 args->result->push_back(std::unique_ptr<Email>(email));
                 email->setSubject(values[2]);
+                boost::uintmax_t size = nullptr == values[6] ?
+                    fs::file_size(data_file_path) : boost::lexical_cast<boost::uintmax_t>(values[6]);
+                email->setSize(size);
+                email->setDataLocation(data_file_path,
+                    nullptr == values[5] ? 0 : boost::lexical_cast<boost::uintmax_t>(values[5]),
+                    nullptr == values[7] ? size : boost::lexical_cast<boost::uintmax_t>(values[7]),
+                    nullptr == values[8] ? BlobEncoding::identity :
+                        static_cast<BlobEncoding>(boost::lexical_cast<int>(values[8])));
+                if(nullptr != values[9])
+                {
+                    email->setHeadLocation(args->repository->m_blob_store_ptr->dataFilePath(values[9]),
+                        boost::lexical_cast<boost::uintmax_t>(values[10]),
+                        boost::lexical_cast<boost::uintmax_t>(values[11]));
+                }
             }
             email->addAddress(static_cast<Email::AddressType>(boost::lexical_cast<short>(values[3])), values[4]);
             return 0;
@@ -460,56 +1325,403 @@ void Repository::findEmails(const Edsl::Expression & _expression, std::vector<st
 
 size_t Repository::dropEmails(const Edsl::Expression & _expression)
 {
-    boost::scoped_ptr<std::vector<std::unique_ptr<Email>>> emails(new std::vector<std::unique_ptr<Email>>());
-    findEmails(_expression, *emails);
-    if(emails->empty())
+    if(!_expression.conditions.is_initialized())
+    {
+        return truncate();
+    }
+    std::stringstream sql;
+    sql << "SELECT DISTINCT " <<
+        TableMessage::table_name << '.' << TableMessage::column_id << ',' <<
+        TableMessage::table_name << '.' << TableMessage::column_data_id << ',' <<
+        TableMessage::table_name << '.' << TableMessage::column_data_offset << ',' <<
+        TableMessage::table_name << '.' << TableMessage::column_data_length << ',' <<
+        TableMessage::table_name << '.' << TableMessage::column_head_id << ',' <<
+        TableMessage::table_name << '.' << TableMessage::column_head_length <<
+        " FROM " << TableMessage::table_name <<
+        " INNER JOIN " << TableExchange::table_name << " ON " <<
+        TableExchange::table_name << '.' << TableExchange::column_message << '=' <<
+        TableMessage::table_name << '.' << TableMessage::column_id << std::endl;
+    mapEdslToSqlSelectWhere(_expression, sql);
+    return deleteMessages(sql.str());
+}
+
+size_t Repository::deleteMessages(const std::string & _select_sql, uint64_t * _released_bytes)
+{
+    std::stringstream sql;
+    sql <<
+        "BEGIN TRANSACTION;\n" <<
+        "CREATE TEMP TABLE IF NOT EXISTS " << TableDropSet::table_name << "(" <<
+        TableDropSet::column_id << " INTEGER PRIMARY KEY, " <<
+        TableDropSet::column_data_id << " VARCHAR(36), " <<
+        TableDropSet::column_data_offset << " INTEGER, " <<
+        TableDropSet::column_data_length << " INTEGER, " <<
+        TableDropSet::column_head_id << " VARCHAR(36), " <<
+        TableDropSet::column_head_length << " INTEGER);\n" <<
+        "DELETE FROM " << TableDropSet::table_name << ";\n" <<
+        "INSERT INTO " << TableDropSet::table_name << ' ' << _select_sql << ";\n" <<
+        "SELECT COUNT(*) FROM " << TableDropSet::table_name << ";\n" <<
+        "DELETE FROM " << TableExchange::table_name << " WHERE " << TableExchange::column_message <<
+        " IN (SELECT " << TableDropSet::column_id << " FROM " << TableDropSet::table_name << ");\n" <<
+        "DELETE FROM " << TableHeader::table_name << " WHERE " << TableHeader::column_message <<
+        " IN (SELECT " << TableDropSet::column_id << " FROM " << TableDropSet::table_name << ");\n" <<
+        "DELETE FROM " << TableMessage::table_name << " WHERE " << TableMessage::column_id <<
+        " IN (SELECT " << TableDropSet::column_id << " FROM " << TableDropSet::table_name << ");\n" <<
+        // A body is released together with its last reference, a head belongs to its message only
+        "SELECT DISTINCT " << TableDropSet::column_data_id << ", " << TableDropSet::column_data_offset << ", " <<
+        TableDropSet::column_data_length << " FROM " << TableDropSet::table_name <<
+        " WHERE NOT EXISTS (SELECT 1 FROM " << TableMessage::table_name << " WHERE " <<
+        TableMessage::table_name << '.' << TableMessage::column_data_id << " = " <<
+        TableDropSet::table_name << '.' << TableDropSet::column_data_id << " AND " <<
+        TableMessage::table_name << '.' << TableMessage::column_data_offset << " = " <<
+        TableDropSet::table_name << '.' << TableDropSet::column_data_offset << ")" <<
+        " UNION ALL SELECT " << TableDropSet::column_head_id << ", " << TableDropSet::column_id << ", " <<
+        TableDropSet::column_head_length << " FROM " << TableDropSet::table_name <<
+        " WHERE " << TableDropSet::column_head_id << " IS NOT NULL;\n" <<
+        "DELETE FROM " << TableDropSet::table_name << ";\n" <<
+        "COMMIT;";
+    struct CallbackArgs
+    {
+        size_t count;
+        bool counted;
+        std::vector<std::string> data_ids;
+        uint64_t released_bytes;
+    } callback_args = { 0, false, { }, 0 };
+    char * error = nullptr;
+    int sql_result;
+    {
+        std::lock_guard<std::mutex> lock(m_database_mutex);
+        sql_result = sqlite3_exec(mp_sqlite, sql.str().c_str(),
+            [](void * pargs, int count, char ** values, char **) {
+                CallbackArgs * args = static_cast<CallbackArgs *>(pargs);
+                if(nullptr == values[0])
+                    return 0;
+                if(args->counted)
+                {
+                    if(count != 3)
+                        return 0;
+                    args->data_ids.push_back(values[0]);
+                    if(nullptr != values[2])
+                        args->released_bytes += boost::lexical_cast<uint64_t>(values[2]);
+                }
+                else
+                {
+                    args->count = boost::lexical_cast<size_t>(values[0]);
+                    args->counted = true;
+                }
+                return 0;
+            }, &callback_args, &error);
+        if(SQLITE_OK != sql_result && 0 == sqlite3_get_autocommit(mp_sqlite))
+        {
+            sqlite3_exec(mp_sqlite, "ROLLBACK;", nullptr, nullptr, nullptr);
+        }
+    }
+    if(SQLITE_OK != sql_result)
+    {
+        std::string er_string("Unable to delete e-mails from the database:\n");
+        er_string += error;
+        sqlite3_free(error);
+        throw StorageException(formatSqliteError(er_string, sql_result));
+    }
+    m_blob_store_ptr->release(callback_args.data_ids);
+    if(nullptr != _released_bytes)
+        *_released_bytes = callback_args.released_bytes;
+    LOG_DEBUG << "Messages have been deleted: " << callback_args.count <<
+        ", released blobs: " << callback_args.data_ids.size();
+    return callback_args.count;
+}
+
+size_t Repository::evictEmails(size_t _batch_size)
+{
+    if(!m_options.hasRetentionPolicy() || 0 == _batch_size)
         return 0;
-    std::string sql;
-    {
-        std::stringstream exchange_sql;
-        std::stringstream message_sql;
-        exchange_sql << "DELETE FROM " << TableExchange::table_name <<
-               " WHERE " << TableExchange::column_message << " IN (";
-        message_sql << "DELETE FROM " << TableMessage::table_name <<
-                " WHERE " << TableMessage::column_id << " IN (";
-        bool first_email = true;
-        for(const std::unique_ptr<Email> & email : *emails)
+    std::time_t min_receiving_time = m_options.max_age > 0 ? std::time(nullptr) - m_options.max_age : 0;
+    size_t evicted_count = 0;
+    struct
+    {
+        uint64_t count;
+        uint64_t bytes;
+    } stat = { 0, 0 };
+    std::stringstream sql;
+    sql << "SELECT (SELECT COUNT(*) FROM " << TableMessage::table_name << "), TOTAL(" <<
+        TableMessage::column_data_length << ") + (SELECT TOTAL(" << TableMessage::column_head_length << ") FROM " <<
+        TableMessage::table_name << ") FROM (SELECT DISTINCT " << TableMessage::column_data_id << ", " <<
+        TableMessage::column_data_offset << ", " << TableMessage::column_data_length << " FROM " <<
+        TableMessage::table_name << ");";
+    {
+        std::lock_guard<std::mutex> lock(m_database_mutex);
+        querySql(sql.str(), "Unable to collect repository statistics",
+            [&stat](char ** _values) {
+                stat.count = boost::lexical_cast<uint64_t>(_values[0]);
+                stat.bytes = static_cast<uint64_t>(boost::lexical_cast<double>(_values[1]));
+            });
+    }
+    for(;;)
+    {
+        bool evict = true;
+        size_t batch_count = 0;
+        uint32_t last_id = 0;
+        uint64_t remaining_count = stat.count;
+        uint64_t remaining_bytes = stat.bytes;
+        // Messages are evicted in the Id order, so a body is released with a message
+        // when no later one refers to it.
+        sql.str(std::string());
+        sql << "SELECT " << TableMessage::column_id << ", " << TableMessage::column_receiving_time <<
+            ", IFNULL(" << TableMessage::column_head_length << ", 0) + CASE WHEN EXISTS (SELECT 1 FROM " <<
+            TableMessage::table_name << " AS Later WHERE Later." << TableMessage::column_data_id << " = " <<
+            TableMessage::table_name << '.' << TableMessage::column_data_id << " AND Later." <<
+            TableMessage::column_data_offset << " = " << TableMessage::table_name << '.' <<
+            TableMessage::column_data_offset << " AND Later." << TableMessage::column_id << " > " <<
+            TableMessage::table_name << '.' << TableMessage::column_id << ") THEN 0 ELSE " <<
+            TableMessage::column_data_length << " END FROM " << TableMessage::table_name <<
+            " ORDER BY " << TableMessage::column_id << " LIMIT " << _batch_size << ";";
+        std::unique_lock<std::mutex> lock(m_database_mutex);
+        querySql(sql.str(), "Unable to select messages for eviction",
+            [&](char ** _values) {
+                ++batch_count;
+                if(!evict)
+                    return;
+                std::time_t receiving_time = nullptr == _values[1] ? 0 : boost::lexical_cast<std::time_t>(_values[1]);
+                uint64_t size = nullptr == _values[2] ? 0 : boost::lexical_cast<uint64_t>(_values[2]);
+                evict =
+                    (m_options.max_messages > 0 && remaining_count > m_options.max_messages) ||
+                    (m_options.max_bytes > 0 && remaining_bytes > m_options.max_bytes) ||
+                    receiving_time < min_receiving_time;
+                if(!evict)
+                    return;
+                last_id = boost::lexical_cast<uint32_t>(_values[0]);
+                --remaining_count;
+                remaining_bytes = remaining_bytes > size ? remaining_bytes - size : 0;
+            });
+        lock.unlock();
+        if(0 == last_id)
+            break;
+        sql.str(std::string());
+        sql << "SELECT " << TableMessage::column_id << ", " << TableMessage::column_data_id << ", " <<
+            TableMessage::column_data_offset << ", " << TableMessage::column_data_length << ", " <<
+            TableMessage::column_head_id << ", " << TableMessage::column_head_length << " FROM " <<
+            TableMessage::table_name << " WHERE " << TableMessage::column_id << " <= " << last_id;
+        // The statistics follow what has been deleted indeed.
+        uint64_t released_bytes = 0;
+        size_t deleted_count = deleteMessages(sql.str(), &released_bytes);
+        evicted_count += deleted_count;
+        stat.count = stat.count > deleted_count ? stat.count - deleted_count : 0;
+        stat.bytes = stat.bytes > released_bytes ? stat.bytes - released_bytes : 0;
+        if(!evict || batch_count < _batch_size)
+            break;
+    }
+    if(evicted_count > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_database_mutex);
+        executeSql("PRAGMA incremental_vacuum;", "Unable to vacuum SQLite database");
+        LOG_INFO << "Messages have been evicted: " << evicted_count;
+    }
+    return evicted_count;
+}
+
+size_t Repository::compactBlobs()
+{
+    if(BlobLayout::segment != m_options.blob_layout)
+        return 0;
+    std::vector<fs::path> segment_paths;
+    {
+        // Once the stores in progress are over, each inactive segment has all of its blobs indexed,
+        // and new blobs go to the active segment only.
+        std::unique_lock<std::shared_timed_mutex> generation_lock(m_generation_mutex);
+        std::string active_segment = m_blob_store_ptr->activeSegment();
+        for(fs::directory_iterator it(m_data_directory), end; it != end; ++it)
         {
-            if(first_email)
-            {
-                first_email = false;
-            }
-            else
-            {
-                exchange_sql << ", ";
-                message_sql << ", ";
-            }
-            exchange_sql << email->id();
-            message_sql << email->id();
+            std::string segment = getUtf8Filename(it->path().filename());
+            if(BlobStore::isSegment(segment) && segment != active_segment)
+                segment_paths.push_back(it->path());
         }
-        exchange_sql << ");";
-        message_sql << ")";
-        exchange_sql << message_sql.str();
-        sql = exchange_sql.str();
     }
+    std::vector<std::string> empty_segments;
+    std::vector<std::string> sparse_segments;
+    for(const fs::path & path : segment_paths)
+    {
+        std::string segment = getUtf8Filename(path.filename());
+        std::string segment_value = prepareSqlValueString(segment);
+        uint64_t live_bytes = 0;
+        uint64_t record_count = 0;
+        std::stringstream sql;
+        sql << "SELECT COUNT(*), TOTAL(" << TableMessage::column_data_length << ") FROM (SELECT DISTINCT " <<
+            TableMessage::column_data_offset << ", " << TableMessage::column_data_length << " FROM " <<
+            TableMessage::table_name << " WHERE " << TableMessage::column_data_id << " = '" <<
+            segment_value << "');\n" <<
+            "SELECT COUNT(*), TOTAL(" << TableMessage::column_head_length << " + " << BlobStore::head_reference_size <<
+            ") FROM " << TableMessage::table_name << " WHERE " << TableMessage::column_head_id << " = '" <<
+            segment_value << "';";
+        {
+            std::lock_guard<std::mutex> lock(m_database_mutex);
+            querySql(sql.str(), "Unable to collect segment statistics",
+                [&](char ** _values) {
+                    record_count += boost::lexical_cast<uint64_t>(_values[0]);
+                    live_bytes += static_cast<uint64_t>(boost::lexical_cast<double>(_values[1]));
+                });
+        }
+        live_bytes += record_count * BlobStore::segment_record_header_size;
+        // A truncation can replace the data directory meanwhile.
+        boost::system::error_code error;
+        uint64_t segment_size = fs::file_size(path, error);
+        if(error)
+            continue;
+        if(0 == record_count)
+            empty_segments.push_back(segment);
+        else if(live_bytes * 2 <= segment_size)
+            sparse_segments.push_back(segment);
+    }
+    for(const std::string & segment : sparse_segments)
+    {
+        // The lock is taken per segment, so a truncation waiting for the exclusive lock
+        // does not hold the stores queued behind it for the whole compaction.
+        std::shared_lock<std::shared_timed_mutex> generation_lock(m_generation_mutex);
+        moveSegmentBlobs(segment);
+        empty_segments.push_back(segment);
+    }
+    for(const std::string & segment : empty_segments)
+    {
+        m_deletion_queue.enqueue(m_blob_store_ptr->dataFilePath(segment));
+    }
+    if(!empty_segments.empty())
+    {
+        LOG_INFO << "Segments have been compacted: " << empty_segments.size();
+    }
+    return empty_segments.size();
+}
+
+void Repository::moveSegmentBlobs(const std::string & _segment)
+{
+    struct Blob
+    {
+        // The location of a record, a head reference precedes the header block.
+        uint64_t offset;
+        uint64_t length;
+        bool head;
+    };
+    std::vector<Blob> blobs;
+    std::stringstream sql;
+    sql << "SELECT DISTINCT " << TableMessage::column_data_offset << ", " <<
+        TableMessage::column_data_length << ", 0 FROM " << TableMessage::table_name <<
+        " WHERE " << TableMessage::column_data_id << " = '" << prepareSqlValueString(_segment) << "'" <<
+        " UNION ALL SELECT " << TableMessage::column_head_offset << " - " << BlobStore::head_reference_size << ", " <<
+        TableMessage::column_head_length << " + " << BlobStore::head_reference_size << ", 1 FROM " <<
+        TableMessage::table_name << " WHERE " << TableMessage::column_head_id << " = '" <<
+        prepareSqlValueString(_segment) << "';";
+    {
+        std::lock_guard<std::mutex> lock(m_database_mutex);
+        querySql(sql.str(), "Unable to select segment messages",
+            [&blobs](char ** _values) {
+                blobs.push_back({
+                    boost::lexical_cast<uint64_t>(_values[0]),
+                    boost::lexical_cast<uint64_t>(_values[1]),
+                    '1' == _values[2][0]
+                });
+            });
+    }
+    if(blobs.empty())
+        return;
+    std::ifstream data(m_blob_store_ptr->dataFilePath(_segment).string(), std::ios_base::binary);
+    if(!data.is_open())
+        throw StorageException("Unable to open a segment file");
+    sql.str(std::string());
+    sql << "BEGIN TRANSACTION;\n";
+    for(const Blob & blob : blobs)
+    {
+        // The record keeps its kind and encoding, a legacy message can be shared as a body.
+        unsigned char header[BlobStore::segment_record_header_size];
+        data.seekg(blob.offset - sizeof(header));
+        data.read(reinterpret_cast<char *>(header), sizeof(header));
+        BlobKind kind;
+        BlobEncoding encoding;
+        if(!data || !BlobStore::parseRecordSignature(static_cast<uint32_t>(readLittleEndian(header, sizeof(uint32_t))),
+            kind, encoding))
+        {
+            throw StorageException("Unable to read a segment record");
+        }
+        BlobLocation location = m_blob_store_ptr->store(data, blob.length, encoding, kind);
+        if(blob.head)
+        {
+            sql << "UPDATE " << TableMessage::table_name << " SET " <<
+                TableMessage::column_head_id << " = '" << prepareSqlValueString(location.data_id) << "', " <<
+                TableMessage::column_head_offset << " = " << location.offset + BlobStore::head_reference_size <<
+                " WHERE " << TableMessage::column_head_id << " = '" << prepareSqlValueString(_segment) << "' AND " <<
+                TableMessage::column_head_offset << " = " << blob.offset + BlobStore::head_reference_size << ";\n";
+        }
+        else
+        {
+            sql << "UPDATE " << TableMessage::table_name << " SET " <<
+                TableMessage::column_data_id << " = '" << prepareSqlValueString(location.data_id) << "', " <<
+                TableMessage::column_data_offset << " = " << location.offset <<
+                " WHERE " << TableMessage::column_data_id << " = '" << prepareSqlValueString(_segment) << "' AND " <<
+                TableMessage::column_data_offset << " = " << blob.offset << ";\n";
+        }
+    }
+    sql << "COMMIT;";
+    std::lock_guard<std::mutex> lock(m_database_mutex);
+    try
+    {
+        executeSql(sql.str(), "Unable to move segment messages");
+    }
+    catch(...)
+    {
+        if(0 == sqlite3_get_autocommit(mp_sqlite))
+            sqlite3_exec(mp_sqlite, "ROLLBACK;", nullptr, nullptr, nullptr);
+        throw;
+    }
+}
+
+size_t Repository::truncate()
+{
+    std::unique_lock<std::shared_timed_mutex> generation_lock(m_generation_mutex);
+    std::stringstream sql;
+    sql <<
+        "BEGIN TRANSACTION;\n" <<
+        "SELECT COUNT(*) FROM " << TableMessage::table_name << ";\n" <<
+        "DELETE FROM " << TableExchange::table_name << ";\n" <<
+        "DELETE FROM " << TableHeader::table_name << ";\n" <<
+        "DELETE FROM " << TableMessage::table_name << ";\n" <<
+        "COMMIT;";
+    size_t count = 0;
     char * error = nullptr;
-    int sql_result =  sqlite3_exec(mp_sqlite, sql.c_str(),
-        [](void * , int, char ** , char **) {
-            return 0;
-        }, nullptr, &error);
+    int sql_result;
+    {
+        std::lock_guard<std::mutex> lock(m_database_mutex);
+        sql_result = sqlite3_exec(mp_sqlite, sql.str().c_str(),
+            [](void * pcount, int count, char ** values, char **) {
+                if(count == 1 && nullptr != values[0])
+                    *static_cast<size_t *>(pcount) = boost::lexical_cast<size_t>(values[0]);
+                return 0;
+            }, &count, &error);
+        if(SQLITE_OK != sql_result && 0 == sqlite3_get_autocommit(mp_sqlite))
+        {
+            sqlite3_exec(mp_sqlite, "ROLLBACK;", nullptr, nullptr, nullptr);
+        }
+    }
     if(SQLITE_OK != sql_result)
     {
-        std::string er_string("Unable to delete e-mails from the database:\n");
+        std::string er_string("Unable to truncate the database:\n");
         er_string += error;
         sqlite3_free(error);
         throw StorageException(formatSqliteError(er_string, sql_result));
     }
-    for(const std::unique_ptr<Email> & email : *emails)
+    fs::path trash_directory = makeNewFileName(generateUniqueFilename() + trash_dir_ext, false);
+    try
     {
-        OS::deleteFile(email->dataFilePath());
-        LOG_DEBUG << "Message has been deleted: " << email->id();
+        m_blob_store_ptr->reset();
+        fs::rename(m_data_directory, trash_directory);
+        fs::create_directories(m_data_directory);
+    }
+    catch(const fs::filesystem_error & error)
+    {
+        std::stringstream message;
+        message << "Unable to replace the data directory." << std::endl <<
+                   "Path: " << error.path1() << std::endl <<
+                   "Error: " << error.what();
+        throw StorageException(message.str());
     }
-    return emails->size();
+    m_deletion_queue.enqueue(trash_directory);
+    LOG_DEBUG << "Repository has been truncated: " << count;
+    return count;
 }
 
 void Repository::mapEdslToSqlSelectWhere(const Edsl::Expression & _expression, std::ostream & _out)
@@ -519,6 +1731,6 @@ void Repository::mapEdslToSqlSelectWhere(const Edsl::Expression & _expression, s
         return;
     }
     _out << " WHERE ";
-    EdsToSqlMapper mapper(_out);
+    EdsToSqlMapper mapper(_out, m_options.indexed_headers);
     mapper.mapToSqlWhereClause(*_expression.conditions);
 }
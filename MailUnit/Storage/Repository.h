@@ -21,6 +21,12 @@
 #include <memory>
 #include <vector>
 #include <ostream>
+#include <mutex>
+#include <functional>
+#include <ctime>
+#include <shared_mutex>
+#include <atomic>
+#include <unordered_set>
 #include <boost/noncopyable.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/variant.hpp>
@@ -28,6 +34,8 @@
 #include <MailUnit/Storage/StorageException.h>
 #include <MailUnit/Storage/Email.h>
 #include <MailUnit/Storage/Edsl.h>
+#include <MailUnit/Storage/DeletionQueue.h>
+#include <MailUnit/Storage/BlobStore.h>
 
 struct sqlite3;
 
@@ -49,27 +57,107 @@ typedef boost::variant<QueryGetResult, QueryDropResult> QueryResult;
 class Repository final : private boost::noncopyable
 {
 public:
-    Repository(const boost::filesystem::path & _storage_direcotiry);
+    struct Options
+    {
+        Options() :
+            max_age(0),
+            max_messages(0),
+            max_bytes(0),
+            blob_layout(BlobLayout::file),
+            segment_size(BlobStore::default_segment_size),
+            compression_level(0),
+            recover(false),
+            recovery_threads(0)
+        {
+        }
+
+        Options(const Options &) = default;
+
+        Options & operator = (const Options &) = default;
+
+        bool hasRetentionPolicy() const
+        {
+            return max_age > 0 || max_messages > 0 || max_bytes > 0;
+        }
+
+        std::vector<std::string> indexed_headers;
+        std::time_t max_age;
+        uint64_t max_messages;
+        uint64_t max_bytes;
+        BlobLayout blob_layout;
+        uint64_t segment_size;
+        int compression_level;
+        bool recover;
+        unsigned int recovery_threads;
+    }; // struct Options
+
+    static const size_t default_eviction_batch_size = 1000;
+
+public:
+    explicit Repository(const boost::filesystem::path & _storage_direcotiry, const Options & _options = Options());
     ~Repository();
     std::unique_ptr<RawEmail> createRawEmail();
     uint32_t storeEmail(RawEmail & _raw_email);
     std::shared_ptr<QueryResult> executeQuery(const std::string & _edsl_query);
+    size_t evictEmails(size_t _batch_size = default_eviction_batch_size);
+    size_t compactBlobs();
+    void verifyStorage();
+
+private:
+    struct RecoveredEmail;
+    struct RecoveredBlobs;
 
 private:
     void initStorageDirectory();
     boost::filesystem::path makeNewFileName(const MailUnit::OS::PathString & _base, bool _temp);
-    void prepareDatabase();
-    uint32_t insertMessage(const Email & _email, const std::string & _data_id);
+    void shardDataFiles();
+    void recoverIndex();
+    void recoverDataFile(const boost::filesystem::path & _path, RecoveredBlobs & _blobs,
+        std::vector<RecoveredEmail> & _batch);
+    void recoverSegment(const boost::filesystem::path & _path, const std::unordered_set<std::string> & _indexed_blobs,
+        RecoveredBlobs & _blobs, std::vector<RecoveredEmail> & _batch);
+    void recoverBlob(const boost::filesystem::path & _path, const BlobLocation & _location, BlobKind _kind,
+        BlobEncoding _encoding, RecoveredBlobs & _blobs, std::vector<RecoveredEmail> & _batch);
+    void recoverHead(size_t _index, RecoveredBlobs & _blobs, std::vector<RecoveredEmail> & _batch);
+    void insertRecoveredEmails(std::vector<RecoveredEmail> & _batch);
+    bool prepareDatabase();
+    int readSchemaVersion();
+    void upgradeDatabase();
+    void enableIncrementalVacuum();
+    bool columnExists(const std::string & _table, const std::string & _column);
+    void executeSql(const std::string & _sql, const std::string & _error_message);
+    void querySql(const std::string & _sql, const std::string & _error_message,
+        const std::function<void(char **)> & _row_callback);
+    static void querySql(sqlite3 * _connection, const std::string & _sql, const std::string & _error_message,
+        const std::function<void(char **)> & _row_callback);
+    bool findBlob(const std::string & _data_hash, BlobLocation & _location, BlobEncoding & _encoding,
+        uint64_t & _size);
+    BlobLocation storeHead(RawEmail & _raw_email, uint64_t _length, const std::string & _body_hash);
+    BlobLocation storeBlob(RawEmail & _raw_email, uint64_t _offset, uint64_t _size, BlobEncoding & _encoding);
+    uint32_t insertMessage(const Email & _email, const std::string & _data_id, const std::string & _data_hash,
+        const std::string & _head_id);
     void insertExchange(const Email & _email, uint32_t _message_id);
+    void insertHeaders(const Email & _email, uint32_t _message_id);
     void findEmails(const Edsl::Expression & _expression, std::vector<std::unique_ptr<Email> > & _result);
     size_t dropEmails(const Edsl::Expression & _expression);
+    size_t deleteMessages(const std::string & _select_sql, uint64_t * _released_bytes = nullptr);
+    size_t truncate();
+    void moveSegmentBlobs(const std::string & _segment);
     void mapEdslToSqlSelectWhere(const Edsl::Expression & _expression, std::ostream & _out);
     template<typename ResultType>
     inline std::shared_ptr<QueryResult> makeQueryResult();
 
 private:
     boost::filesystem::path m_storage_direcotiry;
+    boost::filesystem::path m_data_directory;
+    boost::filesystem::path m_temp_directory;
+    Options m_options;
+    std::atomic<bool> m_unclean_shutdown;
     sqlite3 * mp_sqlite;
+    std::mutex m_database_mutex;
+    std::shared_timed_mutex m_generation_mutex;
+    DeletionQueue m_deletion_queue;
+    std::unique_ptr<BlobStore> m_blob_store_ptr;
 }; // class Repository
 
 template<typename ResultType>
@@ -0,0 +1,120 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <MailUnit/Storage/RetentionTask.h>
+#include <MailUnit/Logger.h>
+
+using namespace MailUnit::Storage;
+namespace asio = boost::asio;
+
+namespace {
+
+class RetentionTask : public std::enable_shared_from_this<RetentionTask>
+{
+public:
+    inline RetentionTask(asio::io_service & _io_service,
+        std::shared_ptr<StorageExecutor> _executor,
+        std::shared_ptr<Repository> _repository,
+        const boost::posix_time::time_duration & _interval);
+    void schedule();
+
+private:
+    void maintain();
+    void evict();
+    void compact();
+
+private:
+    asio::io_service & mr_io_service;
+    asio::deadline_timer m_timer;
+    std::shared_ptr<StorageExecutor> m_executor_ptr;
+    std::shared_ptr<Repository> m_repository_ptr;
+    boost::posix_time::time_duration m_interval;
+}; // class RetentionTask
+
+} // namespace
+
+RetentionTask::RetentionTask(asio::io_service & _io_service,
+        std::shared_ptr<StorageExecutor> _executor,
+        std::shared_ptr<Repository> _repository,
+        const boost::posix_time::time_duration & _interval) :
+    mr_io_service(_io_service),
+    m_timer(_io_service),
+    m_executor_ptr(_executor),
+    m_repository_ptr(_repository),
+    m_interval(_interval)
+{
+}
+
+void RetentionTask::schedule()
+{
+    auto self = shared_from_this();
+    m_timer.expires_from_now(m_interval);
+    m_timer.async_wait([self](const boost::system::error_code & _err_code)
+    {
+        if(_err_code)
+            return;
+        self->maintain();
+    });
+}
+
+// The eviction and the segment compaction run on the storage executor to keep the network threads free,
+// the timer is armed again when both are over.
+void RetentionTask::maintain()
+{
+    auto self = shared_from_this();
+    bool posted = m_executor_ptr->post([self]() {
+        self->evict();
+        self->compact();
+        self->mr_io_service.post([self]() {
+            self->schedule();
+        });
+    });
+    if(!posted)
+        schedule();
+}
+
+void RetentionTask::evict()
+{
+    try
+    {
+        m_repository_ptr->evictEmails();
+    }
+    catch(const std::exception & error)
+    {
+        LOG_ERROR << "Unable to evict messages: " << error.what();
+    }
+}
+
+void RetentionTask::compact()
+{
+    try
+    {
+        m_repository_ptr->compactBlobs();
+    }
+    catch(const std::exception & error)
+    {
+        LOG_ERROR << "Unable to compact segments: " << error.what();
+    }
+}
+
+void MailUnit::Storage::startRetentionTask(asio::io_service & _io_service,
+    std::shared_ptr<StorageExecutor> _executor,
+    std::shared_ptr<Repository> _repository,
+    const boost::posix_time::time_duration & _interval)
+{
+    std::make_shared<RetentionTask>(_io_service, _executor, _repository, _interval)->schedule();
+}
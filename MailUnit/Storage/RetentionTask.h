@@ -0,0 +1,37 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#ifndef __MU_STORAGE_RETENTIONTASK_H__
+#define __MU_STORAGE_RETENTIONTASK_H__
+
+#include <memory>
+#include <boost/asio.hpp>
+#include <MailUnit/Storage/Repository.h>
+#include <MailUnit/Storage/StorageExecutor.h>
+
+namespace MailUnit {
+namespace Storage {
+
+void startRetentionTask(boost::asio::io_service & _io_service,
+    std::shared_ptr<StorageExecutor> _executor,
+    std::shared_ptr<Repository> _repository,
+    const boost::posix_time::time_duration & _interval);
+
+} // namespace Storage
+} // namespace MailUnit
+
+#endif // __MU_STORAGE_RETENTIONTASK_H__
@@ -0,0 +1,104 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <MailUnit/Storage/StorageExecutor.h>
+#include <MailUnit/Logger.h>
+
+using namespace MailUnit::Storage;
+
+StorageExecutor::StorageExecutor(size_t _thread_count, size_t _queue_capacity) :
+    m_queue_capacity(_queue_capacity),
+    m_stopped(false)
+{
+    if(0 == _thread_count)
+        _thread_count = 1;
+    for(size_t i = 0; i < _thread_count; ++i)
+    {
+        m_threads.emplace_back([this]() {
+            run();
+        });
+    }
+}
+
+StorageExecutor::~StorageExecutor()
+{
+    stop();
+}
+
+// Rejects new tasks, completes the accepted ones and joins the worker threads.
+// The owner stops the executor explicitly, so the destructor does not join the threads
+// when the last reference is released by a task.
+void StorageExecutor::stop()
+{
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+        threads.swap(m_threads);
+    }
+    m_condition.notify_all();
+    for(std::thread & thread : threads)
+    {
+        thread.join();
+    }
+}
+
+bool StorageExecutor::post(Task _task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_stopped || m_tasks.size() >= m_queue_capacity)
+            return false;
+        m_tasks.push_back(std::move(_task));
+    }
+    m_condition.notify_one();
+    return true;
+}
+
+void StorageExecutor::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for(;;)
+    {
+        m_condition.wait(lock, [this]() {
+            return m_stopped || !m_tasks.empty();
+        });
+        // Accepted tasks are completed even when the executor is stopping.
+        if(m_tasks.empty())
+            return;
+        {
+            // The task is destroyed before the mutex is locked again because it can hold
+            // the last reference to an object that uses the executor.
+            Task task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            lock.unlock();
+            try
+            {
+                task();
+            }
+            catch(const std::exception & error)
+            {
+                LOG_ERROR << "Storage task has failed: " << error.what();
+            }
+            catch(...)
+            {
+                LOG_ERROR << "Storage task has failed with an unknown error";
+            }
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,62 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#ifndef __MU_STORAGE_STORAGEEXECUTOR_H__
+#define __MU_STORAGE_STORAGEEXECUTOR_H__
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <boost/noncopyable.hpp>
+
+namespace MailUnit {
+namespace Storage {
+
+class StorageExecutor final : private boost::noncopyable
+{
+public:
+    typedef std::function<void()> Task;
+
+    static const size_t default_thread_count = 2;
+    static const size_t default_queue_capacity = 1024;
+
+public:
+    explicit StorageExecutor(size_t _thread_count = default_thread_count,
+        size_t _queue_capacity = default_queue_capacity);
+    ~StorageExecutor();
+    bool post(Task _task);
+    void stop();
+
+private:
+    void run();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Task> m_tasks;
+    size_t m_queue_capacity;
+    bool m_stopped;
+    std::vector<std::thread> m_threads;
+}; // class StorageExecutor
+
+} // namespace Storage
+} // namespace MailUnit
+
+#endif // __MU_STORAGE_STORAGEEXECUTOR_H__
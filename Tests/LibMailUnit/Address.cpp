@@ -15,6 +15,8 @@
  *                                                                                             *
  ***********************************************************************************************/
 
+#include <string>
+#include <vector>
 #include <boost/test/unit_test.hpp>
 #include <LibMailUnit/Api/Include/Message/Mailbox.h>
 
@@ -120,6 +122,144 @@ BOOST_AUTO_TEST_CASE(ParseNamedMailboxGroupWithNamedMailboxesTest)
     muFree(mailbox_group);
 }
 
+BOOST_AUTO_TEST_CASE(ParseEmptyMailboxGroupTest)
+{
+    const char text[] = "Undisclosed recipients:;";
+    MU_MailboxGroup * mailbox_group = muMailboxGroupParse(text);
+    BOOST_REQUIRE(nullptr != mailbox_group);
+    BOOST_CHECK_EQUAL("Undisclosed recipients", muMailboxGroupName(mailbox_group));
+    BOOST_CHECK_EQUAL(0, muMailboxCount(mailbox_group));
+    muFree(mailbox_group);
+}
+
+BOOST_AUTO_TEST_CASE(ParseEncodedNameTest)
+{
+    const char text[] = "=?utf-8?q?Caf=C3=A9?= team: =?UTF-8?B?0J/RgNC40LLQtdGC?= <my.test@test.example.com>";
+    MU_MailboxGroup * mailbox_group = muMailboxGroupParse(text);
+    BOOST_CHECK_EQUAL("Caf\xC3\xA9 team", muMailboxGroupName(mailbox_group));
+    BOOST_REQUIRE_EQUAL(1, muMailboxCount(mailbox_group));
+    MU_Mailbox * mailbox = muMailbox(mailbox_group, 0);
+    BOOST_CHECK_EQUAL("\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82", muMailboxName(mailbox));
+    BOOST_CHECK_EQUAL("my.test@test.example.com", muMailboxAddress(mailbox));
+    muFree(mailbox);
+    muFree(mailbox_group);
+}
+
+BOOST_AUTO_TEST_CASE(ParseEncodedNameCharsetsTest)
+{
+    // More charsets than the converter cache keeps, twice, and an unsupported one
+    const char * charsets[] = { "windows-1250", "windows-1251", "windows-1252", "koi8-r", "iso-8859-2",
+        "iso-8859-5", "iso-8859-7", "iso-8859-15", "cp866", "ibm437", "x-unknown" };
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        for(const char * charset : charsets)
+        {
+            std::string text = std::string("=?") + charset + "?q?=41?= <a@example.com>";
+            MU_MailboxGroup * mailbox_group = muMailboxGroupParse(text.c_str());
+            BOOST_REQUIRE_EQUAL(1, muMailboxCount(mailbox_group));
+            MU_Mailbox * mailbox = muMailbox(mailbox_group, 0);
+            if(std::string("x-unknown") == charset)
+                BOOST_CHECK_EQUAL("=?x-unknown?q?=41?=", muMailboxName(mailbox));
+            else
+                BOOST_CHECK_EQUAL("A", muMailboxName(mailbox));
+            muFree(mailbox);
+            muFree(mailbox_group);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ParseQuotedNameTest)
+{
+    const char text[] = "\"Doe, John\" <john@example.com>, \"Smith \\\"Jr\\\"\" <smith@example.com>";
+    MU_MailboxGroup * mailbox_group = muMailboxGroupParse(text);
+    BOOST_REQUIRE_EQUAL(2, muMailboxCount(mailbox_group));
+    MU_Mailbox * mailbox = muMailbox(mailbox_group, 0);
+    BOOST_CHECK_EQUAL("Doe, John", muMailboxName(mailbox));
+    BOOST_CHECK_EQUAL("john@example.com", muMailboxAddress(mailbox));
+    muFree(mailbox);
+    mailbox = muMailbox(mailbox_group, 1);
+    BOOST_CHECK_EQUAL("Smith \"Jr\"", muMailboxName(mailbox));
+    BOOST_CHECK_EQUAL("smith@example.com", muMailboxAddress(mailbox));
+    muFree(mailbox);
+    muFree(mailbox_group);
+}
+
+BOOST_AUTO_TEST_CASE(ParseCommentsTest)
+{
+    const char text[] = "John (the (first), one)\r\n Doe <john(home)@example.com>, jane@example.com (Jane, Doe)";
+    MU_MailboxGroup * mailbox_group = muMailboxGroupParse(text);
+    BOOST_REQUIRE_EQUAL(2, muMailboxCount(mailbox_group));
+    MU_Mailbox * mailbox = muMailbox(mailbox_group, 0);
+    BOOST_CHECK_EQUAL("John Doe", muMailboxName(mailbox));
+    BOOST_CHECK_EQUAL("john@example.com", muMailboxAddress(mailbox));
+    muFree(mailbox);
+    mailbox = muMailbox(mailbox_group, 1);
+    BOOST_CHECK(nullptr == muMailboxName(mailbox));
+    BOOST_CHECK_EQUAL("jane@example.com", muMailboxAddress(mailbox));
+    muFree(mailbox);
+    muFree(mailbox_group);
+}
+
+BOOST_AUTO_TEST_CASE(ParseAddressListTest)
+{
+    const char text[] = "first@example.com, Team: \"Doe, John\" <@relay.example.com:john@example.com>, "
+        "\"jane doe\"@example.com;, Empty: ;, Last <last@example.com>";
+    MU_AddressListItem items[4];
+    char arena[256];
+    size_t item_count = 4;
+    size_t arena_size = sizeof(arena);
+    BOOST_REQUIRE(muAddressListParse(text, items, &item_count, arena, &arena_size));
+    BOOST_REQUIRE_EQUAL(4, item_count);
+    BOOST_CHECK(nullptr == items[0].group);
+    BOOST_CHECK(nullptr == items[0].name);
+    BOOST_CHECK_EQUAL("first@example.com", items[0].address);
+    BOOST_CHECK_EQUAL("Team", items[1].group);
+    BOOST_CHECK_EQUAL("Doe, John", items[1].name);
+    BOOST_CHECK_EQUAL("john@example.com", items[1].address);
+    BOOST_CHECK_EQUAL("Team", items[2].group);
+    BOOST_CHECK(nullptr == items[2].name);
+    BOOST_CHECK_EQUAL("\"jane doe\"@example.com", items[2].address);
+    BOOST_CHECK(nullptr == items[3].group);
+    BOOST_CHECK_EQUAL("Last", items[3].name);
+    BOOST_CHECK_EQUAL("last@example.com", items[3].address);
+}
+
+BOOST_AUTO_TEST_CASE(ParseAddressListOverflowTest)
+{
+    const char text[] = "One <one@example.com>, Two <two@example.com>, Three <three@example.com>";
+    MU_AddressListItem items[3];
+    char arena[8];
+    size_t item_count = 1;
+    size_t arena_size = sizeof(arena);
+    BOOST_CHECK(!muAddressListParse(text, items, &item_count, arena, &arena_size));
+    BOOST_REQUIRE_EQUAL(3, item_count);
+    std::vector<char> heap_arena(arena_size);
+    BOOST_REQUIRE(muAddressListParse(text, items, &item_count, heap_arena.data(), &arena_size));
+    BOOST_CHECK_EQUAL(heap_arena.size(), arena_size);
+    BOOST_CHECK_EQUAL("Three", items[2].name);
+    BOOST_CHECK_EQUAL("three@example.com", items[2].address);
+}
+
+BOOST_AUTO_TEST_CASE(ParseAddressListEncodedOverflowTest)
+{
+    // Every 4 symbols of the encoded name are decoded to 3 Latin-1 letters taking 6 bytes in UTF-8
+    const char text[] = "=?ISO-8859-1?B?6enp6enp6enp6enp6enp6enp6enp6enp6enp6enp6enp6enp?= <e@example.com>";
+    MU_AddressListItem items[1];
+    char arena[8];
+    size_t item_count = 1;
+    size_t arena_size = sizeof(arena);
+    BOOST_CHECK(!muAddressListParse(text, items, &item_count, arena, &arena_size));
+    BOOST_CHECK_LT(sizeof(text), arena_size);
+    std::vector<char> heap_arena(arena_size);
+    BOOST_REQUIRE(muAddressListParse(text, items, &item_count, heap_arena.data(), &arena_size));
+    BOOST_CHECK_EQUAL(heap_arena.size(), arena_size);
+    std::string name;
+    for(int i = 0; i < 36; ++i)
+        name += "\xC3\xA9";
+    BOOST_CHECK_EQUAL(name, items[0].name);
+    BOOST_CHECK_EQUAL("e@example.com", items[0].address);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace LibMailUnit
@@ -77,6 +77,38 @@ BOOST_AUTO_TEST_CASE(parse)
     BOOST_CHECK_EQUAL(mu_false, muDateTimeParse(invalid_raw_dow_4, &date_time));
 }
 
+BOOST_AUTO_TEST_CASE(parseDayOfWeek)
+{
+    MU_DateTime date_time;
+    memset(&date_time, 0, sizeof(MU_DateTime));
+    BOOST_CHECK_EQUAL(mu_true, muDateTimeParse("Tue, 15 Jul 2014 20:11:15 +0000", &date_time));
+    BOOST_CHECK_EQUAL(mu_dow_tue, date_time.day_of_week);
+    BOOST_CHECK_EQUAL(mu_true, muDateTimeParse("Thu , 17 Jul 2014 20:11:15 +0000", &date_time));
+    BOOST_CHECK_EQUAL(mu_dow_thu, date_time.day_of_week);
+    BOOST_CHECK_EQUAL(mu_true, muDateTimeParse("Xyz, 17 Jul 2014 20:11:15 +0000", &date_time));
+    BOOST_CHECK_EQUAL(mu_dow_invalid, date_time.day_of_week);
+}
+
+BOOST_AUTO_TEST_CASE(parseObsoleteZone)
+{
+    MU_DateTime date_time;
+    memset(&date_time, 0, sizeof(MU_DateTime));
+    BOOST_CHECK_EQUAL(mu_true, muDateTimeParse("Sat, 12 Jul 2014 20:11:15 EST", &date_time));
+    BOOST_CHECK_EQUAL(-5, date_time.timezone_offset_hours);
+    BOOST_CHECK_EQUAL(0, date_time.timezone_offset_minutes);
+    BOOST_CHECK_EQUAL(mu_true, muDateTimeParse("Sat, 12 Jul 2014 20:11:15 pdt", &date_time));
+    BOOST_CHECK_EQUAL(-7, date_time.timezone_offset_hours);
+    BOOST_CHECK_EQUAL(mu_true, muDateTimeParse("12 Jul 2014 20:11 GMT", &date_time));
+    BOOST_CHECK_EQUAL(0, date_time.timezone_offset_hours);
+    BOOST_CHECK_EQUAL(0, date_time.seconds);
+    BOOST_CHECK_EQUAL(mu_true, muDateTimeParse("12 Jul 2014 20:11:15 Z", &date_time));
+    BOOST_CHECK_EQUAL(0, date_time.timezone_offset_hours);
+    BOOST_CHECK_EQUAL(mu_false, muDateTimeParse("12 Jul 2014 20:11:15 J", &date_time));
+    BOOST_CHECK_EQUAL(mu_false, muDateTimeParse("12 Jul 2014 20:11:15 ABCD", &date_time));
+    BOOST_CHECK_EQUAL(mu_false, muDateTimeParse("12 Jul 2014 20:11:15 -04", &date_time));
+    BOOST_CHECK_EQUAL(mu_false, muDateTimeParse("12 Jul 2014 20:11:15 -0430 x", &date_time));
+}
+
 BOOST_AUTO_TEST_CASE(toUnixTime)
 {
     MU_DateTime dt = { };
@@ -124,6 +124,126 @@ BOOST_AUTO_TEST_CASE(parseFileTest)
     muFree(headers);
 }
 
+BOOST_AUTO_TEST_CASE(parseInterleavedValuesTest)
+{
+    const std::string raw_headers =
+        "Received: from a\r\n"
+        "Subject: Test\r\n"
+        "received: from b\r\n"
+        "  by c\r\n"
+        "Empty:\r\n"
+        "NoColon\r\n"
+        " ignored continuation\r\n"
+        "RECEIVED: from d";
+    MU_MailHeaderList * headers = muMailHeadersParseString(raw_headers.c_str());
+    BOOST_CHECK_EQUAL(2, muMailHeadersCount(headers));
+
+    MU_MailHeader * header = muMailHeaderByName(headers, "received");
+    BOOST_CHECK_EQUAL("Received", muMailHeaderName(header));
+    BOOST_CHECK_EQUAL(3, muMailHeaderValueCount(header));
+    BOOST_CHECK_EQUAL("from a", muMailHeaderValue(header, 0));
+    BOOST_CHECK_EQUAL("from b  by c", muMailHeaderValue(header, 1));
+    BOOST_CHECK_EQUAL("from d", muMailHeaderValue(header, 2));
+    BOOST_CHECK(nullptr == muMailHeaderValue(header, 3));
+    muFree(header);
+
+    header = muMailHeaderByName(headers, "Subject");
+    BOOST_CHECK_EQUAL(1, muMailHeaderValueCount(header));
+    BOOST_CHECK_EQUAL("Test", muMailHeaderValue(header, 0));
+    muFree(header);
+
+    BOOST_CHECK(nullptr == muMailHeaderByName(headers, "Empty"));
+    muFree(headers);
+}
+
+BOOST_AUTO_TEST_CASE(findManyHeadersTest)
+{
+    std::string raw_headers;
+    for(int i = 0; i < 200; ++i)
+    {
+        std::string index = std::to_string(i);
+        raw_headers += "X-Header-" + index + ": value " + index + "\r\n";
+        if(0 == i % 10)
+            raw_headers += "x-header-0: repeat " + index + "\r\n";
+    }
+    MU_MailHeaderList * headers = muMailHeadersParseString(raw_headers.c_str());
+    BOOST_CHECK_EQUAL(200, muMailHeadersCount(headers));
+
+    MU_MailHeader * header = muMailHeaderByName(headers, "X-HEADER-0");
+    BOOST_CHECK_EQUAL("X-Header-0", muMailHeaderName(header));
+    BOOST_CHECK_EQUAL(21, muMailHeaderValueCount(header));
+    BOOST_CHECK_EQUAL("repeat 190", muMailHeaderValue(header, 20));
+    muFree(header);
+
+    header = muMailHeaderByName(headers, "x-header-199");
+    BOOST_CHECK_EQUAL("value 199", muMailHeaderValue(header, 0));
+    muFree(header);
+
+    BOOST_CHECK(nullptr == muMailHeaderByName(headers, "X-Header-200"));
+    BOOST_CHECK(nullptr == muMailHeaderByName(headers, "X-Header-1 "));
+    muFree(headers);
+}
+
+BOOST_AUTO_TEST_CASE(headerViewsTest)
+{
+    const std::string raw_headers =
+        "Received: from a\r\n"
+        "Subject: Test\r\n"
+        "received: from b\r\n"
+        "To: user@example.com";
+    MU_MailHeaderList * headers = muMailHeadersParseString(raw_headers.c_str());
+
+    MU_MailHeaderView header;
+    BOOST_REQUIRE(muMailHeaderFind(headers, "RECEIVED", &header));
+    BOOST_CHECK_EQUAL("Received", header.name);
+    BOOST_REQUIRE_EQUAL(2, header.value_count);
+    BOOST_CHECK_EQUAL("from a", header.values[0]);
+    BOOST_CHECK_EQUAL("from b", header.values[1]);
+    BOOST_CHECK(!muMailHeaderFind(headers, "Cc", &header));
+    BOOST_CHECK_EQUAL("Received", header.name);
+
+    MU_MailHeaderView views[2];
+    BOOST_REQUIRE_EQUAL(3, muMailHeaderViews(headers, views, 2));
+    BOOST_CHECK_EQUAL("Received", views[0].name);
+    BOOST_CHECK_EQUAL("Subject", views[1].name);
+    BOOST_CHECK_EQUAL("Test", views[1].values[0]);
+
+    MU_StringView values[4];
+    BOOST_REQUIRE_EQUAL(2, muMailHeaderValueViews(headers, "received", values, 4));
+    BOOST_CHECK_EQUAL("from b", std::string(values[1].data, values[1].length));
+    BOOST_CHECK_EQUAL(1, muMailHeaderValueViews(headers, "to", nullptr, 0));
+    BOOST_CHECK_EQUAL(0, muMailHeaderValueViews(headers, "cc", values, 4));
+    muFree(headers);
+}
+
+namespace {
+
+std::string decodeValue(const char * _value)
+{
+    std::string result(muMailHeaderDecodeValue(_value, nullptr, 0), '\0');
+    muMailHeaderDecodeValue(_value, &result[0], result.size() + 1);
+    return result;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(decodeValueTest)
+{
+    BOOST_CHECK_EQUAL("Plain text", decodeValue("Plain text"));
+    BOOST_CHECK_EQUAL("\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82", decodeValue("=?UTF-8?B?0J/RgNC40LLQtdGC?="));
+    BOOST_CHECK_EQUAL("Re: caf\xC3\xA9 ok", decodeValue("Re: =?iso-8859-1?q?caf=E9?= ok"));
+    BOOST_CHECK_EQUAL("a b_c", decodeValue("=?us-ascii?Q?a_b=5Fc?="));
+    // The symbol is split between the words and spaces between them are ignored
+    BOOST_CHECK_EQUAL("\xD0\x9F\xD1\x80", decodeValue("=?utf-8?B?0J/R?=\r\n =?utf-8?B?gA==?="));
+    BOOST_CHECK_EQUAL("\xD0\x9F\xD1\x80", decodeValue("=?windows-1251*ru?B?z/A=?="));
+    BOOST_CHECK_EQUAL("=?unknown-charset?B?QQ==?= A", decodeValue("=?unknown-charset?B?QQ==?= =?utf-8?Q?A?="));
+    BOOST_CHECK_EQUAL("=?utf-8?X?A?= =?utf-8?Q?A B?=", decodeValue("=?utf-8?X?A?= =?utf-8?Q?A B?="));
+
+    char buffer[4];
+    BOOST_CHECK_EQUAL(6, muMailHeaderDecodeValue("=?utf-8?Q?abcdef?=", buffer, sizeof(buffer)));
+    BOOST_CHECK_EQUAL("abc", buffer);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace Test
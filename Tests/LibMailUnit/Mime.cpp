@@ -191,6 +191,7 @@ void testParts(MU_MimePart * _message)
     BOOST_CHECK_EQUAL("text/plain", muMailHeaderValue(header, 0));
     muFree(header);
     muFree(headers);
+    BOOST_CHECK_EQUAL("The plain text format\r\n", muMimeContent(part));
     muFree(part);
 
     part = muMimePart(_message, 1);
@@ -205,6 +206,8 @@ void testParts(MU_MimePart * _message)
     BOOST_CHECK_EQUAL("text/html", muMailHeaderValue(header, 0));
     muFree(header);
     muFree(headers);
+    BOOST_CHECK_EQUAL("<html>\r\n<head>\r\n<title>Test</title>\r\n</head>\r\n<body>\r\n<p>The html format</p>\r\n</body>",
+        muMimeContent(part));
     muFree(part);
 }
 
@@ -227,6 +230,141 @@ BOOST_AUTO_TEST_CASE(parseMimeFileTest)
     muFree(message);
 }
 
+BOOST_AUTO_TEST_CASE(parseNestedMultipartTest)
+{
+    const char * source =
+        "Content-Type: multipart/mixed; boundary=outer\r\n"
+        "\r\n"
+        "--outer\r\n"
+        "Content-Type: multipart/alternative; boundary=inner\r\n"
+        "\r\n"
+        "--inner\r\n"
+        "\r\n"
+        "plain\r\n"
+        "--inner--\r\n"
+        "--outer\r\n"
+        "Content-Type: application/octet-stream\r\n"
+        "\r\n"
+        "data\r\n"
+        "--outer--\r\n"
+        "epilogue\r\n";
+    MU_MimeMessage * message = muMimeParseString(source);
+    MU_MimePart * root = muMimeToPart(message);
+    BOOST_REQUIRE_EQUAL(2, muMimePartCount(root));
+    MU_MimePart * part = muMimePart(root, 0);
+    BOOST_REQUIRE_EQUAL(1, muMimePartCount(part));
+    MU_MimePart * nested_part = muMimePart(part, 0);
+    BOOST_CHECK_EQUAL("plain", muMimeContent(nested_part));
+    muFree(nested_part);
+    muFree(part);
+    part = muMimePart(root, 1);
+    BOOST_CHECK_EQUAL(0, muMimePartCount(part));
+    BOOST_CHECK_EQUAL("data", muMimeContent(part));
+    muFree(part);
+    muFree(root);
+    muFree(message);
+}
+
+BOOST_AUTO_TEST_CASE(parseDelimitersTest)
+{
+    const char * source =
+        "Content-Type: multipart/mixed; boundary=\"--b\"\r\n"
+        "\r\n"
+        "----b\r\n"
+        "----b  \r\n"
+        "\r\n"
+        "---- -- ---b\r\n"
+        "x----b\r\n"
+        "----b\r\n"
+        "\r\n"
+        "last\r\n"
+        "----b--";
+    MU_MimeMessage * message = muMimeParseString(source);
+    MU_MimePart * root = muMimeToPart(message);
+    BOOST_REQUIRE_EQUAL(3, muMimePartCount(root));
+    MU_MimePart * part = muMimePart(root, 0);
+    BOOST_CHECK_EQUAL("", muMimeContent(part));
+    muFree(part);
+    part = muMimePart(root, 1);
+    BOOST_CHECK_EQUAL("---- -- ---b\r\nx----b", muMimeContent(part));
+    muFree(part);
+    part = muMimePart(root, 2);
+    BOOST_CHECK_EQUAL("last", muMimeContent(part));
+    muFree(part);
+    muFree(root);
+    muFree(message);
+}
+
+BOOST_AUTO_TEST_CASE(parseEncodedSubjectTest)
+{
+    MU_MimeMessage * message = muMimeParseString("Subject: =?utf-8?Q?Caf=C3=A9?=\r\n\r\n");
+    BOOST_CHECK_EQUAL("Caf\xC3\xA9", muMimeSubject(message));
+    muFree(message);
+}
+
+BOOST_AUTO_TEST_CASE(parseEncapsulatedMessageTest)
+{
+    const char * source =
+        "Subject: Bounce\r\n"
+        "Content-Type: multipart/report; boundary=report\r\n"
+        "\r\n"
+        "--report\r\n"
+        "\r\n"
+        "Delivery failed\r\n"
+        "--report\r\n"
+        "Content-Type: message/rfc822\r\n"
+        "\r\n"
+        "From: Original Sender <sender@example.com>\r\n"
+        "Subject: Original\r\n"
+        "\r\n"
+        "Original body\r\n"
+        "--report--\r\n";
+    MU_MimeMessage * message = muMimeParseString(source);
+    MU_MimePart * root = muMimeToPart(message);
+    BOOST_REQUIRE_EQUAL(2, muMimePartCount(root));
+    MU_MimePart * part = muMimePart(root, 1);
+    BOOST_CHECK(nullptr == muMimePartToMessage(part));
+    BOOST_REQUIRE_EQUAL(1, muMimePartCount(part));
+    MU_MimePart * nested_part = muMimePart(part, 0);
+    MU_MimeMessage * nested_message = muMimePartToMessage(nested_part);
+    BOOST_REQUIRE(nested_message);
+    BOOST_CHECK_EQUAL("Original", muMimeSubject(nested_message));
+    BOOST_CHECK_EQUAL(1, muMimeMailboxGroupCount(nested_message, mu_mbox_from));
+    BOOST_CHECK_EQUAL("Original body", muMimeContent(nested_part));
+    muFree(nested_message);
+    muFree(nested_part);
+    muFree(part);
+    muFree(root);
+    muFree(message);
+}
+
+BOOST_AUTO_TEST_CASE(depthLimitTest)
+{
+    std::string source = "Subject: Deep\r\n";
+    for(int i = 0; i < 10000; ++i)
+        source += "Content-Type: message/rfc822\r\n\r\n";
+    source += "\r\nBody";
+    MU_MimeMessage * message = muMimeParseString(source.c_str());
+    MU_MimePart * part = muMimeToPart(message);
+    size_t depth = 0;
+    while(muMimePartCount(part) > 0)
+    {
+        MU_MimePart * nested_part = muMimePart(part, 0);
+        muFree(part);
+        part = nested_part;
+        ++depth;
+    }
+    BOOST_CHECK_EQUAL(MU_MIME_DEFAULT_DEPTH_LIMIT, depth);
+    muFree(part);
+    muFree(message);
+
+    message = muMimeParseStringEx(source.c_str(), 2);
+    part = muMimeToPart(message);
+    BOOST_CHECK_EQUAL(1, muMimePartCount(part));
+    muFree(part);
+    muFree(message);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace LibMailUnit
@@ -0,0 +1,85 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of the MailUnit Library.                                                  *
+ *                                                                                             *
+ * MailUnit Library is free software: you can redistribute it and/or modify it under the terms *
+ * of the GNU Lesser General Public License as published by the Free Software Foundation,      *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit Library is distributed in the hope that it will be useful, but WITHOUT ANY         *
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR  *
+ * PURPOSE. See the GNU Lesser General Public License for more details.                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU License General Public License along with        *
+ * MailUnit Library. If not, see <http://www.gnu.org/licenses>.                                *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include <LibMailUnit/Api/Include/Message/Mime.h>
+
+namespace LibMailUnit {
+namespace Test {
+
+BOOST_AUTO_TEST_SUITE(TransferEncoding)
+
+namespace {
+
+std::string decode(const std::string & _encoding, const std::string & _content, size_t _buffer_size = 1024)
+{
+    std::string source = "Content-Transfer-Encoding: " + _encoding + "\r\n\r\n" + _content;
+    MU_MimeMessage * message = muMimeParseString(source.c_str());
+    MU_MimePart * part = muMimeToPart(message);
+    std::string result;
+    std::string buffer(_buffer_size, '\0');
+    size_t position = 0;
+    size_t size;
+    while((size = muMimeDecodedContent(part, &position, &buffer[0], buffer.size())) > 0)
+        result.append(buffer, 0, size);
+    muFree(part);
+    muFree(message);
+    return result;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(decodeBase64Test)
+{
+    BOOST_CHECK_EQUAL("Hello, World!", decode("base64", "SGVsbG8sIFdvcmxkIQ=="));
+    BOOST_CHECK_EQUAL("Hello, World", decode("Base64", "SGVs\r\nbG8s IFdv\r\ncmxk\r\n"));
+    BOOST_CHECK_EQUAL("ab", decode("base64", "YWI="));
+    BOOST_CHECK_EQUAL("ab", decode("base64", "YWI"));
+    BOOST_CHECK_EQUAL("abcabd", decode("base64", "YWJj\r\n\r\nYWJk", 3));
+    BOOST_CHECK_EQUAL("", decode("base64", "====\r\n"));
+    std::string binary;
+    for(int i = 0; i < 256; ++i)
+        binary += static_cast<char>(i);
+    std::string encoded =
+        "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8gISIjJCUmJygpKissLS4vMDEyMzQ1Njc4\r\n"
+        "OTo7PD0+P0BBQkNERUZHSElKS0xNTk9QUVJTVFVWV1hZWltcXV5fYGFiY2RlZmdoaWprbG1ub3Bx\r\n"
+        "cnN0dXZ3eHl6e3x9fn+AgYKDhIWGh4iJiouMjY6PkJGSk5SVlpeYmZqbnJ2en6ChoqOkpaanqKmq\r\n"
+        "q6ytrq+wsbKztLW2t7i5uru8vb6/wMHCw8TFxsfIycrLzM3Oz9DR0tPU1dbX2Nna29zd3t/g4eLj\r\n"
+        "5OXm5+jp6uvs7e7v8PHy8/T19vf4+fr7/P3+/w==\r\n";
+    BOOST_CHECK(binary == decode("base64", encoded));
+    BOOST_CHECK(binary == decode("base64", encoded, 5));
+}
+
+BOOST_AUTO_TEST_CASE(decodeQuotedPrintableTest)
+{
+    BOOST_CHECK_EQUAL("caf\xC3\xA9 = 1", decode("quoted-printable", "caf=C3=A9 =3D 1"));
+    BOOST_CHECK_EQUAL("soft line break\r\nhard", decode("Quoted-Printable", "soft li=\r\nne br=  \r\neak  \r\nhard\t"));
+    BOOST_CHECK_EQUAL("lower\xE9 =G1 end", decode("quoted-printable", "lower=e9 =G1 end="));
+    BOOST_CHECK_EQUAL("a  b\nc", decode("quoted-printable", "a  b \nc", 1));
+}
+
+BOOST_AUTO_TEST_CASE(decodeIdentityTest)
+{
+    BOOST_CHECK_EQUAL("=41 QQ==\r\n", decode("7bit", "=41 QQ==\r\n"));
+    BOOST_CHECK_EQUAL("=41 QQ==\r\n", decode("x-unknown", "=41 QQ==\r\n", 2));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace Test
+} // namespace LibMailUnit
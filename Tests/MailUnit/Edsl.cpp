@@ -117,6 +117,19 @@ BOOST_AUTO_TEST_CASE(parseTest)
             true,
             "get Subject = 'test' and (From = 'from@test' or To = 'to@test')",
             "GET (Subject = 'test' AND (From = 'from@test' OR To = 'to@test'));"
+        },
+        {
+            true,
+            "get Header('X-Test-Id') = 'abc' and Size > 100000",
+            "GET (Header('X-Test-Id') = 'abc' AND Size > 100000);"
+        },
+        {
+            false,
+            "get Header('X-Test-Id' = 'abc'"
+        },
+        {
+            false,
+            "get Header(X-Test-Id) = 'abc'"
         }
     };
     for(auto test : tests)
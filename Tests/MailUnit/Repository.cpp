@@ -15,7 +15,14 @@
  *                                                                                             *
  ***********************************************************************************************/
 
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <iterator>
 #include <boost/test/unit_test.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
 #include <MailUnit/OS/FileSystem.h>
 #include <MailUnit/Storage/Repository.h>
 
@@ -41,6 +48,37 @@ struct TestContext
     boost::filesystem::path repository_path;
 }; // struct TestContext
 
+uint32_t storeTestEmail(Repository & _repository, const std::string & _recipient)
+{
+    std::unique_ptr<RawEmail> raw_email = _repository.createRawEmail();
+    raw_email->addFromAddress("from@test");
+    raw_email->addToAddress(_recipient);
+    raw_email->data() <<
+        "From: from@test\r\n"
+        "To: " << _recipient << "\r\n"
+        "Subject: Test\r\n"
+        "\r\n"
+        "Body\r\n";
+    return _repository.storeEmail(*raw_email);
+}
+
+std::string readTestEmail(const Email & _email)
+{
+    std::shared_ptr<std::istream> stream = _email.openData();
+    return std::string((std::istreambuf_iterator<char>(*stream)), std::istreambuf_iterator<char>());
+}
+
+size_t countDataFiles(const boost::filesystem::path & _repository_path)
+{
+    size_t count = 0;
+    for(boost::filesystem::recursive_directory_iterator it(_repository_path / "data"), end; it != end; ++it)
+    {
+        if(boost::filesystem::is_regular_file(it->path()))
+            ++count;
+    }
+    return count;
+}
+
 } // namespace
 
 namespace MailUnit {
@@ -56,6 +94,519 @@ BOOST_AUTO_TEST_CASE(createRawEmailTest)
     BOOST_CHECK(boost::filesystem::is_regular_file(raw_email->dataFilePath()));
 }
 
+BOOST_AUTO_TEST_CASE(headerQueryTest)
+{
+    TestContext context;
+    Repository::Options options;
+    options.indexed_headers.push_back("X-Test-Id");
+    Repository repository(context.repository_path, options);
+    const char * test_ids[] = { "first", "second" };
+    uint32_t last_id = 0;
+    for(const char * test_id : test_ids)
+    {
+        std::unique_ptr<RawEmail> raw_email = repository.createRawEmail();
+        raw_email->addFromAddress("from@test");
+        raw_email->addToAddress("to@test");
+        raw_email->data() <<
+            "From: from@test\r\n"
+            "To: to@test\r\n"
+            "Subject: Test\r\n"
+            "Message-ID: <" << test_id << "@test>\r\n"
+            "X-Test-Id: " << test_id << "\r\n"
+            "\r\n"
+            "Body\r\n";
+        last_id = repository.storeEmail(*raw_email);
+    }
+
+    std::shared_ptr<QueryResult> result = repository.executeQuery("get header('x-test-id') = 'second'");
+    const QueryGetResult & header_result = boost::get<QueryGetResult>(*result);
+    BOOST_REQUIRE_EQUAL(1, header_result.emails.size());
+    BOOST_CHECK_EQUAL(last_id, header_result.emails[0]->id());
+
+    result = repository.executeQuery("get MessageId = '<first@test>'");
+    BOOST_CHECK_EQUAL(1, boost::get<QueryGetResult>(*result).emails.size());
+
+    result = repository.executeQuery("get MessageId = 'first@test' or MessageId = 'second@test'");
+    BOOST_CHECK_EQUAL(2, boost::get<QueryGetResult>(*result).emails.size());
+
+    result = repository.executeQuery("get Size > 1000000");
+    BOOST_CHECK(boost::get<QueryGetResult>(*result).emails.empty());
+
+    result = repository.executeQuery("drop Header('X-Test-Id') = 'first'");
+    BOOST_CHECK_EQUAL(1, boost::get<QueryDropResult>(*result).count);
+
+    result = repository.executeQuery("get Size > 10");
+    BOOST_CHECK_EQUAL(1, boost::get<QueryGetResult>(*result).emails.size());
+
+    // Would be 100 if the value were truncated to 32 bits
+    result = repository.executeQuery("get Size < 4294967396");
+    BOOST_CHECK_EQUAL(1, boost::get<QueryGetResult>(*result).emails.size());
+
+    BOOST_CHECK_THROW(repository.executeQuery("get Size = 'x'"), StorageException);
+    BOOST_CHECK_THROW(repository.executeQuery("get Header('X-Not-Indexed') = 'first'"), StorageException);
+}
+
+BOOST_AUTO_TEST_CASE(dropTest)
+{
+    TestContext context;
+    {
+        Repository repository(context.repository_path);
+        const char * recipients[] = { "first@test", "second@test", "first@test" };
+        for(const char * recipient : recipients)
+        {
+            storeTestEmail(repository, recipient);
+        }
+
+        std::shared_ptr<QueryResult> result = repository.executeQuery("drop To = 'first@test'");
+        BOOST_CHECK_EQUAL(2, boost::get<QueryDropResult>(*result).count);
+
+        result = repository.executeQuery("drop To = 'first@test'");
+        BOOST_CHECK_EQUAL(0, boost::get<QueryDropResult>(*result).count);
+
+        result = repository.executeQuery("get");
+        BOOST_CHECK_EQUAL(1, boost::get<QueryGetResult>(*result).emails.size());
+    }
+    BOOST_CHECK_EQUAL(2, countDataFiles(context.repository_path));
+}
+
+BOOST_AUTO_TEST_CASE(truncateTest)
+{
+    TestContext context;
+    {
+        Repository repository(context.repository_path);
+        for(int i = 0; i < 3; ++i)
+        {
+            storeTestEmail(repository, "to@test");
+        }
+
+        std::shared_ptr<QueryResult> result = repository.executeQuery("drop");
+        BOOST_CHECK_EQUAL(3, boost::get<QueryDropResult>(*result).count);
+
+        result = repository.executeQuery("get");
+        BOOST_CHECK(boost::get<QueryGetResult>(*result).emails.empty());
+
+        storeTestEmail(repository, "to@test");
+        result = repository.executeQuery("get To = 'to@test'");
+        BOOST_CHECK_EQUAL(1, boost::get<QueryGetResult>(*result).emails.size());
+    }
+    BOOST_CHECK_EQUAL(2, countDataFiles(context.repository_path));
+}
+
+BOOST_AUTO_TEST_CASE(evictTest)
+{
+    TestContext context;
+    Repository::Options options;
+    options.max_messages = 2;
+    Repository repository(context.repository_path, options);
+    uint32_t ids[5];
+    for(uint32_t & id : ids)
+    {
+        id = storeTestEmail(repository, "to@test");
+    }
+
+    BOOST_CHECK_EQUAL(3, repository.evictEmails(2));
+    BOOST_CHECK_EQUAL(0, repository.evictEmails(2));
+
+    std::shared_ptr<QueryResult> result = repository.executeQuery("get");
+    const QueryGetResult & get_result = boost::get<QueryGetResult>(*result);
+    BOOST_REQUIRE_EQUAL(2, get_result.emails.size());
+    BOOST_CHECK_EQUAL(ids[3], get_result.emails[0]->id());
+    BOOST_CHECK_EQUAL(ids[4], get_result.emails[1]->id());
+}
+
+BOOST_AUTO_TEST_CASE(evictByAgeTest)
+{
+    TestContext context;
+    Repository::Options options;
+    options.max_age = 1;
+    Repository repository(context.repository_path, options);
+    storeTestEmail(repository, "first@test");
+    storeTestEmail(repository, "second@test");
+    BOOST_CHECK_EQUAL(0, repository.evictEmails());
+    std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+    uint32_t id = storeTestEmail(repository, "third@test");
+
+    BOOST_CHECK_EQUAL(2, repository.evictEmails());
+
+    std::shared_ptr<QueryResult> result = repository.executeQuery("get");
+    const QueryGetResult & get_result = boost::get<QueryGetResult>(*result);
+    BOOST_REQUIRE_EQUAL(1, get_result.emails.size());
+    BOOST_CHECK_EQUAL(id, get_result.emails[0]->id());
+}
+
+BOOST_AUTO_TEST_CASE(evictBySizeTest)
+{
+    TestContext context;
+    uint32_t ids[4];
+    uint64_t email_size;
+    {
+        Repository repository(context.repository_path);
+        for(size_t i = 0; i < 4; ++i)
+        {
+            ids[i] = storeTestEmail(repository, "to" + std::to_string(i) + "@test");
+        }
+        std::shared_ptr<QueryResult> result = repository.executeQuery("get");
+        email_size = boost::get<QueryGetResult>(*result).emails[0]->size();
+    }
+    Repository::Options options;
+    options.max_bytes = email_size * 2 + 1;
+    Repository repository(context.repository_path, options);
+
+    BOOST_CHECK_EQUAL(2, repository.evictEmails(1));
+    BOOST_CHECK_EQUAL(0, repository.evictEmails(1));
+
+    std::shared_ptr<QueryResult> result = repository.executeQuery("get");
+    const QueryGetResult & get_result = boost::get<QueryGetResult>(*result);
+    BOOST_REQUIRE_EQUAL(2, get_result.emails.size());
+    BOOST_CHECK_EQUAL(ids[2], get_result.emails[0]->id());
+    BOOST_CHECK_EQUAL(ids[3], get_result.emails[1]->id());
+}
+
+BOOST_AUTO_TEST_CASE(evictSharedBodyTest)
+{
+    TestContext context;
+    uint32_t ids[4];
+    uint64_t head_length;
+    uint64_t body_length;
+    {
+        Repository repository(context.repository_path);
+        for(size_t i = 0; i < 4; ++i)
+        {
+            std::unique_ptr<RawEmail> raw_email = repository.createRawEmail();
+            raw_email->addFromAddress("from@test");
+            raw_email->addToAddress("to" + std::to_string(i) + "@test");
+            raw_email->data() <<
+                "From: from@test\r\n"
+                "To: to" << i << "@test\r\n"
+                "Subject: Shared\r\n"
+                "\r\n" << std::string(1000, 'B') << "\r\n";
+            ids[i] = repository.storeEmail(*raw_email);
+        }
+        std::shared_ptr<QueryResult> result = repository.executeQuery("get");
+        const Email & email = *boost::get<QueryGetResult>(*result).emails[0];
+        head_length = email.headLength();
+        body_length = email.dataLength();
+    }
+    // The shared body is not released until the last message is evicted,
+    // so only the heads of the evicted messages free the space.
+    Repository::Options options;
+    options.max_bytes = body_length + head_length;
+    Repository repository(context.repository_path, options);
+
+    BOOST_CHECK_EQUAL(3, repository.evictEmails(2));
+    BOOST_CHECK_EQUAL(0, repository.evictEmails(2));
+
+    std::shared_ptr<QueryResult> result = repository.executeQuery("get");
+    const QueryGetResult & get_result = boost::get<QueryGetResult>(*result);
+    BOOST_REQUIRE_EQUAL(1, get_result.emails.size());
+    BOOST_CHECK_EQUAL(ids[3], get_result.emails[0]->id());
+}
+
+BOOST_AUTO_TEST_CASE(deduplicationTest)
+{
+    TestContext context;
+    {
+        Repository repository(context.repository_path);
+        uint32_t first_id = storeTestEmail(repository, "to@test");
+        storeTestEmail(repository, "to@test");
+        storeTestEmail(repository, "to@test");
+        storeTestEmail(repository, "other@test");
+        // Each message has its own head and all of them share the body.
+        BOOST_CHECK_EQUAL(5, countDataFiles(context.repository_path));
+
+        std::stringstream query;
+        query << "drop Id = " << first_id;
+        std::shared_ptr<QueryResult> result = repository.executeQuery(query.str());
+        BOOST_CHECK_EQUAL(1, boost::get<QueryDropResult>(*result).count);
+
+        result = repository.executeQuery("get To = 'to@test'");
+        const QueryGetResult & get_result = boost::get<QueryGetResult>(*result);
+        BOOST_REQUIRE_EQUAL(2, get_result.emails.size());
+        BOOST_CHECK(readTestEmail(*get_result.emails[0]).find("To: to@test\r\n") != std::string::npos);
+
+        result = repository.executeQuery("drop To = 'to@test'");
+        BOOST_CHECK_EQUAL(2, boost::get<QueryDropResult>(*result).count);
+    }
+    BOOST_CHECK_EQUAL(2, countDataFiles(context.repository_path));
+}
+
+BOOST_AUTO_TEST_CASE(sharedBodyTest)
+{
+    for(BlobLayout layout : { BlobLayout::file, BlobLayout::segment })
+    {
+        TestContext context;
+        Repository::Options options;
+        options.blob_layout = layout;
+        Repository repository(context.repository_path, options);
+        for(const char * recipient : { "first@test", "second@test" })
+        {
+            std::unique_ptr<RawEmail> raw_email = repository.createRawEmail();
+            raw_email->addFromAddress("from@test");
+            raw_email->addToAddress(recipient);
+            raw_email->data() <<
+                "From: from@test\r\n"
+                "To: " << recipient << "\r\n"
+                "Message-ID: <" << recipient << ">\r\n"
+                "Subject: Shared\r\n"
+                "\r\n"
+                "Shared body\r\n";
+            repository.storeEmail(*raw_email);
+        }
+
+        std::shared_ptr<QueryResult> result = repository.executeQuery("get");
+        const QueryGetResult & get_result = boost::get<QueryGetResult>(*result);
+        BOOST_REQUIRE_EQUAL(2, get_result.emails.size());
+        const Email & first = *get_result.emails[0];
+        const Email & second = *get_result.emails[1];
+        BOOST_CHECK(first.dataFilePath() == second.dataFilePath());
+        BOOST_CHECK_EQUAL(first.dataOffset(), second.dataOffset());
+        BOOST_CHECK(first.headFilePath() != second.headFilePath() || first.headOffset() != second.headOffset());
+        BOOST_CHECK_EQUAL(
+            "From: from@test\r\nTo: first@test\r\nMessage-ID: <first@test>\r\n"
+            "Subject: Shared\r\n\r\nShared body\r\n", readTestEmail(first));
+        BOOST_CHECK_EQUAL(
+            "From: from@test\r\nTo: second@test\r\nMessage-ID: <second@test>\r\n"
+            "Subject: Shared\r\n\r\nShared body\r\n", readTestEmail(second));
+        BOOST_CHECK_EQUAL(first.size(), readTestEmail(first).size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(shardedLayoutTest)
+{
+    TestContext context;
+    boost::filesystem::path data_path = context.repository_path / "data";
+    boost::filesystem::path flat_path;
+    {
+        Repository repository(context.repository_path);
+        storeTestEmail(repository, "to@test");
+        std::shared_ptr<QueryResult> result = repository.executeQuery("get");
+        const QueryGetResult & get_result = boost::get<QueryGetResult>(*result);
+        BOOST_REQUIRE_EQUAL(1, get_result.emails.size());
+        const Email & email = *get_result.emails[0];
+        for(const boost::filesystem::path & sharded_path : { email.dataFilePath(), email.headFilePath() })
+        {
+            std::string name = sharded_path.filename().string();
+            BOOST_CHECK_EQUAL(data_path / name.substr(0, 2) / name.substr(2, 2) / name, sharded_path);
+        }
+        // Older versions stored whole messages in the flat data directory.
+        std::string name = email.dataFilePath().stem().string();
+        flat_path = data_path / name;
+        std::ofstream(flat_path.string(), std::ios_base::binary) << readTestEmail(email);
+        boost::filesystem::remove(email.dataFilePath());
+        boost::filesystem::remove(email.headFilePath());
+    }
+    boost::filesystem::remove(context.repository_path / "index.db");
+    Repository::Options options;
+    options.recover = true;
+    Repository repository(context.repository_path, options);
+    BOOST_CHECK(!boost::filesystem::exists(flat_path));
+    std::shared_ptr<QueryResult> result = repository.executeQuery("get");
+    const QueryGetResult & get_result = boost::get<QueryGetResult>(*result);
+    BOOST_REQUIRE_EQUAL(1, get_result.emails.size());
+    BOOST_CHECK(readTestEmail(*get_result.emails[0]).find("To: to@test\r\n") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(segmentLayoutTest)
+{
+    TestContext context;
+    {
+        Repository::Options options;
+        options.blob_layout = BlobLayout::segment;
+        options.segment_size = 120;
+        Repository repository(context.repository_path, options);
+        const char * recipients[] = { "first@test", "second@test", "third@test", "fourth@test" };
+        for(const char * recipient : recipients)
+        {
+            storeTestEmail(repository, recipient);
+        }
+        // Each head fills a segment, the shared body is followed by the second head.
+        BOOST_CHECK_EQUAL(4, countDataFiles(context.repository_path));
+
+        std::shared_ptr<QueryResult> result = repository.executeQuery("get To = 'second@test'");
+        const QueryGetResult & get_result = boost::get<QueryGetResult>(*result);
+        BOOST_REQUIRE_EQUAL(1, get_result.emails.size());
+        BOOST_CHECK(readTestEmail(*get_result.emails[0]).find("To: second@test\r\n") != std::string::npos);
+
+        result = repository.executeQuery("drop To = 'second@test' or To = 'third@test' or To = 'fourth@test'");
+        BOOST_CHECK_EQUAL(3, boost::get<QueryDropResult>(*result).count);
+        BOOST_CHECK_EQUAL(3, repository.compactBlobs());
+
+        result = repository.executeQuery("get");
+        const QueryGetResult & compacted_result = boost::get<QueryGetResult>(*result);
+        BOOST_REQUIRE_EQUAL(1, compacted_result.emails.size());
+        std::string data = readTestEmail(*compacted_result.emails[0]);
+        BOOST_CHECK_EQUAL(0, data.find("From: from@test\r\nTo: first@test\r\n"));
+        BOOST_CHECK_EQUAL(compacted_result.emails[0]->size(), data.size());
+    }
+    BOOST_CHECK_EQUAL(2, countDataFiles(context.repository_path));
+    {
+        // The file layout leaves the segments as they are.
+        Repository repository(context.repository_path);
+        std::shared_ptr<QueryResult> result = repository.executeQuery("drop To = 'first@test'");
+        BOOST_CHECK_EQUAL(1, boost::get<QueryDropResult>(*result).count);
+        BOOST_CHECK_EQUAL(0, repository.compactBlobs());
+    }
+    BOOST_CHECK_EQUAL(2, countDataFiles(context.repository_path));
+}
+
+BOOST_AUTO_TEST_CASE(recoveryTest)
+{
+    TestContext context;
+    // Stored zlib blocks keep the data as is, so this uncompressed message can be inflated entirely
+    // and is still a parsable e-mail. It must not be taken for a compressed one.
+    std::stringstream zlib_like_data;
+    {
+        std::string text =
+            "-Padding: the zlib header is glued to this line\r\n"
+            "To: zlib@test\r\n"
+            "Subject: Stored\r\n"
+            "\r\n";
+        // The length of a stored block is written before the data, 0x141 contains no zero bytes.
+        text.resize(0x141, 'B');
+        std::stringstream source(text);
+        encodeBlob(source, zlib_like_data, BlobEncoding::zlib, 0);
+    }
+    {
+        Repository repository(context.repository_path);
+        storeTestEmail(repository, "file@test");
+        std::unique_ptr<RawEmail> raw_email = repository.createRawEmail();
+        raw_email->addFromAddress("from@test");
+        raw_email->addToAddress("zlib@test");
+        raw_email->data() << zlib_like_data.str();
+        repository.storeEmail(*raw_email);
+    }
+    {
+        Repository::Options options;
+        options.compression_level = 6;
+        Repository repository(context.repository_path, options);
+        std::unique_ptr<RawEmail> raw_email = repository.createRawEmail();
+        raw_email->data() <<
+            "From: from@test\r\n"
+            "To: compressed-file@test\r\n"
+            "Subject: Compressed\r\n"
+            "\r\n";
+        for(int i = 0; i < 100; ++i)
+            raw_email->data() << "Repetitive line of the test message body\r\n";
+        repository.storeEmail(*raw_email);
+    }
+    {
+        Repository::Options options;
+        options.blob_layout = BlobLayout::segment;
+        options.compression_level = 6;
+        Repository repository(context.repository_path, options);
+        storeTestEmail(repository, "segment@test");
+        std::unique_ptr<RawEmail> raw_email = repository.createRawEmail();
+        raw_email->data() <<
+            "From: from@test\r\n"
+            "To: compressed@test\r\n"
+            "Subject: Compressed\r\n"
+            "\r\n";
+        for(int i = 0; i < 100; ++i)
+            raw_email->data() << "Repetitive line of the test message body\r\n";
+        repository.storeEmail(*raw_email);
+    }
+    boost::filesystem::remove(context.repository_path / "index.db");
+    boost::filesystem::path orphan_path = context.repository_path / "tmp" / "orphan.tmp";
+    std::ofstream(orphan_path.string()) << "orphan";
+    {
+        Repository::Options options;
+        options.recover = true;
+        options.recovery_threads = 2;
+        Repository repository(context.repository_path, options);
+        std::shared_ptr<QueryResult> result = repository.executeQuery("get");
+        const QueryGetResult & all_result = boost::get<QueryGetResult>(*result);
+        BOOST_CHECK_EQUAL(5, all_result.emails.size());
+        result = repository.executeQuery("get To = 'zlib@test'");
+        const QueryGetResult & zlib_like_result = boost::get<QueryGetResult>(*result);
+        BOOST_REQUIRE_EQUAL(1, zlib_like_result.emails.size());
+        BOOST_CHECK(BlobEncoding::identity == zlib_like_result.emails[0]->dataEncoding());
+        BOOST_CHECK(zlib_like_data.str() == readTestEmail(*zlib_like_result.emails[0]));
+
+        for(const char * recipient : { "compressed@test", "compressed-file@test" })
+        {
+            result = repository.executeQuery(std::string("get To = '") + recipient + "'");
+            const QueryGetResult & get_result = boost::get<QueryGetResult>(*result);
+            BOOST_REQUIRE_EQUAL(1, get_result.emails.size());
+            const Email & email = *get_result.emails[0];
+            BOOST_CHECK(BlobEncoding::zlib == email.dataEncoding());
+            std::string data = readTestEmail(email);
+            BOOST_CHECK_EQUAL(email.size(), data.size());
+            BOOST_CHECK_EQUAL(0, data.find(std::string("From: from@test\r\nTo: ") + recipient + "\r\n"));
+        }
+    }
+    {
+        Repository::Options options;
+        options.recover = true;
+        Repository repository(context.repository_path, options);
+        std::shared_ptr<QueryResult> result = repository.executeQuery("get");
+        BOOST_CHECK_EQUAL(5, boost::get<QueryGetResult>(*result).emails.size());
+    }
+    BOOST_CHECK(!boost::filesystem::exists(orphan_path));
+}
+
+BOOST_AUTO_TEST_CASE(compressionTest)
+{
+    TestContext context;
+    Repository::Options options;
+    options.compression_level = 6;
+    Repository repository(context.repository_path, options);
+    std::unique_ptr<RawEmail> raw_email = repository.createRawEmail();
+    raw_email->addFromAddress("from@test");
+    raw_email->addToAddress("to@test");
+    std::stringstream source;
+    source <<
+        "From: from@test\r\n"
+        "To: to@test\r\n"
+        "Subject: Compressed\r\n"
+        "\r\n";
+    for(int i = 0; i < 1000; ++i)
+        source << "Repetitive line of the test message body\r\n";
+    raw_email->data() << source.str();
+    repository.storeEmail(*raw_email);
+
+    std::shared_ptr<QueryResult> result = repository.executeQuery("get Subject = 'Compressed'");
+    const QueryGetResult & get_result = boost::get<QueryGetResult>(*result);
+    BOOST_REQUIRE_EQUAL(1, get_result.emails.size());
+    const Email & email = *get_result.emails[0];
+    BOOST_CHECK(BlobEncoding::zlib == email.dataEncoding());
+    BOOST_CHECK_EQUAL(source.str().size(), email.size());
+    BOOST_CHECK_LT(email.dataLength(), email.size() / 5);
+    BOOST_CHECK(source.str() == readTestEmail(email));
+
+    // The compressed body is passed through with the head prepended.
+    uint64_t encoded_length = 0;
+    std::shared_ptr<std::istream> encoded = email.openEncodedData(encoded_length);
+    std::string encoded_data((std::istreambuf_iterator<char>(*encoded)), std::istreambuf_iterator<char>());
+    BOOST_CHECK_EQUAL(encoded_length, encoded_data.size());
+    boost::iostreams::filtering_istream decoded;
+    decoded.push(boost::iostreams::zlib_decompressor());
+    decoded.push(boost::make_iterator_range(encoded_data));
+    std::string decoded_data((std::istreambuf_iterator<char>(decoded)), std::istreambuf_iterator<char>());
+    BOOST_CHECK(source.str() == decoded_data);
+}
+
+BOOST_AUTO_TEST_CASE(encodedSubjectTest)
+{
+    TestContext context;
+    Repository repository(context.repository_path);
+    std::unique_ptr<RawEmail> raw_email = repository.createRawEmail();
+    raw_email->addFromAddress("from@test");
+    raw_email->addToAddress("to@test");
+    raw_email->data() <<
+        "From: from@test\r\n"
+        "To: to@test\r\n"
+        "Subject: =?UTF-8?B?0J/RgNC40LLQtdGC?=\r\n"
+        "\r\n"
+        "Body\r\n";
+    repository.storeEmail(*raw_email);
+
+    std::shared_ptr<QueryResult> result =
+        repository.executeQuery("get Subject = '\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82'");
+    const QueryGetResult & get_result = boost::get<QueryGetResult>(*result);
+    BOOST_REQUIRE_EQUAL(1, get_result.emails.size());
+    BOOST_CHECK_EQUAL("\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82", get_result.emails[0]->subject());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace Test
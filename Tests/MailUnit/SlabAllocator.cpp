@@ -0,0 +1,65 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <memory>
+#include <boost/test/unit_test.hpp>
+#include <MailUnit/SlabAllocator.h>
+
+using namespace MailUnit;
+
+namespace MailUnit {
+namespace Test {
+
+namespace {
+
+struct Block
+{
+    char data[200];
+}; // struct Block
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(SlabAllocator)
+
+BOOST_AUTO_TEST_CASE(recycleTest)
+{
+    typedef SlabPool<sizeof(Block)> Pool;
+    MailUnit::SlabAllocator<Block> allocator;
+    Block * first = allocator.allocate(1);
+    std::size_t free_count = Pool::freeBlockCount();
+    allocator.deallocate(first, 1);
+    BOOST_CHECK_EQUAL(free_count + 1, Pool::freeBlockCount());
+    Block * second = allocator.allocate(1);
+    BOOST_CHECK_EQUAL(first, second);
+    BOOST_CHECK_EQUAL(free_count, Pool::freeBlockCount());
+    allocator.deallocate(second, 1);
+}
+
+BOOST_AUTO_TEST_CASE(allocateSharedTest)
+{
+    std::shared_ptr<Block> block = std::allocate_shared<Block>(MailUnit::SlabAllocator<Block>());
+    block->data[0] = 'x';
+    BOOST_CHECK_EQUAL('x', block->data[0]);
+    block.reset();
+    std::shared_ptr<Block> other_block = std::allocate_shared<Block>(MailUnit::SlabAllocator<Block>());
+    BOOST_CHECK(other_block);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace Test
+} // namespace MailUnit
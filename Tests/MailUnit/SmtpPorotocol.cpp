@@ -53,6 +53,7 @@ public:
         read_count(0),
         write_count(0),
         switch_to_tls_count(0),
+        store_count(0),
         exit_count(0)
     {
     }
@@ -73,6 +74,13 @@ public:
         ++switch_to_tls_count;
     }
 
+    void requestForStore(StoreTask _task, StoreCallback _callback)
+    {
+        ++store_count;
+        _task();
+        _callback(true);
+    }
+
     void requestForExit()
     {
         ++exit_count;
@@ -87,6 +95,7 @@ public:
     size_t read_count;
     size_t write_count;
     size_t switch_to_tls_count;
+    size_t store_count;
     size_t exit_count;
     boost::optional<Response> latest_response;
 }; // class TestProtocolTransport
@@ -182,6 +191,7 @@ BOOST_AUTO_TEST_CASE(simpleSequanceTest)
 
     protocol.processInput("tail\r\n.\r\n", 9);
     transport.performNextAction();
+    BOOST_CHECK_EQUAL(1u, transport.store_count);
     BOOST_CHECK_EQUAL(6u, transport.read_count);
     BOOST_CHECK_EQUAL(6u, transport.write_count);
     BOOST_CHECK_EQUAL(0u, transport.switch_to_tls_count);
@@ -220,6 +230,7 @@ BOOST_AUTO_TEST_CASE(startTlsTest)
     transport.performNextAction();
     protocol.processInput("EHLO example.com\r\n", 18);
     transport.performNextAction();
+    BOOST_CHECK_EQUAL("250-OK\r\n250 STARTTLS\r\n", transport.latest_response->wireData());
     transport.performNextAction();
     protocol.processInput("STARTTLS\r\n", 10);
     transport.performNextAction();
@@ -263,6 +274,151 @@ BOOST_AUTO_TEST_CASE(badCommandsSequenceTest)
     BOOST_CHECK(ResponseCode::badCommandsSequence == transport.latest_response->code());
 }
 
+BOOST_AUTO_TEST_CASE(splitCommandTest)
+{
+    TestContext context;
+    Repository repository(context.repository_path);
+    TestProtocolTransport transport;
+    Protocol protocol(repository, transport);
+    protocol.start();
+    transport.performNextAction();
+    transport.performNextAction();
+    protocol.processInput("EHLO exa", 8);
+    transport.performNextAction();
+    protocol.processInput("mple.com\r", 9);
+    transport.performNextAction();
+    BOOST_CHECK_EQUAL(1u, transport.write_count);
+    protocol.processInput("\n", 1);
+    transport.performNextAction();
+    BOOST_CHECK_EQUAL(2u, transport.write_count);
+    BOOST_CHECK(ResponseCode::ok == transport.latest_response->code());
+}
+
+BOOST_AUTO_TEST_CASE(tooLongCommandTest)
+{
+    TestContext context;
+    Repository repository(context.repository_path);
+    TestProtocolTransport transport;
+    Protocol protocol(repository, transport);
+    protocol.start();
+    transport.performNextAction();
+    transport.performNextAction();
+    std::string line = "EHLO " + std::string(1000, 'x');
+    protocol.processInput(line.c_str(), line.size());
+    transport.performNextAction();
+    protocol.processInput(line.c_str(), line.size());
+    transport.performNextAction();
+    protocol.processInput("\r\n", 2);
+    transport.performNextAction();
+    BOOST_CHECK_EQUAL(2u, transport.write_count);
+    BOOST_CHECK(ResponseCode::unrecognizedCommand == transport.latest_response->code());
+    transport.performNextAction();
+    protocol.processInput("EHLO example.com\r\n", 18);
+    transport.performNextAction();
+    BOOST_CHECK_EQUAL(3u, transport.write_count);
+    BOOST_CHECK(ResponseCode::ok == transport.latest_response->code());
+}
+
+BOOST_AUTO_TEST_CASE(caseInsensitiveVerbTest)
+{
+    TestContext context;
+    Repository repository(context.repository_path);
+    TestProtocolTransport transport;
+    Protocol protocol(repository, transport);
+    protocol.start();
+    transport.performNextAction();
+    transport.performNextAction();
+    protocol.processInput("helo example.com\r\n", 18);
+    transport.performNextAction();
+    transport.performNextAction();
+    BOOST_CHECK(ResponseCode::ok == transport.latest_response->code());
+    protocol.processInput("Mail FROM:from@example.com\r\n", 28);
+    transport.performNextAction();
+    transport.performNextAction();
+    BOOST_CHECK(ResponseCode::ok == transport.latest_response->code());
+    protocol.processInput("MAILX\r\n", 7);
+    transport.performNextAction();
+    transport.performNextAction();
+    BOOST_CHECK(ResponseCode::unrecognizedCommand == transport.latest_response->code());
+}
+
+BOOST_AUTO_TEST_CASE(noopAndVerifyTest)
+{
+    TestContext context;
+    Repository repository(context.repository_path);
+    TestProtocolTransport transport;
+    Protocol protocol(repository, transport);
+    protocol.start();
+    transport.performNextAction();
+    transport.performNextAction();
+    protocol.processInput("NOOP\r\n", 6);
+    transport.performNextAction();
+    transport.performNextAction();
+    BOOST_CHECK(ResponseCode::ok == transport.latest_response->code());
+    protocol.processInput("EHLO example.com\r\n", 18);
+    transport.performNextAction();
+    transport.performNextAction();
+    protocol.processInput("MAIL FROM:from@example.com\r\n", 28);
+    transport.performNextAction();
+    transport.performNextAction();
+    protocol.processInput("VRFY to@example.com\r\n", 21);
+    transport.performNextAction();
+    transport.performNextAction();
+    BOOST_CHECK(ResponseCode::userNotVerified == transport.latest_response->code());
+    protocol.processInput("RCPT TO:to@example.com\r\n", 24);
+    transport.performNextAction();
+    transport.performNextAction();
+    BOOST_CHECK(ResponseCode::ok == transport.latest_response->code());
+}
+
+BOOST_AUTO_TEST_CASE(resetTest)
+{
+    TestContext context;
+    Repository repository(context.repository_path);
+    TestProtocolTransport transport;
+    Protocol protocol(repository, transport);
+    protocol.start();
+    transport.performNextAction();
+    transport.performNextAction();
+    protocol.processInput("EHLO example.com\r\n", 18);
+    transport.performNextAction();
+    transport.performNextAction();
+    protocol.processInput("MAIL FROM:from@example.com\r\n", 28);
+    transport.performNextAction();
+    transport.performNextAction();
+    protocol.processInput("RCPT TO:to@example.com\r\n", 24);
+    transport.performNextAction();
+    transport.performNextAction();
+    protocol.processInput("RSET\r\n", 6);
+    transport.performNextAction();
+    transport.performNextAction();
+    BOOST_CHECK(ResponseCode::ok == transport.latest_response->code());
+    protocol.processInput("DATA\r\n", 6);
+    transport.performNextAction();
+    transport.performNextAction();
+    BOOST_CHECK(ResponseCode::badCommandsSequence == transport.latest_response->code());
+    protocol.processInput("MAIL FROM:other@example.com\r\n", 29);
+    transport.performNextAction();
+    transport.performNextAction();
+    BOOST_CHECK(ResponseCode::ok == transport.latest_response->code());
+    protocol.processInput("RCPT TO:to@example.com\r\n", 24);
+    transport.performNextAction();
+    transport.performNextAction();
+    protocol.processInput("DATA\r\n", 6);
+    transport.performNextAction();
+    transport.performNextAction();
+    BOOST_CHECK(ResponseCode::intermediate == transport.latest_response->code());
+    protocol.processInput("Subject: test\r\n\r\ntest\r\n.\r\n", 29);
+    transport.performNextAction();
+    transport.performNextAction();
+    BOOST_CHECK_EQUAL(1u, transport.store_count);
+    BOOST_CHECK(ResponseCode::ok == transport.latest_response->code());
+    protocol.processInput("RSET\r\n", 6);
+    transport.performNextAction();
+    transport.performNextAction();
+    BOOST_CHECK(ResponseCode::ok == transport.latest_response->code());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace Test
@@ -0,0 +1,73 @@
+/***********************************************************************************************
+ *                                                                                             *
+ * This file is part of MailUnit.                                                              *
+ *                                                                                             *
+ * MailUnit is free software: you can redistribute it and/or modify it under the terms of      *
+ * the GNU General Public License as published by the Free Software Foundation,                *
+ * either version 3 of the License, or (at your option) any later version.                     *
+ *                                                                                             *
+ * MailUnit is distributed in the hope that it will be useful,  but WITHOUT ANY WARRANTY;      *
+ * without even the implied warranty of  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  *
+ * See the GNU General Public License for more details.                                        *
+ *                                                                                             *
+ * You should have received a copy of the GNU General Public License along with MailUnit.      *
+ * If not, see <http://www.gnu.org/licenses/>.                                                 *
+ *                                                                                             *
+ ***********************************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <boost/test/unit_test.hpp>
+#include <MailUnit/Storage/StorageExecutor.h>
+
+using namespace MailUnit::Storage;
+
+namespace MailUnit {
+namespace Test {
+
+BOOST_AUTO_TEST_SUITE(StorageExecutor)
+
+BOOST_AUTO_TEST_CASE(rejectWhenFullTest)
+{
+    std::promise<void> started;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<int> completed(0);
+    MailUnit::Storage::StorageExecutor executor(1, 2);
+    BOOST_REQUIRE(executor.post([&started, released]() {
+        started.set_value();
+        released.wait();
+    }));
+    started.get_future().wait();
+    BOOST_CHECK(executor.post([&completed]() { ++completed; }));
+    BOOST_CHECK(executor.post([&completed]() { ++completed; }));
+    BOOST_CHECK(!executor.post([&completed]() { ++completed; }));
+    release.set_value();
+    executor.stop();
+    BOOST_CHECK_EQUAL(2, completed.load());
+}
+
+BOOST_AUTO_TEST_CASE(drainOnStopTest)
+{
+    std::atomic<int> completed(0);
+    MailUnit::Storage::StorageExecutor executor(2, 100);
+    for(int i = 0; i < 100; ++i)
+    {
+        BOOST_REQUIRE(executor.post([&completed]() {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            ++completed;
+        }));
+    }
+    executor.stop();
+    BOOST_CHECK_EQUAL(100, completed.load());
+    BOOST_CHECK(!executor.post([&completed]() { ++completed; }));
+    executor.stop();
+    BOOST_CHECK_EQUAL(100, completed.load());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace Test
+} // namespace MailUnit